@@ -35,12 +35,20 @@
  */
 
 #include <linux/module.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/scatterlist.h>
+#include <linux/bitmap.h>
 
 #include <virgil/kernel/crypto.h>
 #include <virgil/kernel/foundation/data.h>
 
 #include "macro.h"
 
+#define ASYNC_REQUESTS_COUNT 8			/**< Count of simultaneous asynchronous requests */
+#define BIG_DATA_SIZE (256 * 1024)	/**< Size of data which doesn't fit into single message */
+#define BATCH_ITEMS_COUNT VIRGIL_BATCH_COUNT_MAX	/**< Count of items in batch request */
+
 static const char * text = "In 1971, ALOHAnet connected the Hawaiian Islands with a UHF wireless packet network.";
 
 /******************************************************************************/
@@ -74,6 +82,46 @@ static void password_based_encrypt_decrypt_test(void) {
 	virgil_data_free(&decrypted_data);
 }
 
+/******************************************************************************/
+static void big_data_encrypt_decrypt_test(void) {
+	const char * password = "test_password";
+	__u8 * big_data;
+	int i;
+
+	data_t data;
+	data_t encrypted_data;
+	data_t decrypted_data;
+
+	virgil_data_reset(&encrypted_data);
+	virgil_data_reset(&decrypted_data);
+
+	START_TEST("BIG DATA ENCRYPTION");
+
+	big_data = vmalloc(BIG_DATA_SIZE);
+	TEST_CASE("Prepare data", big_data);
+
+	for (i = 0; i < BIG_DATA_SIZE; ++i) {
+		big_data[i] = (__u8)i;
+	}
+
+	data.data = big_data;
+	data.sz = BIG_DATA_SIZE;
+
+	TEST_CASE_OK("Encrypt big data with password",
+			virgil_encrypt_with_password(password, data, &encrypted_data));
+
+	TEST_CASE_OK("Decrypt big data with password",
+			virgil_decrypt_with_password(password, encrypted_data, &decrypted_data));
+
+	TEST_CASE("Compare decrypted data",
+			decrypted_data.sz == BIG_DATA_SIZE && !memcmp(decrypted_data.data, big_data, BIG_DATA_SIZE));
+
+	terminate:
+	vfree(big_data);
+	virgil_data_free(&encrypted_data);
+	virgil_data_free(&decrypted_data);
+}
+
 /******************************************************************************/
 static void encrypt_decrypt_test(void) {
 	const char * identity_bob = "bob-identifier";
@@ -168,11 +216,314 @@ static void sign_verify_test(void) {
 	virgil_data_free(&public_key);
 }
 
+/******************************************************************************/
+static void scatterlist_sign_verify_test(void) {
+	data_t data;
+	data_t signature;
+	data_t private_key;
+	data_t public_key;
+	data_sg_t data_sg;
+	struct scatterlist sg[3];
+	__u8 * buf;
+	__u32 buf_sz, part_sz;
+	bool is_verified;
+
+	buf_sz = strlen(text) + 1;
+	buf = kmemdup(text, buf_sz, GFP_KERNEL);
+	part_sz = buf_sz / 3;
+
+	// Scatterlist data starts from second byte (offset inside of first entry)
+	data.data = buf + 1;
+	data.sz = buf_sz - 1;
+
+	START_TEST("SCATTERLIST SIGN VERIFY");
+
+	virgil_data_reset(&signature);
+	virgil_data_reset(&private_key);
+	virgil_data_reset(&public_key);
+
+	TEST_CASE("Prepare data", buf);
+
+	sg_init_table(sg, 3);
+	sg_set_buf(&sg[0], buf, part_sz);
+	sg_set_buf(&sg[1], buf + part_sz, part_sz);
+	sg_set_buf(&sg[2], buf + part_sz * 2, buf_sz - part_sz * 2);
+
+	memset(&data_sg, 0, sizeof(data_sg));
+	data_sg.sg = sg;
+	data_sg.offset = 1;
+	data_sg.sz = buf_sz - 1;
+
+	TEST_CASE_OK("Create key pair",
+			virgil_create_keypair(EC_NIST256, &private_key, &public_key));
+
+	TEST_CASE_OK("Sign scatterlist with private key",
+			virgil_sign_sg(private_key, &data_sg, &signature));
+
+	TEST_CASE("Verify linear data with public key",
+			VIRGIL_OPERATION_OK == virgil_verify_with_pubkey(public_key, data, signature, &is_verified) &&
+			is_verified);
+
+	TEST_CASE("Verify scatterlist with public key",
+			VIRGIL_OPERATION_OK == virgil_verify_with_pubkey_sg(public_key, &data_sg, signature, &is_verified) &&
+			is_verified);
+
+	data_sg.sz = buf_sz;
+	TEST_CASE("Reject data out of scatterlist",
+			VIRGIL_OPERATION_OK != virgil_verify_with_pubkey_sg(public_key, &data_sg, signature, &is_verified));
+
+	terminate:;
+	kfree(buf);
+	virgil_data_free(&signature);
+	virgil_data_free(&private_key);
+	virgil_data_free(&public_key);
+}
+
+/******************************************************************************/
+static void hash_test(void) {
+	static const __u8 abc_sha256[] = {
+			0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+			0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+	};
+	data_t data;
+	data_t hash_data;
+	data_t hash_sg_data;
+	data_sg_t data_sg;
+	struct scatterlist sg[2];
+	__u8 * buf;
+
+	buf = kmemdup("abc", 3, GFP_KERNEL);
+	data.data = buf;
+	data.sz = 3;
+
+	START_TEST("HASH");
+
+	virgil_data_reset(&hash_data);
+	virgil_data_reset(&hash_sg_data);
+
+	TEST_CASE("Prepare data", buf);
+
+	sg_init_table(sg, 2);
+	sg_set_buf(&sg[0], buf, 1);
+	sg_set_buf(&sg[1], buf + 1, 2);
+
+	memset(&data_sg, 0, sizeof(data_sg));
+	data_sg.sg = sg;
+	data_sg.sz = 3;
+
+	TEST_CASE_OK("Create SHA-256",
+			virgil_hash(HASH_SHA256, data, &hash_data));
+
+	TEST_CASE("Check SHA-256",
+			sizeof(abc_sha256) == hash_data.sz && !memcmp(hash_data.data, abc_sha256, sizeof(abc_sha256)));
+
+	TEST_CASE_OK("Create SHA-256 of scatterlist",
+			virgil_hash_sg(HASH_SHA256, &data_sg, &hash_sg_data));
+
+	TEST_CASE("Compare hashes",
+			hash_data.sz == hash_sg_data.sz && !memcmp(hash_data.data, hash_sg_data.data, hash_data.sz));
+
+	terminate:;
+	kfree(buf);
+	virgil_data_free(&hash_data);
+	virgil_data_free(&hash_sg_data);
+}
+
+/******************************************************************************/
+static void async_sign_verify_test(void) {
+	data_t data;
+	data_t signatures[ASYNC_REQUESTS_COUNT];
+	data_t private_key;
+	data_t public_key;
+	virgil_request_t * requests[ASYNC_REQUESTS_COUNT];
+	virgil_request_opts_t opts;
+	bool is_verified;
+	int i, res;
+
+	data.data = (void *)text;
+	data.sz = strlen(text) + 1;
+	memset(&opts, 0, sizeof(opts));
+
+	START_TEST("ASYNC SIGN VERIFY");
+
+	virgil_data_reset(&private_key);
+	virgil_data_reset(&public_key);
+	for (i = 0; i < ASYNC_REQUESTS_COUNT; ++i) {
+		virgil_data_reset(&signatures[i]);
+		requests[i] = 0;
+	}
+
+	TEST_CASE_OK("Create key pair",
+			virgil_create_keypair(EC_NIST256, &private_key, &public_key));
+
+	for (i = 0; i < ASYNC_REQUESTS_COUNT; ++i) {
+		TEST_CASE_OK("Submit sign of data",
+				virgil_sign_submit(private_key, data, 0, &requests[i]));
+	}
+
+	TEST_CASE_OK("Wait for all sign requests",
+			virgil_request_wait_all(requests, ASYNC_REQUESTS_COUNT, VIRGIL_OPERATION_TIMEOUT_MS));
+
+	for (i = 0; i < ASYNC_REQUESTS_COUNT; ++i) {
+		res = virgil_sign_result(requests[i], &signatures[i]);
+		requests[i] = 0;
+		TEST_CASE_OK("Get signature", res);
+	}
+
+	opts.batch = virgil_batch_create(GFP_KERNEL);
+	TEST_CASE("Create batch of requests", 0 != opts.batch);
+
+	for (i = 0; i < ASYNC_REQUESTS_COUNT; ++i) {
+		TEST_CASE_OK("Submit verification of signature in batch",
+				virgil_verify_with_pubkey_submit(public_key, data, signatures[i], &opts, &requests[i]));
+	}
+
+	TEST_CASE_OK("Send batch of requests", virgil_batch_flush(opts.batch));
+
+	for (i = 0; i < ASYNC_REQUESTS_COUNT; ++i) {
+		res = virgil_verify_result(requests[i], &is_verified);
+		requests[i] = 0;
+		TEST_CASE("Get verification result", VIRGIL_OPERATION_OK == res && is_verified);
+	}
+
+	terminate:
+	for (i = 0; i < ASYNC_REQUESTS_COUNT; ++i) {
+		virgil_request_free(requests[i]);
+		virgil_data_free(&signatures[i]);
+	}
+	virgil_batch_free(opts.batch);
+	virgil_data_free(&private_key);
+	virgil_data_free(&public_key);
+}
+
+/******************************************************************************/
+static void batch_verify_test(int ec_type, const char * name) {
+	data_t data;
+	data_t wrong_data;
+	data_t signature;
+	data_t private_key;
+	data_t public_key;
+	virgil_verify_item_t * items;
+	unsigned long verified[BITS_TO_LONGS(BATCH_ITEMS_COUNT)];
+	int i;
+
+	data.data = (void *)text;
+	data.sz = strlen(text) + 1;
+
+	// The last item has signature of other data
+	wrong_data.data = (void *)text;
+	wrong_data.sz = strlen(text);
+
+	START_TEST(name);
+
+	virgil_data_reset(&signature);
+	virgil_data_reset(&private_key);
+	virgil_data_reset(&public_key);
+
+	items = kcalloc(BATCH_ITEMS_COUNT, sizeof(*items), GFP_KERNEL);
+
+	TEST_CASE("Allocate items of batch", items);
+
+	TEST_CASE_OK("Create key pair",
+			virgil_create_keypair(ec_type, &private_key, &public_key));
+
+	TEST_CASE_OK("Sign data with private key",
+			virgil_sign(private_key, data, &signature));
+
+	for (i = 0; i < BATCH_ITEMS_COUNT; ++i) {
+		items[i].key = public_key;
+		items[i].is_cert = false;
+		items[i].data = i == BATCH_ITEMS_COUNT - 1 ? wrong_data : data;
+		items[i].signature = signature;
+	}
+
+	TEST_CASE_OK("Verify batch of signatures (maximum count of items)",
+			virgil_verify_batch(BATCH_ITEMS_COUNT, items, verified));
+
+	TEST_CASE("Only signatures of signed data are valid",
+			BATCH_ITEMS_COUNT - 1 == bitmap_weight(verified, BATCH_ITEMS_COUNT) &&
+			!test_bit(BATCH_ITEMS_COUNT - 1, verified));
+
+	terminate:;
+	kfree(items);
+	virgil_data_free(&signature);
+	virgil_data_free(&private_key);
+	virgil_data_free(&public_key);
+}
+
+/******************************************************************************/
+static void batch_sign_test(void) {
+	__u32 * values;
+	data_t * data;
+	data_t * signatures;
+	data_t private_key;
+	data_t public_key;
+	virgil_verify_item_t * items;
+	unsigned long verified[BITS_TO_LONGS(BATCH_ITEMS_COUNT)];
+	int i;
+
+	START_TEST("BATCH SIGN");
+
+	virgil_data_reset(&private_key);
+	virgil_data_reset(&public_key);
+
+	values = kcalloc(BATCH_ITEMS_COUNT, sizeof(*values), GFP_KERNEL);
+	data = kcalloc(BATCH_ITEMS_COUNT, sizeof(*data), GFP_KERNEL);
+	signatures = kcalloc(BATCH_ITEMS_COUNT, sizeof(*signatures), GFP_KERNEL);
+	items = kcalloc(BATCH_ITEMS_COUNT, sizeof(*items), GFP_KERNEL);
+
+	TEST_CASE("Allocate items of batch", values && data && signatures && items);
+
+	// Each item is its own index
+	for (i = 0; i < BATCH_ITEMS_COUNT; ++i) {
+		values[i] = i;
+		data[i].data = &values[i];
+		data[i].sz = sizeof(values[i]);
+	}
+
+	TEST_CASE_OK("Create key pair",
+			virgil_create_keypair(EC_BP_256, &private_key, &public_key));
+
+	TEST_CASE_OK("Sign batch of data with private key (maximum count of items)",
+			virgil_sign_batch(private_key, BATCH_ITEMS_COUNT, data, signatures));
+
+	for (i = 0; i < BATCH_ITEMS_COUNT; ++i) {
+		items[i].key = public_key;
+		items[i].is_cert = false;
+		items[i].data = data[i];
+		items[i].signature = signatures[i];
+	}
+
+	TEST_CASE("All signatures of batch are valid",
+			VIRGIL_OPERATION_OK == virgil_verify_batch(BATCH_ITEMS_COUNT, items, verified) &&
+			BATCH_ITEMS_COUNT == bitmap_weight(verified, BATCH_ITEMS_COUNT));
+
+	terminate:;
+	if (signatures) {
+		for (i = 0; i < BATCH_ITEMS_COUNT; ++i) {
+			virgil_data_free(&signatures[i]);
+		}
+	}
+	kfree(items);
+	kfree(signatures);
+	kfree(data);
+	kfree(values);
+	virgil_data_free(&private_key);
+	virgil_data_free(&public_key);
+}
+
 /******************************************************************************/
 void crypto_test(void) {
 	START_TEST("CRYPTO");
 
 	password_based_encrypt_decrypt_test();
+	big_data_encrypt_decrypt_test();
 	encrypt_decrypt_test();
 	sign_verify_test();
+	scatterlist_sign_verify_test();
+	hash_test();
+	async_sign_verify_test();
+	batch_verify_test(EC_NIST256, "BATCH VERIFY (NIST P-256)");
+	batch_verify_test(EC_BP_256, "BATCH VERIFY (BRAINPOOL P-256)");
+	batch_sign_test();
 }
@@ -70,6 +70,9 @@ static void main_actions_test(void) {
 	// Temporary data
 	data_t alice_cert_tmp;
 	data_t bob_cert_tmp;
+	data_t alice_hashed_id8;
+	data_t signer_cert;
+	data_t signer_key;
 	bool is_ok;
 
 	data_t data;
@@ -95,6 +98,9 @@ static void main_actions_test(void) {
 	// Clear temp data
 	virgil_data_reset(&alice_cert_tmp);
 	virgil_data_reset(&bob_cert_tmp);
+	virgil_data_reset(&alice_hashed_id8);
+	virgil_data_reset(&signer_cert);
+	virgil_data_reset(&signer_key);
 	virgil_data_reset(&data);
 	virgil_data_reset(&encrypted_data);
 	virgil_data_reset(&decrypted_data);
@@ -203,9 +209,24 @@ static void main_actions_test(void) {
 			VIRGIL_OPERATION_OK == virgil_ieee1609_verify_cert(alice_cert_tmp, &is_ok) &&
 			is_ok);
 
+	is_ok = 0;
+
+	TEST_CASE("BOB verifies the same certificate again (result is cached in kernel).",
+			VIRGIL_OPERATION_OK == virgil_ieee1609_verify_cert(alice_cert_tmp, &is_ok) &&
+			is_ok);
+
 	TEST_CASE_OK("The certificate is valid, so BOB can save it in the local cache.",
 			virgil_ieee1609_add_cert(alice_cert_tmp, false));
 
+	TEST_CASE_OK("Create HashedId8 of ALICE's certificate",
+			virgil_ieee1609_hashed_id8(alice_cert_tmp, &alice_hashed_id8));
+
+	TEST_CASE("BOB finds ALICE's certificate and public key by HashedId8 (without user-space service)",
+			VIRGIL_OPERATION_OK == virgil_ieee1609_cert_by_hashed_id8(alice_hashed_id8, &signer_cert, &signer_key) &&
+			signer_cert.sz == alice_cert_tmp.sz &&
+			0 == memcmp(signer_cert.data, alice_cert_tmp.data, signer_cert.sz) &&
+			signer_key.sz);
+
 	LOG("Now both devices have own crypto material and opponent's certificates. So, we have all need for secure communication.");
 
 
@@ -248,6 +269,9 @@ static void main_actions_test(void) {
 	TEST_CASE_OK("Check certificate deletion",
 			virgil_ieee1609_delete_cert(alice_cert_tmp));
 
+	TEST_CASE("Deleted certificate isn't found by HashedId8",
+			VIRGIL_OPERATION_UNAVAILABLE == virgil_ieee1609_cert_by_hashed_id8(alice_hashed_id8, 0, 0));
+
 	TEST_CASE_OK("Remove CMH for ALICE",
 			virgil_ieee1609_cmh_delete(alice_cmh));
 
@@ -268,6 +292,9 @@ static void main_actions_test(void) {
 
 	virgil_data_free(&alice_cert_tmp);
 	virgil_data_free(&bob_cert_tmp);
+	virgil_data_free(&alice_hashed_id8);
+	virgil_data_free(&signer_cert);
+	virgil_data_free(&signer_key);
 	virgil_data_free(&signature);
 
 	virgil_kv_free(&read_kv);
@@ -360,6 +387,11 @@ static void addition_actions_test(void) {
 						certificate,
 						&is_revoked));
 
+	TEST_CASE_OK("Check is certificate revoked again (id of certificate is known in kernel)",
+			virgil_ieee1609_check_revocation(
+						certificate,
+						&is_revoked));
+
 #if 0
 	LOG("Certificate is : %s", is_revoked ? "REVOKED" : "NOT REVOKED");
 #endif
@@ -85,6 +85,40 @@ static void save_load_test(void) {
 	virgil_data_free(&loaded_data);
 }
 
+/******************************************************************************/
+static void cached_load_test(void) {
+	virgil_request_t * request;
+
+	_fillData(&data_for_save, VIRGIL_KEYSTORAGE_PERMANENT_KEY_MAX_SIZE / 4);
+
+	TEST_CASE_OK("Save data",
+			virgil_save_key(key_id, data_for_save, VIRGIL_KEY_PERMANENT));
+
+	TEST_CASE_OK("Load data (key is cached)",
+			virgil_load_key(key_id, &loaded_data));
+	virgil_data_free(&loaded_data);
+
+	TEST_CASE_OK("Load cached data",
+			virgil_load_key(key_id, &loaded_data));
+
+	TEST_CASE("Compare data",
+			0 == memcmp(data_for_save.data, loaded_data.data, loaded_data.sz) && data_for_save.sz == loaded_data.sz);
+	virgil_data_free(&loaded_data);
+
+	TEST_CASE_OK("Submit load of cached data",
+			virgil_load_encrypted_key_submit(key_id, 0, 0, &request));
+
+	TEST_CASE_OK("Get result of load of cached data",
+			virgil_load_key_result(request, &loaded_data));
+
+	TEST_CASE("Compare data",
+			0 == memcmp(data_for_save.data, loaded_data.data, loaded_data.sz) && data_for_save.sz == loaded_data.sz);
+
+	terminate:
+	virgil_data_free(&data_for_save);
+	virgil_data_free(&loaded_data);
+}
+
 /******************************************************************************/
 static void update_test(void) {
 	virgil_data_free(&loaded_data);
@@ -213,6 +247,7 @@ void key_storage_test(void) {
 	START_TEST("KEY STORAGE");
 
 	save_load_test();
+	cached_load_test();
 	update_test();
 	abnormal_params_test();
 	remove_test();
@@ -44,6 +44,7 @@
 
 #include <virgil/kernel/types.h>
 #include <virgil/kernel/foundation/key-value.h>
+#include <virgil/kernel/request.h>
 #include <linux/capability.h>
 #include <linux/errno.h>
 
@@ -142,4 +143,178 @@ extern int virgil_certificate_is_revoked(data_t certificate, bool * is_revoked);
  */
 extern int virgil_certificate_get_identity(data_t certificate, char ** identity);
 
+/*
+ * Asynchronous calls.
+ * xxx_submit sends request and returns immediately, xxx_result waits for response and parses it.
+ */
+
+/**
+ * @brief Submit creation of certificate and private key.
+ *
+ * @param[in] ec_type           - Eliptic curve type
+ * @param[in] identity          - identity.
+ * @param[in] addition_data     - key/value array with addition data.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_create_submit(
+		int ec_type,
+		const char * identity,
+		kv_container_t addition_data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of certificate creation.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] private_key      - generated private key.
+ * @param[out] certificate      - created certificate.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_create_result(virgil_request_t * request,
+		data_t * private_key, data_t * certificate);
+
+/**
+ * @brief Submit request of certificate by Identity from Virgil Service.
+ *
+ * @param[in] identity          - identity.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_get_submit(const char * identity,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of certificate request.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] certificate      - certificate.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_get_result(virgil_request_t * request, data_t * certificate);
+
+/**
+ * @brief Submit verification of certificate's signature using root certificate.
+ *
+ * @param[in] certificate       - certificate.
+ * @param[in] root_certificate  - root_certificate.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_verify_submit(data_t certificate, data_t root_certificate,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of certificate verification.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] is_ok            - 1 - if has been done successfully.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_verify_result(virgil_request_t * request, bool * is_ok);
+
+/**
+ * @brief Submit parse of certificate data.
+ *
+ * @param[in] certificate       - certificate.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_parse_submit(data_t certificate,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of certificate parse.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] cert_data        - data in certificate.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_parse_result(virgil_request_t * request, kv_container_t * cert_data);
+
+/**
+ * @brief Submit revocation of a Virgil Certificate.
+ *
+ * @param[in] identity          - identity.
+ * @param[in] private_key       - private key data.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_revoke_submit(const char * identity, data_t private_key,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of certificate revocation.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] is_ok            - 1 - if has been done successfully.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_revoke_result(virgil_request_t * request, bool * is_ok);
+
+/**
+ * @brief Submit request of CRL info.
+ *
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_crl_info_submit(const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of CRL info request.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] last             - Time of last CRL request.
+ * @param[out] next             - Time of next CRL request.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_crl_info_result(virgil_request_t * request, time_t * last, time_t * next);
+
+/**
+ * @brief Submit check of a certificate for revocation.
+ *
+ * @param[in] certificate       - certificate data.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_is_revoked_submit(data_t certificate,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of certificate revocation check.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] is_revoked       - Boolean value of revocation state.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_certificate_is_revoked_result(virgil_request_t * request, bool * is_revoked);
+
 #endif /* VIRGIL_CERTIFICATES_H */
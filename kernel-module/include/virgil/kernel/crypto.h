@@ -38,7 +38,7 @@
  * @file crypto.h
  * @brief API to crypto functions.
  * Encryption/decryption, data sign and verification.
- * Synchronous calls.
+ * Synchronous calls and asynchronous submit/result pairs.
  */
 
 #ifndef VIRGIL_CRYPTO_H
@@ -46,11 +46,28 @@
 
 #include <virgil/kernel/types.h>
 #include <virgil/kernel/foundation/data.h>
+#include <virgil/kernel/request.h>
 
 #define EC_NIST256		0	/**< Eliptic curve Nist 256 */
 #define EC_BP_256		1	/**< Eliptic curve Brain Poll 256 */
 #define EC_25519		2	/**< Eliptic curve 25519 */
 
+#define HASH_SHA256		0	/**< Hash is SHA-256 */
+#define HASH_SHA384		1	/**< Hash is SHA-384 */
+#define HASH_SHA512		2	/**< Hash is SHA-512 */
+#define HASH_MD5		3	/**< Hash is MD5 */
+
+/**
+ * @struct virgil_verify_item_t
+ * Item of batch signature verification
+ */
+typedef struct {
+	data_t key;				/**< Public key or certificate */
+	bool is_cert;			/**< Key is certificate */
+	data_t data;			/**< Signed data */
+	data_t signature;		/**< Signature */
+} virgil_verify_item_t;
+
 /**
  * @brief Create key pair.
  *
@@ -163,7 +180,8 @@ extern int virgil_verify_with_pubkey(data_t public_key, data_t data, data_t sign
 extern int virgil_verify_with_cert(data_t cert, data_t data, data_t signature, bool * is_verified);
 
 /**
- * @brief Create SHA-256.
+ * @brief Create hash.
+ * Hash is created in kernel if algorithm is available there, user-space service is used otherwise.
  *
  * @param[in] hash_type		- identifier of hash function (look at defines like HASH_xxx)
  * @param[in] data          - data.
@@ -173,4 +191,484 @@ extern int virgil_verify_with_cert(data_t cert, data_t data, data_t signature, b
  */
 extern int virgil_hash(__u8 hash_type, data_t data, data_t * hash_data);
 
+/*
+ * Asynchronous calls.
+ * xxx_submit sends request and returns immediately, xxx_result waits for response and parses it.
+ */
+
+/**
+ * @brief Submit key pair creation.
+ *
+ * @param[in]  ec_type           - Eliptic curve type
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_create_keypair_submit(int ec_type,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of key pair creation.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] private_key      - generated private key.
+ * @param[out] public_key       - generated public key.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_create_keypair_result(virgil_request_t * request,
+		data_t * private_key, data_t * public_key);
+
+/**
+ * @brief Submit encryption of data with password.
+ *
+ * @param[in] password          - password string.
+ * @param[in] data              - data for encryption.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_encrypt_with_password_submit(const char * password, data_t data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Submit encryption of data for given recipients with public keys and identities.
+ *
+ * @param[in] recipients_count  - count of recipients of the encrypted message.
+ * @param[in] public_keys       - array with public keys.
+ * @param[in] identities        - array with identities.
+ * @param[in] data              - data for encryption.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_encrypt_with_pubkey_submit(__u32 recipients_count,
+		const data_t * public_keys, const char ** identities, data_t data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Submit encryption of data for given recipients with certificate.
+ *
+ * @param[in] recipients_count  - count of recipients of the encrypted message.
+ * @param[in] certificates      - array with certificates.
+ * @param[in] data              - data for encryption.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_encrypt_with_cert_submit(__u32 recipients_count,
+		const data_t * certificates, data_t data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of any encryption request.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] enc_data         - encrypted data.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_encrypt_result(virgil_request_t * request, data_t * enc_data);
+
+/**
+ * @brief Submit decryption of data with given password.
+ *
+ * @param[in] password          - password string.
+ * @param[in] data              - data for decryption.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_decrypt_with_password_submit(const char * password, data_t data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Submit decryption of data with given Private Key.
+ *
+ * @param[in] private_key       - private key data.
+ * @param[in] data              - data for decryption.
+ * @param[in] identity          - identity of recipient.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_decrypt_with_key_submit(data_t private_key, data_t data, const char * identity,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of any decryption request.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] decrypted_data   - decrypted data.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_decrypt_result(virgil_request_t * request, data_t * decrypted_data);
+
+/**
+ * @brief Submit data sign.
+ *
+ * @param[in] private_key       - private key data.
+ * @param[in] data              - data to be signed.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_sign_submit(data_t private_key, data_t data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of data sign.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] signature        - created signature.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_sign_result(virgil_request_t * request, data_t * signature);
+
+/**
+ * @brief Submit signature verification using public key.
+ *
+ * @param[in] public_key        - public key data.
+ * @param[in] data              - signed data.
+ * @param[in] signature         - signature data.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_verify_with_pubkey_submit(data_t public_key, data_t data, data_t signature,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Submit signature verification using certificate.
+ *
+ * @param[in] cert              - certificate data.
+ * @param[in] data              - signed data.
+ * @param[in] signature         - signature data.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_verify_with_cert_submit(data_t cert, data_t data, data_t signature,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of any signature verification request.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] is_verified      - 1 - verification has been done successfully.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_verify_result(virgil_request_t * request, bool * is_verified);
+
+/**
+ * @brief Submit hash creation.
+ *
+ * @param[in] hash_type         - identifier of hash function (look at defines like HASH_xxx)
+ * @param[in] data              - data.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_hash_submit(__u8 hash_type, data_t data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of hash creation.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] hash_data        - hash data.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_hash_result(virgil_request_t * request, data_t * hash_data);
+
+/*
+ * Calls with non-linear data (scatterlist or part of socket buffer).
+ * Data is serialized directly into request without linearization, results are parsed by xxx_result above.
+ */
+
+/**
+ * @brief Encrypt non-linear data with password.
+ *
+ * @param[in] password      - password string.
+ * @param[in] data          - data for encryption.
+ * @param[out] enc_data     - encrypted data.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_encrypt_with_password_sg(const char * password, const data_sg_t * data, data_t * enc_data);
+
+/**
+ * @brief Encrypt non-linear data for given recipients with public keys and identities.
+ *
+ * @param[in] recipients_count  - count of recipients of the encrypted message.
+ * @param[in] public_keys       - array with public keys.
+ * @param[in] identities        - array with identities.
+ * @param[in] data              - data for encryption.
+ * @param[out] enc_data         - encrypted data.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_encrypt_with_pubkey_sg(__u32 recipients_count,
+        const data_t * public_keys, const char ** identities,
+        const data_sg_t * data, data_t * enc_data);
+
+/**
+ * @brief Encrypt non-linear data for given recipients with certificate.
+ *
+ * @param[in] recipients_count  - count of recipients of the encrypted message.
+ * @param[in] certificates      - array with certificates.
+ * @param[in] data              - data for encryption.
+ * @param[out] enc_data         - encrypted data.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_encrypt_with_cert_sg(__u32 recipients_count,
+        const data_t * certificates,
+        const data_sg_t * data, data_t * enc_data);
+
+/**
+ * @brief Sign non-linear data.
+ *
+ * @param[in] private_key       - private key data.
+ * @param[in] data              - data to be signed.
+ * @param[out] signature        - created signature.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_sign_sg(data_t private_key, const data_sg_t * data, data_t * signature);
+
+/**
+ * @brief Verify signature of non-linear data using public key.
+ *
+ * @param[in] public_key        - public key data.
+ * @param[in] data              - signed data.
+ * @param[in] signature         - signature data.
+ * @param[out] is_verified      - 1 - verification has been done successfully.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_verify_with_pubkey_sg(data_t public_key, const data_sg_t * data, data_t signature, bool * is_verified);
+
+/**
+ * @brief Verify signature of non-linear data using certificate.
+ *
+ * @param[in] cert              - certificate data.
+ * @param[in] data              - signed data.
+ * @param[in] signature         - signature data.
+ * @param[out] is_verified      - 1 - verification has been done successfully.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_verify_with_cert_sg(data_t cert, const data_sg_t * data, data_t signature, bool * is_verified);
+
+/**
+ * @brief Create hash of non-linear data.
+ *
+ * @param[in] hash_type         - identifier of hash function (look at defines like HASH_xxx)
+ * @param[in] data              - data.
+ * @param[out] hash_data        - hash data.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_hash_sg(__u8 hash_type, const data_sg_t * data, data_t * hash_data);
+
+/**
+ * @brief Submit encryption of non-linear data with password.
+ *
+ * @param[in] password          - password string.
+ * @param[in] data              - data for encryption.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_encrypt_with_password_sg_submit(const char * password, const data_sg_t * data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Submit encryption of non-linear data for given recipients with public keys and identities.
+ *
+ * @param[in] recipients_count  - count of recipients of the encrypted message.
+ * @param[in] public_keys       - array with public keys.
+ * @param[in] identities        - array with identities.
+ * @param[in] data              - data for encryption.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_encrypt_with_pubkey_sg_submit(__u32 recipients_count,
+		const data_t * public_keys, const char ** identities, const data_sg_t * data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Submit encryption of non-linear data for given recipients with certificate.
+ *
+ * @param[in] recipients_count  - count of recipients of the encrypted message.
+ * @param[in] certificates      - array with certificates.
+ * @param[in] data              - data for encryption.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_encrypt_with_cert_sg_submit(__u32 recipients_count,
+		const data_t * certificates, const data_sg_t * data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Submit sign of non-linear data.
+ *
+ * @param[in] private_key       - private key data.
+ * @param[in] data              - data to be signed.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_sign_sg_submit(data_t private_key, const data_sg_t * data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Submit signature verification of non-linear data using public key.
+ *
+ * @param[in] public_key        - public key data.
+ * @param[in] data              - signed data.
+ * @param[in] signature         - signature data.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_verify_with_pubkey_sg_submit(data_t public_key, const data_sg_t * data, data_t signature,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Submit signature verification of non-linear data using certificate.
+ *
+ * @param[in] cert              - certificate data.
+ * @param[in] data              - signed data.
+ * @param[in] signature         - signature data.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_verify_with_cert_sg_submit(data_t cert, const data_sg_t * data, data_t signature,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Submit hash creation of non-linear data.
+ *
+ * @param[in] hash_type         - identifier of hash function (look at defines like HASH_xxx)
+ * @param[in] data              - data.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_hash_sg_submit(__u8 hash_type, const data_sg_t * data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/*
+ * Batch calls.
+ * Many items are sent in one request and are processed by pool of threads of user-space service.
+ */
+
+/**
+ * @brief Verify signatures of many data items.
+ * Signatures with NIST P-256 public keys are verified in kernel if all items of batch can be verified there.
+ *
+ * @param[in] count             - count of items (up to VIRGIL_BATCH_COUNT_MAX).
+ * @param[in] items             - items for verification.
+ * @param[out] verified         - bitmap (BITS_TO_LONGS(count) longs), bit of item is set if its signature is valid.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_verify_batch(__u32 count, const virgil_verify_item_t * items, unsigned long * verified);
+
+/**
+ * @brief Submit verification of signatures of many data items.
+ *
+ * @param[in] count             - count of items (up to VIRGIL_BATCH_COUNT_MAX).
+ * @param[in] items             - items for verification.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_verify_batch_submit(__u32 count, const virgil_verify_item_t * items,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of batch signature verification.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[in] count             - count of items in request.
+ * @param[out] verified         - bitmap (BITS_TO_LONGS(count) longs), bit of item is set if its signature is valid.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_verify_batch_result(virgil_request_t * request, __u32 count, unsigned long * verified);
+
+/**
+ * @brief Sign many data items with one private key.
+ * Private key is sent once for all items.
+ *
+ * @param[in] private_key       - private key data.
+ * @param[in] count             - count of data items (up to VIRGIL_BATCH_COUNT_MAX).
+ * @param[in] data              - data items to be signed.
+ * @param[out] signatures       - created signatures (array of count elements).
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_sign_batch(data_t private_key, __u32 count, const data_t * data, data_t * signatures);
+
+/**
+ * @brief Submit signing of many data items with one private key.
+ *
+ * @param[in] private_key       - private key data.
+ * @param[in] count             - count of data items (up to VIRGIL_BATCH_COUNT_MAX).
+ * @param[in] data              - data items to be signed.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_sign_batch_submit(data_t private_key, __u32 count, const data_t * data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of batch signing.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[in] count             - count of data items in request.
+ * @param[out] signatures       - created signatures (array of count elements).
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_sign_batch_result(virgil_request_t * request, __u32 count, data_t * signatures);
+
 #endif /* VIRGIL_CRYPTO_H */
@@ -54,6 +54,21 @@ typedef struct {
     __u32 sz;               /**< Size of data*/
 } data_t;
 
+struct scatterlist;
+struct sk_buff;
+
+/**
+ * @struct data_sg_t
+ * Non-linear data: part of scatterlist or socket buffer.
+ * Data is serialized directly into request (or its copy) during submit, so it can be released after submit.
+ */
+typedef struct {
+    struct scatterlist * sg;    /**< Scatterlist with data (0 if socket buffer is used) */
+    struct sk_buff * skb;       /**< Socket buffer with data (0 if scatterlist is used) */
+    __u32 offset;               /**< Offset of data in scatterlist or socket buffer */
+    __u32 sz;                   /**< Size of data */
+} data_sg_t;
+
 /**
  * @brief Clear data structure.
  *
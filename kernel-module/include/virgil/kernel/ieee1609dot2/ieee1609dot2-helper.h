@@ -44,6 +44,8 @@
 
 #include <virgil/kernel/types.h>
 #include <virgil/kernel/key-storage.h>
+#include <virgil/kernel/crypto.h>
+#include <virgil/kernel/foundation/key-value.h>
 
 #define ALGORITHM_ECDSA_BP256R1_SHA256	0 		/**< Analog for ecdsaBrainpoolP256r1WithSha256 in IEEE1609.2 */
 #define ALGORITHM_ECDSA_NIST256_SHA256	1 		/**< Analog for ecdsaNistP256WithSha256  in IEEE1609.2 */
@@ -51,7 +53,6 @@
 #define ALGORITHM_ECIES_BP256R1			3 		/**< Analog for eciesBrainpoolP256r1 in IEEE1609.2 */
 
 #define ALGORITHM_SYMMETRIC_AES256_CCM	100 	/**< Analog for aes256-ccm  in IEEE1609.2 */
-#define HASH_SHA256						0		/**< Hash is SHA-256 */
 
 #define KEY_TYPE_PRIVATE				0		/**< Private key. Helper description of key to be stored or loaded */
 #define KEY_TYPE_PUBLIC					1		/**< Public key. Helper description of key to be stored or loaded */
@@ -60,6 +61,8 @@
 
 #define ROOT_CERTIFICATE_CMH			0 		/**< Crypto material handle for Root certificate */
 
+#define HASHED_ID8_SIZE					8		/**< Size of HashedId8 (low-order 8 bytes of SHA-256) */
+
 /** Type definition for Crypto Material Handle */
 typedef __u64 cmh_t;
 
@@ -246,15 +249,43 @@ extern int virgil_ieee1609_cmh_delete(cmh_t cmh);
 extern int virgil_ieee1609_cmh_sign(cmh_t cmh, data_t data, data_t * signature);
 
 /**
- * @brief Create HashedId8 for data.
+ * @brief Sign many data items using crypto material handler.
+ * Private key is loaded once and is sent once for all items.
+ *
+ * @param[in] cmh       		- crypto material handler.
+ * @param[in] count             - count of data items (up to VIRGIL_BATCH_COUNT_MAX).
+ * @param[in] data              - data items to be signed.
+ * @param[out] signatures       - created signatures (array of count elements).
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_ieee1609_cmh_sign_batch(cmh_t cmh, __u32 count, const data_t * data, data_t * signatures);
+
+/**
+ * @brief Create HashedId8 for data (low-order 8 bytes of SHA-256).
+ * Hash is created in kernel if SHA-256 is available in kernel crypto API.
  *
  * @param[in] data            - data for hash creation.
- * @param[out] hashed_id8     - HashedId8.
+ * @param[out] hashed_id8     - HashedId8 (HASHED_ID8_SIZE bytes).
  *
  * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
  */
 extern int virgil_ieee1609_hashed_id8(data_t data, data_t * hashed_id8);
 
+/**
+ * @brief Get certificate and its public key by HashedId8 of certificate.
+ * Certificates added with virgil_ieee1609_add_cert are kept in kernel, so lookup doesn't need
+ * request to user-space service and can be done in atomic context.
+ *
+ * @param[in] hashed_id8      - HashedId8 of certificate.
+ * @param[out] certificate    - certificate (can be NULL).
+ * @param[out] public_key     - public key of certificate (can be NULL).
+ *
+ * @return [VIRGIL_OPERATION_OK, VIRGIL_OPERATION_UNAVAILABLE if certificate isn't known
+ * or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_ieee1609_cert_by_hashed_id8(data_t hashed_id8, data_t * certificate, data_t * public_key);
+
 /**
  * @brief Make transformation of a private key.
  *
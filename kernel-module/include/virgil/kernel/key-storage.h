@@ -38,13 +38,14 @@
  * @file key-storage.h
  * @brief API to key storage and caching functions.
  * Save, load and revoke keys. Can be used encryption for any key.
- * Synchronous calls.
+ * Synchronous calls and asynchronous submit/result pairs.
  */
 
 #ifndef VIRGIL_KEY_STORAGE_H
 #define VIRGIL_KEY_STORAGE_H
 
 #include <virgil/kernel/foundation/data.h>
+#include <virgil/kernel/request.h>
 
 // TODO: Make these parameters configurable
 #define VIRGIL_KEYSTORAGE_ID_MAX_SIZE 				100				/**< Maximum size of key identifier */
@@ -111,4 +112,81 @@ extern int virgil_load_key(const char * key_id, data_t * loaded_key);
  */
 extern int virgil_revoke_key(const char * key_id);
 
+/*
+ * Asynchronous calls.
+ * xxx_submit sends request and returns immediately, xxx_result waits for response and parses it.
+ */
+
+/**
+ * @brief Submit save of key with encryption.
+ *
+ * @param[in] key_id            - unique of key identifier.
+ * @param[in] key               - key for save.
+ * @param[in] key_type          - key type (permanent key or temporary).
+ * @param[in] key_password      - password for key encryption before save (can be 0).
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_save_encrypted_key_submit(const char * key_id,
+        data_t key, __u16 key_type, const char * key_password,
+        const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of key save.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_save_key_result(virgil_request_t * request);
+
+/**
+ * @brief Submit load of encrypted key.
+ *
+ * @param[in] key_id            - unique of key identifier.
+ * @param[in] key_password      - password for key decryption (can be 0).
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_load_encrypted_key_submit(const char * key_id, const char * key_password,
+        const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of key load.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ * @param[out] loaded_key       - loaded key.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_load_key_result(virgil_request_t * request, data_t * loaded_key);
+
+/**
+ * @brief Submit key revocation.
+ *
+ * @param[in] key_id            - unique of key identifier.
+ * @param[in] opts              - request options (can be 0).
+ * @param[out] request          - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_revoke_key_submit(const char * key_id,
+        const virgil_request_opts_t * opts, virgil_request_t ** request);
+
+/**
+ * @brief Get result of key revocation.
+ * Request handle is released.
+ *
+ * @param[in] request           - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_revoke_key_result(virgil_request_t * request);
+
 #endif /* VIRGIL_KEY_STORAGE_H */
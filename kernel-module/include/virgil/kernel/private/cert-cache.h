@@ -0,0 +1,161 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file cert-cache.h
+ * @brief Cache of results of certificate verification and pinned root certificate.
+ *
+ * Result of verification is kept by digest of certificate and root certificate, so change of root
+ * certificate doesn't return old results. All results are dropped when worker of user-space service
+ * receives new CRL (VIRGIL_CMD_CRL_CHANGED), revocation set of the notice is passed to revocation.h.
+ * Only definitive answers are cached and each of them is used during limited time (cert_cache_ttl_s).
+ * Lookups are lock-free (RCU).
+ * Root certificate of IEEE1609.2 helpers is kept in kernel after first load.
+ */
+
+#ifndef CERT_CACHE_H
+#define CERT_CACHE_H
+
+#include <linux/module.h>
+
+#include <virgil/kernel/types.h>
+#include <virgil/kernel/foundation/data.h>
+#include <virgil/kernel/private/fields.h>
+
+#define VIRGIL_CERT_CACHE_HASH_BITS 7   /**< Size of table of verification results (as power of 2) */
+#define VIRGIL_CERT_CACHE_MAX       256 /**< Default maximum count of cached results (cert_cache_max module parameter) */
+#define VIRGIL_CERT_CACHE_TTL_S     600 /**< Default time of use of cached result, seconds (cert_cache_ttl_s module parameter) */
+#define VIRGIL_CERT_CACHE_KEY_SZ    64  /**< Size of key of result (SHA-256 of certificate and SHA-256 of root certificate) */
+
+/**
+ * @brief Drop all results, pinned root certificate and revocation set.
+ */
+extern void cert_cache_cleanup(void);
+
+/**
+ * @brief Create SHA-256 of certificate in kernel.
+ *
+ * @param[in] certificate           - certificate
+ * @param[out] digest               - digest (VIRGIL_CERT_CACHE_KEY_SZ / 2 bytes)
+ *
+ * @return VIRGIL_OPERATION_OK, VIRGIL_OPERATION_UNAVAILABLE if hash can't be created in kernel
+ * or VIRGIL_OPERATION_ERROR.
+ */
+extern int cert_cache_digest(data_t certificate, __u8 * digest);
+
+/**
+ * @brief Create key of verification result.
+ *
+ * @param[in] certificate           - certificate
+ * @param[in] root_certificate      - root certificate
+ * @param[out] key                  - key (VIRGIL_CERT_CACHE_KEY_SZ bytes)
+ *
+ * @return VIRGIL_OPERATION_OK, VIRGIL_OPERATION_UNAVAILABLE if hash can't be created in kernel
+ * or VIRGIL_OPERATION_ERROR.
+ */
+extern int cert_cache_key(data_t certificate, data_t root_certificate, __u8 * key);
+
+/**
+ * @brief Get cached result of verification.
+ *
+ * @param[in] key                   - key of result
+ * @param[out] is_ok                - result of verification
+ *
+ * @return VIRGIL_OPERATION_OK or VIRGIL_OPERATION_UNAVAILABLE if result isn't cached or it's expired.
+ */
+extern int cert_cache_lookup(const __u8 * key, bool * is_ok);
+
+/**
+ * @brief Get generation of cache. Should be taken before verification request is sent.
+ *
+ * @return generation of cache.
+ */
+extern __u32 cert_cache_generation(void);
+
+/**
+ * @brief Add definitive result of verification (certificate is verified or rejected by service).
+ * Result isn't added if CRL has been changed after generation was taken.
+ *
+ * @param[in] key                   - key of result
+ * @param[in] is_ok                 - result of verification
+ * @param[in] generation            - generation of cache before verification request
+ */
+extern void cert_cache_add(const __u8 * key, bool is_ok, __u32 generation);
+
+/**
+ * @brief Get copy of pinned root certificate.
+ *
+ * @param[out] root_certificate     - copy of root certificate (should be freed by caller)
+ *
+ * @return VIRGIL_OPERATION_OK, VIRGIL_OPERATION_UNAVAILABLE if root certificate isn't pinned
+ * or VIRGIL_OPERATION_ERROR.
+ */
+extern int cert_cache_root_get(data_t * root_certificate);
+
+/**
+ * @brief Get generation of pinned root certificate. Should be taken before root certificate is loaded.
+ *
+ * @return generation of root certificate.
+ */
+extern __u32 cert_cache_root_generation(void);
+
+/**
+ * @brief Pin loaded root certificate.
+ * Certificate isn't pinned if root certificate has been changed after generation was taken.
+ *
+ * @param[in] root_certificate      - root certificate
+ * @param[in] generation            - generation of root certificate before load
+ */
+extern void cert_cache_root_set(data_t root_certificate, __u32 generation);
+
+/**
+ * @brief Unpin root certificate (it's changed or removed).
+ */
+extern void cert_cache_root_reset(void);
+
+/**
+ * @brief Process notices of user-space service (VIRGIL_CMD_CRL_CHANGED).
+ *
+ * @param[in] request_id            - request id
+ * @param[in] command_type          - command code
+ * @param[in] fields                - received data fields
+ * @param[in] owner                 - buffer with received data
+ *
+ * @return VIRGIL_OPERATION_OK if notice has been processed, VIRGIL_OPERATION_ERROR for other commands.
+ */
+extern int cert_cache_command_processor(__u32 request_id, __u16 command_type, fields_t fields, fields_owner_t * owner);
+
+#endif /* CERT_CACHE_H */
@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file cert-table.h
+ * @brief Table of certificates known to kernel, keyed by HashedId8 of certificate.
+ *
+ * Certificates added by IEEE1609.2 helpers are kept together with their public keys, so signer
+ * of received SPDU which is named by digest (HashedId8) is resolved without request to user-space
+ * service. Lookups are lock-free (RCU) and can be done in atomic context.
+ */
+
+#ifndef CERT_TABLE_H
+#define CERT_TABLE_H
+
+#include <linux/module.h>
+
+#include <virgil/kernel/types.h>
+#include <virgil/kernel/foundation/data.h>
+#include <virgil/kernel/ieee1609dot2/ieee1609dot2-helper.h>
+
+#define VIRGIL_CERT_TABLE_HASH_BITS 8   /**< Size of table of certificates (as power of 2) */
+#define VIRGIL_CERT_TABLE_MAX       256 /**< Default maximum count of certificates (cert_table_max module parameter) */
+
+/**
+ * @brief Remove all certificates.
+ */
+extern void cert_table_cleanup(void);
+
+/**
+ * @brief Add certificate. Certificate with the same HashedId8 is replaced,
+ * the oldest certificate is removed when table is full.
+ *
+ * @param[in] hashed_id8            - HashedId8 of certificate (HASHED_ID8_SIZE bytes)
+ * @param[in] certificate           - certificate
+ * @param[in] public_key            - public key of certificate
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int cert_table_add(const __u8 * hashed_id8, data_t certificate, data_t public_key);
+
+/**
+ * @brief Get copy of certificate and public key.
+ *
+ * @param[in] hashed_id8            - HashedId8 of certificate (HASHED_ID8_SIZE bytes)
+ * @param[out] certificate          - copy of certificate (can be NULL, should be freed by caller)
+ * @param[out] public_key           - copy of public key (can be NULL, should be freed by caller)
+ *
+ * @return VIRGIL_OPERATION_OK, VIRGIL_OPERATION_UNAVAILABLE if certificate isn't known
+ * or VIRGIL_OPERATION_ERROR.
+ */
+extern int cert_table_find(const __u8 * hashed_id8, data_t * certificate, data_t * public_key);
+
+/**
+ * @brief Remove certificate.
+ *
+ * @param[in] hashed_id8            - HashedId8 of certificate (HASHED_ID8_SIZE bytes)
+ */
+extern void cert_table_remove(const __u8 * hashed_id8);
+
+#endif /* CERT_TABLE_H */
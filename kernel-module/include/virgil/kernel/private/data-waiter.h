@@ -39,48 +39,184 @@
  * @brief Functionality to wait response from user-space.
  * Data waiter connected to user-space communicator and receives data. After receive need command data waiter will wake up.
  * If data not received, then time out will be produced.
+ * Requests which can't be sent right now wait in queues of priority classes, served with weighted fair queueing.
+ * Idempotent requests keep copy of their data. They wait in queue while service restarts and are sent again
+ * to new worker, if they haven't expired.
  */
 
 #ifndef DATA_WAITER_H
 #define DATA_WAITER_H
 
 #include <linux/module.h>
+#include <linux/kref.h>
+#include <linux/completion.h>
+#include <linux/list.h>
 
 #include <virgil/kernel/types.h>
+#include <virgil/kernel/request.h>
 #include <virgil/kernel/private/log.h>
 #include <virgil/kernel/private/fields.h>
 
-#define VIRGIL_DATA_WAITER_COUNT  100 /**< Maximum count data waiters */
+#define VIRGIL_DATA_WAITER_HASH_BITS  8 /**< Size of table of pending requests (as power of 2). Count of requests isn't limited by it. */
+#define VIRGIL_REQUESTS_MAX         1024 /**< Default maximum count of pending requests (max_requests module parameter) */
+#define VIRGIL_PARKED_MAX           256 /**< Maximum count of requests which wait for worker of user-space service */
+#define VIRGIL_REPLAY_DATA_MAX      (64 * 1024) /**< Maximum size of request which can wait in queue or be sent again */
+#define VIRGIL_REQUESTS_RESERVE     64  /**< Count of requests reserved for allocation under memory pressure */
 
-/** Data waiter element */
-typedef struct {
+#define VIRGIL_WEIGHT_SCALE         64  /**< Virtual time of one request of class with weight 1 */
+#define VIRGIL_WEIGHT_CRITICAL      16  /**< Weight of critical class in fair queueing */
+#define VIRGIL_WEIGHT_NORMAL        4   /**< Weight of normal class in fair queueing */
+#define VIRGIL_WEIGHT_BULK          1   /**< Weight of bulk class in fair queueing */
+
+/**
+ * @struct virgil_request
+ * State of request to user-space service.
+ * One reference is owned by the submitter and one by the table of pending requests.
+ */
+struct virgil_request {
     __u32 id;                           /**< id of operation */
-    int condition;                      /**< wait queue */
+    __u32 port;                         /**< worker which processes request */
+    __u16 command;                      /**< command of request */
+    __u8 priority;                      /**< priority class of request */
+    __u64 tag;                          /**< finish tag of request in fair queueing */
+    unsigned long deadline;             /**< time (jiffies) after which response isn't needed */
+    struct hlist_node node;             /**< element of table of pending requests */
+    struct list_head parked;            /**< element of queue of requests which wait for worker */
+    bool is_parked;                     /**< request is in queue of requests which wait for worker */
+    fields_t copy;                      /**< copy of request data for sending from queue */
+    struct kref ref;                    /**< reference counter */
+    struct completion done;             /**< completed when response received or request cancelled */
+    int status;                         /**< VIRGIL_OPERATION_OK if response has been received */
     fields_t fields;                    /**< data fields */
-} data_wait_element_t;
+    virgil_request_cb callback;         /**< completion callback */
+    void * ctx;                         /**< context of completion callback */
+    void (*release)(void);              /**< called when request is freed (can be 0) */
+};
+
+/** Macros for request submission with check of result. */
+#define SUBMIT_WITH_CHECK(CMD, FIELDS, OPTS, REQUEST, MESSAGE) do {     \
+        int __submit_res = data_waiter_submit(CMD, FIELDS, OPTS, REQUEST); \
+        if (VIRGIL_OPERATION_OK != __submit_res) {                      \
+            LOG(MESSAGE);                                               \
+            return __submit_res;                                        \
+        }                                                               \
+        } while(0);
+
+/** Check output parameter of result function. Request is released in case of error. */
+#define RESULT_NOT_ZERO(REQUEST, VAL) do {                              \
+        if (!(VAL)) {                                                   \
+            virgil_request_free(REQUEST);                               \
+            return VIRGIL_OPERATION_ERROR;                              \
+        }                                                               \
+        } while(0);
 
 /**
- * @brief Start wait for data with timeout.
- * wait_event_interruptible_timeout used inside.
+ * @brief Send request to user-space service without waiting of response.
+ * Request is registered before sending, so response can't be lost.
  *
- * @param[in] id        	- id of sent request.
- * @param[out] fields      	- returned data fields.
- * @param[in] timeout_ms    - data wait timeout.
+ * @param[in] command       - command code.
+ * @param[in] fields        - request data fields.
+ * @param[in] opts          - request options (can be 0).
+ * @param[out] request      - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK, VIRGIL_OPERATION_ERROR, VIRGIL_OPERATION_UNAVAILABLE or VIRGIL_OPERATION_BUSY].
+ */
+extern int data_waiter_submit(__u16 command, fields_t fields,
+        const virgil_request_opts_t * opts,
+        virgil_request_t ** request);
+
+/**
+ * @brief Send request to user-space service and call release function when request is freed.
+ * Used to keep state which lasts while request is alive. Release function is called in any case,
+ * if request can't be created too. It can be called from communication context.
+ *
+ * @param[in] command       - command code.
+ * @param[in] fields        - request data fields.
+ * @param[in] opts          - request options (can be 0).
+ * @param[in] release       - release function.
+ * @param[out] request      - request handle.
+ *
+ * @return [VIRGIL_OPERATION_OK, VIRGIL_OPERATION_ERROR, VIRGIL_OPERATION_UNAVAILABLE or VIRGIL_OPERATION_BUSY].
+ */
+extern int data_waiter_submit_release(__u16 command, fields_t fields,
+        const virgil_request_opts_t * opts,
+        void (*release)(void),
+        virgil_request_t ** request);
+
+/**
+ * @brief Create request which has been already done in kernel (without user-space service).
+ * Response is copied into request, completion callback is called before return.
+ *
+ * @param[in] command       - command code.
+ * @param[in] response      - response data fields.
+ * @param[in] opts          - request options (can be 0).
+ * @param[out] request      - request handle.
  *
  * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
  */
-extern int data_waiter_execute(__u32 id, fields_t * fields, __u16 timeout_ms);
+extern int data_waiter_submit_done(__u16 command, fields_t response,
+        const virgil_request_opts_t * opts,
+        virgil_request_t ** request);
+
+/**
+ * @brief Wait for response with timeout and take received data.
+ * Request handle is released in any case.
+ *
+ * @param[in] request       - request handle.
+ * @param[out] fields       - returned data fields.
+ * @param[in] timeout_ms    - data wait timeout.
+ *
+ * @return [VIRGIL_OPERATION_OK, VIRGIL_OPERATION_ERROR or VIRGIL_OPERATION_UNAVAILABLE].
+ */
+extern int data_waiter_result(virgil_request_t * request, fields_t * fields, __u32 timeout_ms);
 
 /**
  * @brief Callback used to receive data from communication layer.
- * Process received data and wake up corresponding data waiter if need.
+ * Process received data and complete corresponding request if need.
  *
  * @param[in] request_id    - id of sent request.
  * @param[in] command_type  - received command type.
  * @param[in] fields    	- received data.
+ * @param[in,out] owner     - owner of buffer with received data, big data is kept in it without copying.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int data_waiter_command_processor(__u32 request_id, __u16 command_type, fields_t fields, fields_owner_t * owner);
+
+/**
+ * @brief Complete all requests sent to worker with VIRGIL_OPERATION_UNAVAILABLE status.
+ * Idempotent requests are kept in queue to be sent to other worker.
+ * Used when worker has been disconnected.
+ *
+ * @param[in] port          - port of disconnected worker.
+ */
+extern void data_waiter_fail_port(__u32 port);
+
+/**
+ * @brief Complete pending request with error status and release its worker.
+ * Used when request has been accepted for sending, but it hasn't been sent.
+ *
+ * @param[in] request_id    - id of request.
+ * @param[in] status        - status of request (VIRGIL_OPERATION_xxx).
+ */
+extern void data_waiter_fail_request(__u32 request_id, int status);
+
+/**
+ * @brief Send requests from queue to ready workers.
+ */
+extern void data_waiter_replay(void);
+
+/**
+ * @brief Create cache of requests.
  *
  * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
  */
-extern int data_waiter_command_processor(__u32 request_id, __u16 command_type, fields_t fields);
+extern int data_waiter_init(void);
+
+/**
+ * @brief Stop processing of queue of requests which wait for worker and destroy cache of requests.
+ * Pending and parked requests are completed with VIRGIL_OPERATION_UNAVAILABLE status before.
+ */
+extern void data_waiter_stop(void);
 
 #endif /* DATA_WAITER_H */
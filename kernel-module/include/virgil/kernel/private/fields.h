@@ -70,6 +70,15 @@ typedef struct {
     struct package_field_t * ar;
 } fields_t;
 
+/**
+ * @struct fields_owner_t
+ * Buffer which holds data of received fields. It can be taken by fields instead of copying of data.
+ */
+typedef struct {
+    void * buffer;                      /**< Buffer (0 if it has been taken) */
+    void (*release)(void * buffer);     /**< Function which frees buffer */
+} fields_owner_t;
+
 #define VIRGIL_FIELD_UNKNOWN            0		/**< Unknown data field */
 #define VIRGIL_FIELD_TOKEN              1		/**< Data field with Token */
 #define VIRGIL_FIELD_CURVE_TYPE         2		/**< Data field with EC Curve Type */
@@ -87,8 +96,15 @@ typedef struct {
 #define VIRGIL_FIELD_CRL_NEXT           14		/**< Data field with Time of next getting of Certificate Revocation Time */
 #define VIRGIL_FIELD_HASH_FUNC          15		/**< Data field with Hash type */
 #define VIRGIL_FIELD_OPTIONAL_1         16		/**< Data field with Optional field */
+#define VIRGIL_FIELD_QUEUE_DEPTH        17		/**< Data field with count of requests in queue of worker */
+
+#define VIRGIL_FIELD_MAX                18		/**< Maximun number of field */
+
+#define VIRGIL_FIELD_FLAG_SG            0x8000		/**< Kernel only flag of field type: data of field is data_sg_t (isn't sent) */
+#define VIRGIL_FIELD_TYPE(TYPE)         ((TYPE) & ~VIRGIL_FIELD_FLAG_SG)		/**< Type of field without kernel flags */
 
-#define VIRGIL_FIELD_MAX                17		/**< Maximun number of field */
+#define VIRGIL_FIELDS_SMALL_SZ          512		/**< Maximum size of fields block which is allocated from fields cache */
+#define VIRGIL_FIELDS_RESERVE           64		/**< Count of small fields blocks reserved for allocation under memory pressure */
 
 /** Helper macros to fill data field using data_t structure */
 #define FILL_FIELD(FIELD, TYPE, DATA) do { \
@@ -104,6 +120,13 @@ typedef struct {
         FIELD.data.p = (void*)(DATA);                   \
         } while(0);
 
+/** Helper macros to fill data using data_sg_t structure (pointer) */
+#define FILL_FIELD_SG(FIELD, TYPE, DATA_SG) do {                \
+        FIELD.type = (TYPE) | VIRGIL_FIELD_FLAG_SG;             \
+        FIELD.data_sz = (DATA_SG)->sz;                          \
+        FIELD.data.p = (void*)(DATA_SG);                        \
+        } while(0);
+
 /** Helper macros to fill data using string */
 #define FILL_FIELD_STR(FIELD, TYPE, STR) do {           \
         FIELD.type = (TYPE);                            \
@@ -119,10 +142,23 @@ typedef struct {
                 return ERR_VAR;                                         \
         } } while(0);
 
-/** Helper macros to check operation processing */
+/** Helper macros to check operation processing. Error code (VIRGIL_OPERATION_ERROR, VIRGIL_OPERATION_UNAVAILABLE) is returned as is */
 #define CHECK(OPERATION) do {                                   \
-        if (VIRGIL_OPERATION_ERROR == (OPERATION)) {            \
-            return VIRGIL_OPERATION_ERROR;  } } while(0);
+        int __check_res = (OPERATION);                          \
+        if (VIRGIL_OPERATION_OK != __check_res) {               \
+            return __check_res;  } } while(0);
+
+/**
+ * @brief Create cache of fields blocks.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int fields_init(void);
+
+/**
+ * @brief Destroy cache of fields blocks.
+ */
+extern void fields_cleanup(void);
 
 /**
  * @brief Free fields_t structure with all data.
@@ -170,6 +206,64 @@ extern int fields_result(fields_t fields, __s16 * result);
  */
 extern int fields_dup(fields_t * dst, fields_t src);
 
+/**
+ * @brief Copy fields data into single memory block.
+ *
+ * Small blocks are allocated from fields cache, so copy can be done from reserve under memory pressure.
+ * Result must be freed by fields_free(). Only fields created by fields_copy(), fields_take() or fields_dup()
+ * can be freed by fields_free().
+ *
+ * @param[out] dst             - destination data fields
+ * @param[in] src              - source data fields
+ * @param[in] gfp              - allocation flags
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int fields_copy(fields_t * dst, fields_t src, gfp_t gfp);
+
+/**
+ * @brief Take fields with data kept in buffer of owner.
+ *
+ * Big data isn't copied: buffer is taken from owner and is released by fields_free().
+ * Small data is copied as by fields_copy(), buffer stays with owner.
+ *
+ * @param[out] dst             - destination data fields
+ * @param[in] src              - source data fields (pointers into buffer of owner)
+ * @param[in,out] owner        - owner of buffer, buffer is reset if it has been taken (can be 0)
+ * @param[in] gfp              - allocation flags
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int fields_take(fields_t * dst, fields_t src, fields_owner_t * owner, gfp_t gfp);
+
+/**
+ * @brief Read part of data of field. Linear and non-linear (data_sg_t) data is supported.
+ *
+ * @param[in] field            - data field
+ * @param[in] offset           - offset in data of field
+ * @param[out] dst             - destination buffer
+ * @param[in] len              - count of bytes to be read
+ */
+extern void fields_data_read(const struct package_field_t * field, __u32 offset, void * dst, __u32 len);
+
+/**
+ * @brief Check that non-linear data is available in scatterlist or socket buffer.
+ *
+ * @param[in] data             - non-linear data
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int fields_data_sg_check(const data_sg_t * data);
+
+/**
+ * @brief Get size of fields array with data of fields.
+ *
+ * @param[in] fields           - data fields
+ *
+ * @return size in bytes.
+ */
+extern size_t fields_size(fields_t fields);
+
 /**
  * @brief Reset data fields.
  *
@@ -0,0 +1,101 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file fragments.h
+ * @brief Fragmentation of big frames for communication with user-space.
+ * Frame which is bigger than VIRGIL_MESSAGE_SZ_MAX is sent as sequence of messages with command VIRGIL_CMD_FRAGMENT.
+ * Each fragment message contains frame header (id of request, VIRGIL_CMD_FRAGMENT, 0 fields, no deadline and priority), fragment header and part of frame.
+ * Fragments of one frame are sent in order, so offset of fragment is used as sequence number.
+ */
+
+#ifndef FRAGMENTS_H
+#define FRAGMENTS_H
+
+#include <linux/module.h>
+
+#include <virgil/kernel/types.h>
+#include <virgil/kernel/private/netlink.h>
+
+#define VIRGIL_FRAME_SZ_MAX         (1024 * 1024)           /**< Maximum size of fragmented frame */
+#define VIRGIL_REASSEMBLY_MEM_MAX   (4 * 1024 * 1024)       /**< Maximum memory for all frames in reassembly */
+
+#pragma pack(push,1)
+/**
+ * @struct frame_header_t
+ * Header of every frame. Data fields descriptions and their payloads follow it.
+ */
+typedef struct {
+    __u32 id;               /**< Id of request */
+    __u16 command;          /**< Command code */
+    __u16 fields_cnt;       /**< Count of data fields */
+    __u64 deadline;         /**< Time (CLOCK_MONOTONIC, ms) after which response isn't needed. 0 - no deadline */
+    __u16 priority;         /**< Priority class of request */
+} frame_header_t;
+
+/**
+ * @struct fragment_header_t
+ * Header of fragment. Placed right after frame header.
+ */
+typedef struct {
+    __u32 frame_sz;         /**< Size of whole frame */
+    __u32 offset;           /**< Offset of current fragment in frame */
+} fragment_header_t;
+#pragma pack(pop)
+
+#define VIRGIL_FRAME_HEADER_SZ      sizeof(frame_header_t)  /**< Size of frame header */
+#define VIRGIL_FRAGMENT_DATA_SZ_MAX (VIRGIL_MESSAGE_SZ_MAX - VIRGIL_FRAME_HEADER_SZ - sizeof(fragment_header_t))    /**< Maximum size of frame part in one fragment */
+
+/**
+ * @brief Process received fragment.
+ * Frame is returned when all fragments have been received.
+ *
+ * @param[in] id            - id of request.
+ * @param[in] data          - fragment header and fragment data.
+ * @param[in] data_sz       - size of data.
+ * @param[out] frame        - reassembled frame or 0 if frame isn't complete yet. Should be freed with vfree.
+ * @param[out] frame_sz     - size of reassembled frame.
+ *
+ * @return VIRGIL_OPERATION_OK - if fragment has been accepted.
+ */
+extern int fragments_receive(__u32 id, const void * data, __u32 data_sz, void ** frame, __u32 * frame_sz);
+
+/**
+ * @brief Drop all frames in reassembly.
+ */
+extern void fragments_cleanup(void);
+
+#endif /* FRAGMENTS_H */
@@ -0,0 +1,114 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file key-cache.h
+ * @brief Cache of keys loaded from key storage of user-space service.
+ *
+ * Permanent keys loaded without password are kept in kernel, so repeated load of the same key
+ * (e.g. private key of crypto material handle for every signature) doesn't need request to service.
+ * Lookups are lock-free (RCU). Entry is removed when key is saved or revoked, content of removed
+ * entry is wiped before memory is freed. Size of cache is limited and is reduced by shrinker under
+ * memory pressure.
+ */
+
+#ifndef KEY_CACHE_H
+#define KEY_CACHE_H
+
+#include <linux/module.h>
+
+#include <virgil/kernel/types.h>
+#include <virgil/kernel/foundation/data.h>
+
+#define VIRGIL_KEY_CACHE_HASH_BITS  5   /**< Size of table of cached keys (as power of 2) */
+#define VIRGIL_KEY_CACHE_MAX        32  /**< Default maximum count of cached keys (key_cache_max module parameter) */
+
+/**
+ * @brief Register shrinker of cache.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int key_cache_init(void);
+
+/**
+ * @brief Remove all keys and unregister shrinker.
+ */
+extern void key_cache_cleanup(void);
+
+/**
+ * @brief Get copy of cached key.
+ *
+ * @param[in] key_id                - identifier of key
+ * @param[out] key                  - copy of key (should be freed by caller)
+ * @param[in] gfp                   - allocation flags
+ *
+ * @return VIRGIL_OPERATION_OK, VIRGIL_OPERATION_UNAVAILABLE if key isn't cached
+ * or VIRGIL_OPERATION_ERROR.
+ */
+extern int key_cache_get(const char * key_id, data_t * key, gfp_t gfp);
+
+/**
+ * @brief Get generation of cache. Should be taken before load request is sent.
+ *
+ * @return generation of cache.
+ */
+extern __u32 key_cache_generation(void);
+
+/**
+ * @brief Add loaded key to cache.
+ * Key isn't added if any key has been saved or revoked after generation was taken,
+ * or save/revoke is in progress (loaded data can be outdated).
+ *
+ * @param[in] key_id                - identifier of key
+ * @param[in] key                   - key
+ * @param[in] generation            - generation of cache before load request
+ */
+extern void key_cache_add(const char * key_id, data_t key, __u32 generation);
+
+/**
+ * @brief Start of save or revocation of key. Cached key is removed.
+ * Each call should be paired with key_cache_write_end, which is release function of write request.
+ *
+ * @param[in] key_id                - identifier of key
+ */
+extern void key_cache_write_begin(const char * key_id);
+
+/**
+ * @brief End of save or revocation of key (write request has been freed or hasn't been created).
+ */
+extern void key_cache_write_end(void);
+
+#endif /* KEY_CACHE_H */
@@ -0,0 +1,79 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file local-crypto.h
+ * @brief Crypto operations which are done in kernel (kernel crypto API) without user-space service.
+ *
+ * Algorithms are looked up once at module start. If algorithm isn't available in kernel,
+ * VIRGIL_OPERATION_UNAVAILABLE is returned and caller sends request to user-space service.
+ */
+
+#ifndef LOCAL_CRYPTO_H
+#define LOCAL_CRYPTO_H
+
+#include <linux/module.h>
+
+#include <virgil/kernel/types.h>
+#include <virgil/kernel/private/fields.h>
+
+#define VIRGIL_LOCAL_DIGEST_MAX     64      /**< Maximum size of digest (SHA-512) */
+
+/**
+ * @brief Look up algorithms available in kernel.
+ */
+extern void local_crypto_init(void);
+
+/**
+ * @brief Release algorithms.
+ */
+extern void local_crypto_cleanup(void);
+
+/**
+ * @brief Create hash in kernel.
+ *
+ * @param[in] hash_type             - identifier of hash function (HASH_xxx)
+ * @param[in] data_field            - field with data (linear or non-linear)
+ * @param[out] digest               - buffer for digest (VIRGIL_LOCAL_DIGEST_MAX bytes)
+ * @param[out] digest_sz            - size of digest
+ *
+ * @return VIRGIL_OPERATION_OK, VIRGIL_OPERATION_UNAVAILABLE if algorithm isn't available in kernel
+ * or VIRGIL_OPERATION_ERROR.
+ */
+extern int local_hash(__u8 hash_type, const struct package_field_t * data_field,
+        __u8 * digest, __u32 * digest_sz);
+
+#endif /* LOCAL_CRYPTO_H */
@@ -43,11 +43,23 @@
 #define NETLINK_H
 
 #include <linux/module.h>
+#include <linux/skbuff.h>
 
 #include <virgil/kernel/types.h>
 #include <virgil/kernel/private/log.h>
 
-typedef void (*netlink_processor_cb)(void * data, __u32 data_sz);
+#define VIRGIL_MESSAGE_SZ_MAX   (7 * 1024)      /**< Maximum size of payload of single netlink message */
+#define VIRGIL_BATCH_SZ_MAX     (64 * 1024)     /**< Maximum size of datagram with batch of netlink messages */
+
+/**
+ * @brief Callback for received netlink message.
+ *
+ * @param[in] port                  - worker which has sent data
+ * @param[in] data                  - payload of message
+ * @param[in] data_sz               - size of payload
+ * @param[in] skb                   - datagram which holds payload (processor can take reference on it)
+ */
+typedef void (*netlink_processor_cb)(__u32 port, void * data, __u32 data_sz, struct sk_buff * skb);
 
 /**
  * @brief Set data processor callback.
@@ -67,19 +79,46 @@ extern void netlink_start(void);
 extern void netlink_stop(void);
 
 /**
- * @brief Send data using NetLink.
+ * @brief Allocate netlink message with payload of given size.
+ * Caller serializes data directly into payload and sends it with netlink_frame_send.
+ *
+ * @param[in] data_sz             - size of payload
+ * @param[in] gfp                 - allocation flags
+ * @param[out] data               - pointer to payload inside of message
+ *
+ * @return allocated message or 0 in case of error.
+ */
+extern struct sk_buff * netlink_frame_alloc(__u32 data_sz, gfp_t gfp, void ** data);
+
+/**
+ * @brief Allocate datagram for batch of netlink messages.
+ * Messages are added with netlink_frame_append, datagram is sent with netlink_frame_send.
+ *
+ * @param[in] gfp                 - allocation flags
+ *
+ * @return allocated datagram or 0 in case of error.
+ */
+extern struct sk_buff * netlink_batch_alloc(gfp_t gfp);
+
+/**
+ * @brief Add netlink message to datagram.
  *
- * @param[in] data                - data to be sent
- * @param[in] data_sz             - size of data to be sent
+ * @param[in] skb                 - datagram
+ * @param[in] data_sz             - size of payload
  *
- * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ * @return pointer to payload of new message or 0 if datagram has no room for it.
  */
-extern bool netlink_send(const void * data, __u32 data_sz);
+extern void * netlink_frame_append(struct sk_buff * skb, __u32 data_sz);
 
 /**
- * @brief Check is ready for communication.
- * @return true if is ready for communication.
+ * @brief Send message allocated by netlink_frame_alloc. Message is consumed in any case.
+ * Worker is unregistered if message can't be delivered.
+ *
+ * @param[in] skb                 - message to be sent
+ * @param[in] pid                 - port of worker
+ *
+ * @return true if message has been sent.
  */
-extern bool netlink_is_valid(void);
+extern bool netlink_frame_send(struct sk_buff * skb, __u32 pid);
 
 #endif /* NETLINK_H */
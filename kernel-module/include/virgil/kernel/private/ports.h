@@ -0,0 +1,163 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file ports.h
+ * @brief Registry of user-space service workers.
+ *
+ * Port identifies one worker process: netlink pid or index of ring instance (with VIRGIL_PORT_RING_FLAG).
+ * Requests are dispatched to worker with least outstanding requests.
+ * Count of outstanding requests of worker is limited by window. Each priority class can use only its share
+ * of window, so slow requests (network) can't occupy worker. Windows are set with module parameters.
+ * Registry is read without locks (RCU), counters of workers are atomic.
+ * Worker reports depth of its queue. Loaded worker receives only critical requests, overloaded one receives nothing.
+ * The first registered worker is primary. Requests which depend on state of worker (key storage) go to it.
+ */
+
+#ifndef PORTS_H
+#define PORTS_H
+
+#include <linux/module.h>
+
+#include <virgil/kernel/types.h>
+#include <virgil/kernel/request.h>
+#include <virgil/kernel/private/log.h>
+
+#define VIRGIL_PORTS_MAX            16                  /**< Maximum count of workers */
+#define VIRGIL_PORT_NONE            0                   /**< No worker */
+#define VIRGIL_PORT_RING_FLAG       0x80000000          /**< Port is ring instance */
+
+#define VIRGIL_PORT_WINDOW          32                  /**< Maximum count of outstanding requests of worker */
+#define VIRGIL_PORT_WINDOW_NORMAL   16                  /**< Maximum count of outstanding requests of normal class */
+#define VIRGIL_PORT_WINDOW_BULK     4                   /**< Maximum count of outstanding requests of bulk class */
+#define VIRGIL_PORT_LOAD_THROTTLE   16                  /**< Queue depth of worker after which only critical requests are sent to it */
+#define VIRGIL_PORT_LOAD_MAX        64                  /**< Queue depth of worker after which no requests are sent to it */
+
+#define VIRGIL_PORT_IS_RING(PORT)   (0 != ((PORT) & VIRGIL_PORT_RING_FLAG))
+#define VIRGIL_PORT_RING(IDX)       ((__u32)(IDX) | VIRGIL_PORT_RING_FLAG)
+#define VIRGIL_PORT_RING_IDX(PORT)  ((PORT) & ~VIRGIL_PORT_RING_FLAG)
+
+typedef void (*ports_event_cb)(__u32 port, bool added);
+
+/**
+ * @brief Set listener of registration and unregistration of workers.
+ *
+ * @param[in] listener              - pointer to listener function (can be 0)
+ */
+extern void ports_set_listener(ports_event_cb listener);
+
+/**
+ * @brief Register worker. Nothing is done if worker is already registered.
+ *
+ * @param[in] port                  - port of worker
+ */
+extern void ports_add(__u32 port);
+
+/**
+ * @brief Unregister worker.
+ *
+ * @param[in] port                  - port of worker
+ */
+extern void ports_remove(__u32 port);
+
+/**
+ * @brief Unregister all workers without notification and free memory of registry.
+ */
+extern void ports_cleanup(void);
+
+/**
+ * @brief Select worker for new request and count request as outstanding for it.
+ *
+ * @param[in] primary               - select primary worker instead of least loaded one
+ * @param[in] priority              - priority class of request
+ *
+ * @return port of worker or VIRGIL_PORT_NONE if there are no workers or their windows are full.
+ */
+extern __u32 ports_acquire(bool primary, __u8 priority);
+
+/**
+ * @brief Count new request as outstanding for given worker.
+ *
+ * @param[in] port                  - port of worker
+ * @param[in] priority              - priority class of request
+ *
+ * @return true if worker is registered and has room in window.
+ */
+extern bool ports_get(__u32 port, __u8 priority);
+
+/**
+ * @brief Request of worker has been completed.
+ *
+ * @param[in] port                  - port of worker
+ * @param[in] priority              - priority class of request
+ */
+extern void ports_release(__u32 port, __u8 priority);
+
+/**
+ * @brief Set depth of queue reported by worker.
+ *
+ * @param[in] port                  - port of worker
+ * @param[in] load                  - count of requests in queue of worker
+ *
+ * @return true if load has decreased, so worker can have room for waiting requests.
+ */
+extern bool ports_set_load(__u32 port, __u32 load);
+
+/**
+ * @brief Check if worker is registered.
+ *
+ * @param[in] port                  - port of worker
+ *
+ * @return true if worker is registered.
+ */
+extern bool ports_contains(__u32 port);
+
+/**
+ * @brief Get count of registered workers.
+ */
+extern int ports_count(void);
+
+/**
+ * @brief Get ports of all registered workers.
+ *
+ * @param[out] list                 - array for ports
+ * @param[in] max                   - size of array
+ *
+ * @return count of ports in array.
+ */
+extern int ports_list(__u32 * list, int max);
+
+#endif /* PORTS_H */
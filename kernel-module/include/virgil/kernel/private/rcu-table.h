@@ -0,0 +1,196 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file rcu-table.h
+ * @brief Bounded hash table with lock-free lookups.
+ *
+ * Used by caches of kernel module. Readers look up entries under RCU, changes are done under
+ * spinlock of table. When table is full, entries are evicted in order of insertion with second chance:
+ * entry which has been read since last pass is moved to the end of list instead of removal.
+ * Entry of table embeds rcu_table_node_t as its first member.
+ */
+
+#ifndef RCU_TABLE_H
+#define RCU_TABLE_H
+
+#include <linux/module.h>
+#include <linux/list.h>
+#include <linux/string.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+
+/**
+ * @struct rcu_table_node_t
+ * Part of entry which is used by table.
+ */
+typedef struct {
+    struct hlist_node node;             /**< element of bucket (RCU) */
+    struct list_head order;             /**< order of eviction (protected by lock of table) */
+    struct rcu_head rcu;                /**< deferred free */
+    __u32 hash;                         /**< hash of key */
+    int referenced;                     /**< has been read since last pass of eviction */
+} rcu_table_node_t;
+
+/** Check is key of entry equal to given one */
+typedef bool (*rcu_table_match_t)(const rcu_table_node_t * node, const void * key);
+
+/**
+ * @struct rcu_table_t
+ * Table state. Defined with DEFINE_RCU_TABLE.
+ */
+typedef struct {
+    struct hlist_head * buckets;        /**< buckets of table */
+    unsigned int bits;                  /**< count of buckets (as power of 2) */
+    struct list_head order;             /**< entries in order of eviction */
+    spinlock_t lock;                    /**< protects changes of table */
+    unsigned int count;                 /**< count of entries */
+    rcu_table_match_t match;            /**< key comparison */
+    void (*free_rcu)(struct rcu_head * rcu); /**< free of removed entry after grace period (0 - kfree) */
+} rcu_table_t;
+
+/** Define static table with 2^BITS buckets. */
+#define DEFINE_RCU_TABLE(NAME, BITS, MATCH, FREE_RCU)                   \
+        static struct hlist_head NAME##_buckets[1 << (BITS)];           \
+        static rcu_table_t NAME = {                                     \
+            .buckets = NAME##_buckets,                                  \
+            .bits = (BITS),                                             \
+            .order = LIST_HEAD_INIT(NAME.order),                        \
+            .lock = __SPIN_LOCK_UNLOCKED(NAME.lock),                    \
+            .count = 0,                                                 \
+            .match = (MATCH),                                           \
+            .free_rcu = (FREE_RCU)                                      \
+        }
+
+/**
+ * @brief Hash of key which is digest. Its bytes are already uniform, so first ones are used.
+ *
+ * @param[in] digest        - digest (at least 4 bytes).
+ *
+ * @return hash of key.
+ */
+static inline __u32 rcu_table_digest_hash(const __u8 * digest) {
+    __u32 hash;
+
+    memcpy(&hash, digest, sizeof(hash));
+
+    return hash;
+}
+
+/**
+ * @brief Mark entry as read, so it gets second chance on eviction. Can be called under RCU.
+ *
+ * @param[in] node          - entry of table.
+ */
+static inline void rcu_table_touch(rcu_table_node_t * node) {
+    ACCESS_ONCE(node->referenced) = 1;
+}
+
+/**
+ * @brief Get count of entries without lock.
+ *
+ * @param[in] table         - table.
+ *
+ * @return count of entries.
+ */
+static inline unsigned int rcu_table_count(rcu_table_t * table) {
+    return ACCESS_ONCE(table->count);
+}
+
+/**
+ * @brief Find entry. Must be called under rcu_read_lock or lock of table.
+ *
+ * @param[in] table         - table.
+ * @param[in] key           - key of entry.
+ * @param[in] hash          - hash of key.
+ *
+ * @return entry or 0 if it isn't found.
+ */
+extern rcu_table_node_t * rcu_table_find(rcu_table_t * table, const void * key, __u32 hash);
+
+/**
+ * @brief Insert entry. Entry with the same key is replaced, old entries are evicted
+ * while count of entries isn't less than max. Must be called under lock of table.
+ *
+ * @param[in] table         - table.
+ * @param[in] node          - new entry, its hash must be set.
+ * @param[in] key           - key of new entry.
+ * @param[in] max           - maximum count of entries.
+ */
+extern void rcu_table_insert_locked(rcu_table_t * table, rcu_table_node_t * node, const void * key, unsigned int max);
+
+/**
+ * @brief Remove entry. It's freed after RCU grace period. Must be called under lock of table.
+ *
+ * @param[in] table         - table.
+ * @param[in] node          - entry.
+ */
+extern void rcu_table_remove_locked(rcu_table_t * table, rcu_table_node_t * node);
+
+/**
+ * @brief Evict entries. Must be called under lock of table.
+ *
+ * @param[in] table         - table.
+ * @param[in] nr            - count of entries to evict.
+ *
+ * @return count of evicted entries.
+ */
+extern unsigned long rcu_table_evict_locked(rcu_table_t * table, unsigned long nr);
+
+/**
+ * @brief Remove all entries. Must be called under lock of table.
+ *
+ * @param[in] table         - table.
+ */
+extern void rcu_table_clear_locked(rcu_table_t * table);
+
+/**
+ * @brief Remove entry with given key if it's present.
+ *
+ * @param[in] table         - table.
+ * @param[in] key           - key of entry.
+ * @param[in] hash          - hash of key.
+ */
+extern void rcu_table_remove(rcu_table_t * table, const void * key, __u32 hash);
+
+/**
+ * @brief Remove all entries and wait for their free. Used on module unload.
+ *
+ * @param[in] table         - table.
+ */
+extern void rcu_table_destroy(rcu_table_t * table);
+
+#endif /* RCU_TABLE_H */
@@ -0,0 +1,123 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file revocation.h
+ * @brief Revocation checks in kernel.
+ *
+ * User-space service pushes revocation set with VIRGIL_CMD_CRL_CHANGED notice when it receives new CRL
+ * and when its worker gets registered. Notices are accepted from registered workers only.
+ * Set contains Bloom filter and sorted set of ids of revoked certificates (SHA-256 of card id).
+ * Id of certificate is learned from the first check of certificate by service, then the certificate
+ * is checked in kernel. Service is asked only if id of certificate isn't known, or Bloom filter
+ * reports id which isn't in exact set and exact set isn't complete.
+ */
+
+#ifndef REVOCATION_H
+#define REVOCATION_H
+
+#include <linux/module.h>
+
+#include <virgil/kernel/types.h>
+#include <virgil/kernel/private/fields.h>
+
+#define VIRGIL_REVOCATION_DIGEST_SZ         32          /**< Size of id of certificate (SHA-256 of card id) */
+#define VIRGIL_REVOCATION_HASHES_MAX        8           /**< Maximum count of hash functions of Bloom filter */
+#define VIRGIL_REVOCATION_FILTER_BITS_MAX   (1 << 20)   /**< Maximum size of Bloom filter in bits */
+#define VIRGIL_REVOCATION_IDS_MAX           4096        /**< Maximum count of ids in exact set */
+#define VIRGIL_REVOCATION_CERTS_HASH_BITS   7           /**< Size of table of known certificates (as power of 2) */
+#define VIRGIL_REVOCATION_CERTS_MAX         256         /**< Maximum count of known certificates */
+
+#pragma pack(push,1)
+
+/**
+ * @struct revocation_set_header_t
+ * Header of revocation set. It's followed by Bloom filter (filter_bits / 8 bytes)
+ * and ids_count sorted ids (VIRGIL_REVOCATION_DIGEST_SZ bytes each).
+ * Bit i of Bloom filter is (filter[i / 8] >> (i % 8)) & 1. Hash function j of id is
+ * little-endian 32-bit word j of id modulo filter_bits.
+ */
+typedef struct {
+    __u64 version;          /**< Monotonic time of receive of CRL, ms (0 if CRL hasn't been received) */
+    __u32 filter_bits;      /**< Size of Bloom filter in bits (power of two) */
+    __u32 ids_count;        /**< Count of ids in exact set */
+    __u8 hashes;            /**< Count of hash functions of Bloom filter */
+    __u8 is_complete;       /**< Exact set contains all revoked ids */
+    __u16 reserved;
+} revocation_set_header_t;
+
+#pragma pack(pop)
+
+/**
+ * @brief Drop revocation set and known certificates.
+ */
+extern void revocation_cleanup(void);
+
+/**
+ * @brief Replace revocation set by the one from notice of service (VIRGIL_FIELD_DATA).
+ * Set with older version is ignored, unless order has been reset by revocation_reset_version.
+ *
+ * @param[in] fields                - fields of VIRGIL_CMD_CRL_CHANGED notice
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int revocation_update(fields_t fields);
+
+/**
+ * @brief Accept the next revocation set regardless of its version.
+ * Called on registration of worker. Can be called in atomic context.
+ */
+extern void revocation_reset_version(void);
+
+/**
+ * @brief Check whether certificate has been revoked.
+ *
+ * @param[in] cert_digest           - SHA-256 of certificate
+ * @param[out] is_revoked           - true if certificate has been revoked
+ *
+ * @return VIRGIL_OPERATION_OK or VIRGIL_OPERATION_UNAVAILABLE if service should be asked.
+ */
+extern int revocation_check(const __u8 * cert_digest, bool * is_revoked);
+
+/**
+ * @brief Remember id of certificate reported by service.
+ *
+ * @param[in] cert_digest           - SHA-256 of certificate
+ * @param[in] id                    - id of certificate (SHA-256 of card id)
+ */
+extern void revocation_learn(const __u8 * cert_digest, const __u8 * id);
+
+#endif /* REVOCATION_H */
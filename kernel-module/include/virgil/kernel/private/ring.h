@@ -0,0 +1,132 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file ring.h
+ * @brief Communication through shared memory rings of character device.
+ *
+ * Every opening of device creates separate ring instance (one per worker of user-space service).
+ * Memory of instance is mapped by worker. It contains header and two rings of slots:
+ *  - submission ring (kernel -> service);
+ *  - completion ring (service -> kernel).
+ * Each slot holds one message (frame or fragment). Indexes are free-running counters.
+ * Kernel wakes up poll of device on new submissions, service calls VIRGIL_RING_IOC_NOTIFY
+ * after completions have been written. Instance becomes worker after ping from service.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <linux/module.h>
+#include <linux/ioctl.h>
+#include <linux/mm.h>
+
+#include <virgil/kernel/types.h>
+#include <virgil/kernel/private/log.h>
+
+#define VIRGIL_RING_DEVICE_NAME     "virgil-ring"       /**< Name of character device */
+#define VIRGIL_RING_MAGIC           0x56524e47          /**< Magic of shared memory header */
+#define VIRGIL_RING_VERSION         1                   /**< Version of shared memory layout */
+#define VIRGIL_RING_SLOTS_CNT       128                 /**< Count of slots in each ring (power of two) */
+#define VIRGIL_RING_SLOT_SZ         (8 * 1024)          /**< Size of one slot */
+#define VIRGIL_RING_INSTANCES_MAX   8                   /**< Maximum count of ring instances */
+#define VIRGIL_RING_CLOSE_TIMEOUT_MS 1000               /**< Period of log while module waits for closing of rings */
+
+#define VIRGIL_RING_HEADER_SZ       PAGE_ALIGN(sizeof(virgil_ring_header_t))
+#define VIRGIL_RING_MEM_SZ          (VIRGIL_RING_HEADER_SZ + 2 * VIRGIL_RING_SLOTS_CNT * VIRGIL_RING_SLOT_SZ)
+
+#define VIRGIL_RING_IOC_NOTIFY      _IO('V', 1)         /**< Service has written completions */
+
+/**
+ * @struct virgil_ring_header_t
+ * Header of shared memory. Submission slots follow header, completion slots follow submission slots.
+ */
+typedef struct __attribute__((__packed__)) {
+    __u32 magic;                                /**< VIRGIL_RING_MAGIC */
+    __u32 version;                              /**< VIRGIL_RING_VERSION */
+    __u32 slots_cnt;                            /**< count of slots in each ring */
+    __u32 slot_sz;                              /**< size of one slot */
+    __u32 sq_head;                              /**< next submission to be read (written by service) */
+    __u32 sq_tail;                              /**< next submission to be written (written by kernel) */
+    __u32 cq_head;                              /**< next completion to be read (written by kernel) */
+    __u32 cq_tail;                              /**< next completion to be written (written by service) */
+    __u32 sq_sizes[VIRGIL_RING_SLOTS_CNT];      /**< sizes of messages in submission slots */
+    __u32 cq_sizes[VIRGIL_RING_SLOTS_CNT];      /**< sizes of messages in completion slots */
+} virgil_ring_header_t;
+
+typedef void (*ring_processor_cb)(__u32 port, void * data, __u32 data_sz);
+
+/**
+ * @brief Set data processor callback.
+ * Data is slot of completion ring, which is mapped by user space, so processor must copy it before parsing.
+ *
+ * @param[in] processor             - pointer to data processing function
+ */
+extern void ring_set_processor(ring_processor_cb processor);
+
+/**
+ * @brief Register character device.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int ring_start(void);
+
+/**
+ * @brief Unregister character device.
+ * Workers get hang-up from poll. Returns after all rings have been closed.
+ */
+extern void ring_stop(void);
+
+/**
+ * @brief Reserve submission slot of ring instance for message.
+ * On success ring stays locked until ring_frame_commit, so caller must not sleep in between.
+ *
+ * @param[in] port                - port of ring instance
+ * @param[in] data_sz             - size of message
+ *
+ * @return pointer to slot or 0 if ring is not mapped, full or message is too big.
+ */
+extern void * ring_frame_reserve(__u32 port, __u32 data_sz);
+
+/**
+ * @brief Publish message written into slot reserved by ring_frame_reserve and wake up worker.
+ *
+ * @param[in] port                - port of ring instance
+ * @param[in] data_sz             - size of message
+ */
+extern void ring_frame_commit(__u32 port, __u32 data_sz);
+
+#endif /* RING_H */
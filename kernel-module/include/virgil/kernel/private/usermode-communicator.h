@@ -44,28 +44,34 @@
 
 #include <linux/module.h>
 
+#include <linux/skbuff.h>
+#include <linux/version.h>
+
 #include <virgil/kernel/types.h>
+#include <virgil/kernel/request.h>
 #include <virgil/kernel/private/log.h>
 #include <virgil/kernel/private/fields.h>
 
 #define VIRGIL_CMD_PROCESSORS_MAX   20      /**< Maximum count of command processors */
+#define VIRGIL_SERVICE_START_TIMEOUT_MS 5000 /**< Time for worker of user-space service to become ready */
+#define VIRGIL_BATCH_REQUESTS_MAX   64      /**< Maximum count of requests in one datagram of batch */
 
-/** Macros for data send result checking. */
-#define SEND_WITH_CHECK(CMD, FIELDS, RES, MESSAGE) do {                 \
-        RES = communicator_send_data(CMD, FIELDS);                      \
-        if (VIRGIL_INVALID_ID == RES) {                                 \
-            LOG(MESSAGE);                                               \
-            return VIRGIL_INVALID_ID;                                   \
-        }                                                               \
-        } while(0);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 4, 0)
+#define GFP_CAN_SLEEP(GFP) gfpflags_allow_blocking(GFP)
+#else
+#define GFP_CAN_SLEEP(GFP) (0 != ((GFP) & __GFP_WAIT))
+#endif
 
-/** Check result of request to user-space service. */
-#define REQUEST_CHECK(ID, REQUEST) do {                 				\
-        ID = (REQUEST);                      							\
-        if (VIRGIL_INVALID_ID == ID) {                                 	\
-            return VIRGIL_OPERATION_ERROR;                              \
-        }                                                               \
-        } while(0);
+/**
+ * @struct virgil_batch
+ * Batch of requests collected into one datagram.
+ */
+struct virgil_batch {
+    struct sk_buff * skb;               /**< datagram with collected requests */
+    __u32 port;                         /**< worker which receives datagram */
+    __u32 ids[VIRGIL_BATCH_REQUESTS_MAX]; /**< ids of collected requests, they are failed if datagram isn't sent */
+    __u32 count;                        /**< count of collected requests */
+};
 
 /** Check data for non zero value and return error in other case. */
 #define NOT_ZERO(VAL) do {                 								\
@@ -97,18 +103,21 @@
  * @param[in] request_id            - id of user space request.
  * @param[in] command_type          - command type
  * @param[in] fields                - array of field structures
+ * @param[in,out] owner             - owner of buffer with data of fields, processor can take buffer (see fields_take)
  *
  * @return VIRGIL_OPERATION_ERROR - data not hasn't been processed, VIRGIL_OPERATION_OK - data processing done.
  */
-typedef int (*command_processor_cb)(__u32 request_id, __u16 command_type, fields_t fields);
+typedef int (*command_processor_cb)(__u32 request_id, __u16 command_type, fields_t fields, fields_owner_t * owner);
 
 /**
  * @brief Callback for received data processing (comming from netlink).
  *
+ * @param[in] port                  - worker which has sent data
  * @param[in] data                  - response data
  * @param[in] data_sz               - response data size.
+ * @param[in] skb                   - netlink datagram which holds data (0 if data isn't kept by datagram)
  */
-extern void communicator_parser_data(void * data, __u32 data_sz);
+extern void communicator_parser_data(__u32 port, void * data, __u32 data_sz, struct sk_buff * skb);
 
 /**
  * @brief Add callback for parsed response (can be set up to VIRGIL_CMD_PROCESSORS_MAX callbacks).
@@ -119,13 +128,38 @@ extern void communicator_parser_data(void * data, __u32 data_sz);
  */
 extern int communicator_add_processor_callback(command_processor_cb callback);
 
+/**
+ * @brief Get id for new request to user space.
+ *
+ * @return unique request id (never VIRGIL_INVALID_ID).
+ */
+extern __u32 communicator_next_id(void);
+
 /**
  * @brief Send data to user space.
  *
- * @param[in] command_type          - command code
+ * @param[in] id                    - request id
+ * @param[in] command               - command code
+ * @param[in] priority              - priority class of request (VIRGIL_PRIORITY_xxx, not default)
+ * @param[in] deadline              - time (jiffies) after which response isn't needed. It's passed to worker.
  * @param[in] fields                - fields data
+ * @param[in] gfp                   - allocation flags
+ * @param[in] batch                 - batch for request (can be 0)
+ * @param[out] port                 - worker selected for request. Request is outstanding for it until ports_release.
+ *
+ * @return [VIRGIL_OPERATION_OK, VIRGIL_OPERATION_ERROR, VIRGIL_OPERATION_UNAVAILABLE if there are no workers
+ *          or VIRGIL_OPERATION_BUSY if windows of workers are full for priority class].
+ */
+extern int communicator_send(__u32 id, __u16 command, __u8 priority, unsigned long deadline,
+        fields_t fields, gfp_t gfp, virgil_batch_t * batch, __u32 * port);
+
+/**
+ * @brief Notify worker that response for request isn't needed anymore.
+ *
+ * @param[in] id                    - request id
+ * @param[in] port                  - worker which processes request
  */
-extern __u32 communicator_send_data(__u16 command, fields_t fields);
+extern void communicator_cancel(__u32 id, __u32 port);
 
 /**
  * @brief Start communication.
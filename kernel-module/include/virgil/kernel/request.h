@@ -0,0 +1,159 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file request.h
+ * @brief API for asynchronous requests to user-space service.
+ * Every blocking function has a pair of functions xxx_submit / xxx_result.
+ * Submit sends request and returns immediately with request handle,
+ * result waits for response (if it isn't received yet), parses it and frees the handle.
+ */
+
+#ifndef VIRGIL_REQUEST_H
+#define VIRGIL_REQUEST_H
+
+#include <linux/types.h>
+#include <linux/gfp.h>
+
+#include <virgil/kernel/types.h>
+
+#define VIRGIL_PRIORITY_DEFAULT     0   /**< Priority class is selected by command */
+#define VIRGIL_PRIORITY_CRITICAL    1   /**< Latency-critical requests (sign, verify, hash by default) */
+#define VIRGIL_PRIORITY_NORMAL      2   /**< Other local operations */
+#define VIRGIL_PRIORITY_BULK        3   /**< Slow requests which use network (certificate creation, loading, revocation) */
+#define VIRGIL_PRIORITY_CLASSES     4   /**< Count of priority classes */
+
+/** Handle of asynchronous request */
+typedef struct virgil_request virgil_request_t;
+
+/**
+ * Batch of requests. Requests submitted with batch are sent to user-space service together
+ * (in one datagram) on virgil_batch_flush. Batch is owned by one submitter and has no locking inside.
+ */
+typedef struct virgil_batch virgil_batch_t;
+
+/**
+ * @brief Request completion callback.
+ * Called from communication context when response has been received, so it shouldn't block.
+ * It's allowed to call xxx_result function for given request inside of callback.
+ * Callback can be called before xxx_submit returns. Handle is already stored then, but if callback
+ * has called xxx_result or virgil_request_free, handle returned by submit mustn't be used.
+ *
+ * @param[in] request       - completed request.
+ * @param[in] ctx           - user context passed in request options.
+ */
+typedef void (*virgil_request_cb)(virgil_request_t * request, void * ctx);
+
+/**
+ * @struct virgil_request_opts_t
+ * Options of asynchronous request. Pointer to options can be 0, then default values are used.
+ */
+typedef struct {
+    virgil_request_cb callback;     /**< Completion callback (can be 0) */
+    void * ctx;                     /**< User context for completion callback */
+    gfp_t gfp;                      /**< Allocation flags for request submission. GFP_ATOMIC for contexts which must not sleep */
+    virgil_batch_t * batch;         /**< Batch for request (can be 0). Request isn't sent until batch flush */
+    __u32 timeout_ms;               /**< Time for processing of request. Worker drops request after it. 0 - VIRGIL_OPERATION_TIMEOUT_MS */
+    __u8 priority;                  /**< Priority class (VIRGIL_PRIORITY_xxx). Classes share service with weighted fair queueing */
+    __u32 busy_wait_ms;             /**< Time to wait for free room if too many requests are pending (needs sleeping gfp).
+                                         0 - VIRGIL_OPERATION_BUSY is returned at once */
+} virgil_request_opts_t;
+
+/**
+ * @brief Check is response for request received.
+ *
+ * @param[in] request       - request handle.
+ *
+ * @return true if request has been completed.
+ */
+extern bool virgil_request_is_done(virgil_request_t * request);
+
+/**
+ * @brief Wait for request completion. Request handle stays valid.
+ *
+ * @param[in] request       - request handle.
+ * @param[in] timeout_ms    - wait timeout.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_request_wait(virgil_request_t * request, __u32 timeout_ms);
+
+/**
+ * @brief Wait for completion of all given requests. Request handles stay valid.
+ *
+ * @param[in] requests      - array of request handles.
+ * @param[in] count         - count of request handles.
+ * @param[in] timeout_ms    - common wait timeout for all requests.
+ *
+ * @return VIRGIL_OPERATION_OK if all requests have been completed.
+ */
+extern int virgil_request_wait_all(virgil_request_t ** requests, __u32 count, __u32 timeout_ms);
+
+/**
+ * @brief Drop request without reading of result.
+ * Doesn't block. If response is being processed, request is freed when its processing ends.
+ *
+ * @param[in] request       - request handle.
+ */
+extern void virgil_request_free(virgil_request_t * request);
+
+/**
+ * @brief Create batch of requests.
+ *
+ * @param[in] gfp           - allocation flags.
+ *
+ * @return new batch or 0 in case of error.
+ */
+extern virgil_batch_t * virgil_batch_create(gfp_t gfp);
+
+/**
+ * @brief Send all requests collected in batch.
+ * If datagram can't be sent, its requests are completed with VIRGIL_OPERATION_ERROR status.
+ *
+ * @param[in] batch         - batch of requests.
+ *
+ * @return [VIRGIL_OPERATION_OK or VIRGIL_OPERATION_ERROR].
+ */
+extern int virgil_batch_flush(virgil_batch_t * batch);
+
+/**
+ * @brief Send all requests collected in batch and free it.
+ *
+ * @param[in] batch         - batch of requests.
+ */
+extern void virgil_batch_free(virgil_batch_t * batch);
+
+#endif /* VIRGIL_REQUEST_H */
@@ -46,6 +46,9 @@
 
 #define VIRGIL_OPERATION_OK     0               /**< Operation result is OK*/
 #define VIRGIL_OPERATION_ERROR  1               /**< Operation result is GENERAL ERROR*/
+#define VIRGIL_OPERATION_UNAVAILABLE 2          /**< User-space service is unavailable (not started or disconnected) */
+#define VIRGIL_OPERATION_BUSY   3               /**< Too many requests are pending or workers of user-space service are busy and request can't wait in queue */
+#define VIRGIL_OPERATION_REJECTED 4             /**< Operation has been done and its answer is negative (certificate isn't verified) */
 
 #define VIRGIL_OPERATION_TIMEOUT_MS     15000    /**< Timeout of each operation in milliseconds */
 
@@ -73,9 +76,17 @@
 #define VIRGIL_CMD_CERTIFICATE_CRL_INFO     	18  	/**< Get CRL info */
 #define VIRGIL_CMD_CERTIFICATE_CHECK_IS_REVOKED 19  	/**< Check is certificate revoked */
 
-#define VIRGIL_CMD_MAX          				20
+#define VIRGIL_CMD_FRAGMENT     				20  	/**< Fragment of frame which doesn't fit into single message */
+#define VIRGIL_CMD_CANCEL       				21  	/**< Response for request isn't needed anymore */
+#define VIRGIL_CMD_LOAD         				22  	/**< Worker reports depth of its queue */
+#define VIRGIL_CMD_CRL_CHANGED  				23  	/**< Worker received new CRL, cached results of certificate checks are dropped */
+#define VIRGIL_CMD_CRYPTO_VERIFY_BATCH			24  	/**< Verify signatures of many data items in one request */
+#define VIRGIL_CMD_CRYPTO_SIGN_BATCH			25  	/**< Sign many data items with one private key in one request */
+
+#define VIRGIL_CMD_MAX          				26
 
 #define VIRGIL_RECIPIENTS_COUNT_MAX		50
+#define VIRGIL_BATCH_COUNT_MAX			256		/**< Maximum count of items in batch request */
 
 #define VIRGIL_KV_KEY_MAX_SZ    50              /**< Maximum size of key in key-value pair */
 
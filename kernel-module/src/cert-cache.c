@@ -0,0 +1,256 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file cert-cache.c
+ * @brief Cache of results of certificate verification (rcu-table.h) and pinned root certificate.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/mutex.h>
+#include <linux/jiffies.h>
+
+#include <virgil/kernel/crypto.h>
+#include <virgil/kernel/private/log.h>
+#include <virgil/kernel/private/local-crypto.h>
+#include <virgil/kernel/private/rcu-table.h>
+#include <virgil/kernel/private/cert-cache.h>
+#include <virgil/kernel/private/revocation.h>
+
+#define DIGEST_SZ   (VIRGIL_CERT_CACHE_KEY_SZ / 2)  /**< Size of SHA-256 */
+
+typedef struct {
+    rcu_table_node_t node;
+    unsigned long expires;              // time (jiffies) after which result isn't used
+    bool is_ok;
+    __u8 key[VIRGIL_CERT_CACHE_KEY_SZ];
+} result_entry_t;
+
+// Changed on receive of new CRL, results of requests sent before aren't cached
+static __u32 generation = 0;
+
+static unsigned int cert_cache_max = VIRGIL_CERT_CACHE_MAX;
+module_param(cert_cache_max, uint, 0644);
+MODULE_PARM_DESC(cert_cache_max, "Maximum count of cached results of certificate verification (0 disables cache)");
+
+static unsigned int cert_cache_ttl_s = VIRGIL_CERT_CACHE_TTL_S;
+module_param(cert_cache_ttl_s, uint, 0644);
+MODULE_PARM_DESC(cert_cache_ttl_s, "Time of use of cached result of certificate verification, seconds");
+
+// Pinned root certificate (protected by root_lock)
+static DEFINE_MUTEX(root_lock);
+static data_t root = { 0, 0 };
+static __u32 root_generation = 0;
+
+/******************************************************************************/
+static bool entry_match(const rcu_table_node_t * node, const void * key) {
+    return 0 == memcmp(((const result_entry_t *)node)->key, key, VIRGIL_CERT_CACHE_KEY_SZ);
+}
+
+// Changes of results and generation are done under lock of table
+DEFINE_RCU_TABLE(results, VIRGIL_CERT_CACHE_HASH_BITS, entry_match, 0);
+
+/******************************************************************************/
+int cert_cache_digest(data_t certificate, __u8 * digest) {
+    struct package_field_t field;
+    __u8 buf[VIRGIL_LOCAL_DIGEST_MAX];
+    __u32 buf_sz = 0;
+
+    if (!certificate.data || !digest) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    FILL_FIELD(field, VIRGIL_FIELD_DATA, certificate);
+
+    CHECK(local_hash(HASH_SHA256, &field, buf, &buf_sz));
+    if (DIGEST_SZ != buf_sz) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    memcpy(digest, buf, DIGEST_SZ);
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+int cert_cache_key(data_t certificate, data_t root_certificate, __u8 * key) {
+    if (!root_certificate.data || !key) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    CHECK(cert_cache_digest(certificate, key));
+    return cert_cache_digest(root_certificate, key + DIGEST_SZ);
+}
+
+/******************************************************************************/
+int cert_cache_lookup(const __u8 * key, bool * is_ok) {
+    result_entry_t * entry;
+    int res = VIRGIL_OPERATION_UNAVAILABLE;
+
+    rcu_read_lock();
+    entry = (result_entry_t *)rcu_table_find(&results, key, rcu_table_digest_hash(key));
+
+    // Expired result is replaced by next verification or evicted
+    if (entry && time_before(jiffies, entry->expires)) {
+        *is_ok = entry->is_ok;
+        res = VIRGIL_OPERATION_OK;
+    }
+    rcu_read_unlock();
+
+    return res;
+}
+
+/******************************************************************************/
+__u32 cert_cache_generation(void) {
+    return ACCESS_ONCE(generation);
+}
+
+/******************************************************************************/
+void cert_cache_add(const __u8 * key, bool is_ok, __u32 key_generation) {
+    result_entry_t * entry;
+
+    if (!ACCESS_ONCE(cert_cache_max)) {
+        return;
+    }
+
+    entry = kmalloc(sizeof(*entry), GFP_KERNEL);
+    if (!entry) {
+        return;
+    }
+
+    entry->node.hash = rcu_table_digest_hash(key);
+    entry->expires = jiffies + ACCESS_ONCE(cert_cache_ttl_s) * HZ;
+    entry->is_ok = is_ok;
+    memcpy(entry->key, key, VIRGIL_CERT_CACHE_KEY_SZ);
+
+    spin_lock_bh(&results.lock);
+
+    if (key_generation != generation) {
+        spin_unlock_bh(&results.lock);
+        kfree(entry);
+        return;
+    }
+
+    rcu_table_insert_locked(&results, &entry->node, key, cert_cache_max);
+
+    spin_unlock_bh(&results.lock);
+}
+
+/******************************************************************************/
+static void cert_cache_flush(void) {
+    spin_lock_bh(&results.lock);
+    generation++;
+    rcu_table_clear_locked(&results);
+    spin_unlock_bh(&results.lock);
+}
+
+/******************************************************************************/
+int cert_cache_root_get(data_t * root_certificate) {
+    int res = VIRGIL_OPERATION_UNAVAILABLE;
+
+    if (!root_certificate) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    mutex_lock(&root_lock);
+    if (root.data) {
+        res = virgil_data_dup(root_certificate, root);
+    }
+    mutex_unlock(&root_lock);
+
+    return res;
+}
+
+/******************************************************************************/
+__u32 cert_cache_root_generation(void) {
+    __u32 res;
+
+    mutex_lock(&root_lock);
+    res = root_generation;
+    mutex_unlock(&root_lock);
+
+    return res;
+}
+
+/******************************************************************************/
+void cert_cache_root_set(data_t root_certificate, __u32 certificate_generation) {
+    data_t copy;
+
+    if (!root_certificate.data || !root_certificate.sz
+            || VIRGIL_OPERATION_OK != virgil_data_dup(&copy, root_certificate)) {
+        return;
+    }
+
+    mutex_lock(&root_lock);
+    if (certificate_generation == root_generation) {
+        virgil_data_free(&root);
+        root = copy;
+        virgil_data_reset(&copy);
+    }
+    mutex_unlock(&root_lock);
+
+    virgil_data_free(&copy);
+}
+
+/******************************************************************************/
+void cert_cache_root_reset(void) {
+    mutex_lock(&root_lock);
+    root_generation++;
+    virgil_data_free(&root);
+    mutex_unlock(&root_lock);
+}
+
+/******************************************************************************/
+int cert_cache_command_processor(__u32 request_id, __u16 command_type, fields_t fields, fields_owner_t * owner) {
+    if (VIRGIL_CMD_CRL_CHANGED != command_type) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    cert_cache_flush();
+    revocation_update(fields);
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+void cert_cache_cleanup(void) {
+    rcu_table_destroy(&results);
+
+    cert_cache_root_reset();
+    revocation_cleanup();
+}
@@ -0,0 +1,155 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file cert-table.c
+ * @brief Table of certificates known to kernel, keyed by HashedId8 of certificate (rcu-table.h).
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include <virgil/kernel/private/log.h>
+#include <virgil/kernel/private/rcu-table.h>
+#include <virgil/kernel/private/cert-table.h>
+
+typedef struct {
+    rcu_table_node_t node;
+    __u8 hashed_id8[HASHED_ID8_SIZE];
+    __u32 cert_sz;
+    __u32 key_sz;
+    __u8 data[0];                       // certificate followed by public key
+} cert_entry_t;
+
+static unsigned int cert_table_max = VIRGIL_CERT_TABLE_MAX;
+module_param(cert_table_max, uint, 0644);
+MODULE_PARM_DESC(cert_table_max, "Maximum count of certificates resolved by HashedId8 in kernel (0 disables table)");
+
+/******************************************************************************/
+static bool entry_match(const rcu_table_node_t * node, const void * hashed_id8) {
+    return 0 == memcmp(((const cert_entry_t *)node)->hashed_id8, hashed_id8, HASHED_ID8_SIZE);
+}
+
+DEFINE_RCU_TABLE(certs, VIRGIL_CERT_TABLE_HASH_BITS, entry_match, 0);
+
+/******************************************************************************/
+int cert_table_add(const __u8 * hashed_id8, data_t certificate, data_t public_key) {
+    cert_entry_t * entry;
+
+    if (!hashed_id8 || !certificate.data || !certificate.sz
+            || (public_key.sz && !public_key.data)) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    if (!ACCESS_ONCE(cert_table_max)) {
+        return VIRGIL_OPERATION_OK;
+    }
+
+    entry = kmalloc(sizeof(*entry) + certificate.sz + public_key.sz, GFP_KERNEL);
+    if (!entry) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    entry->node.hash = rcu_table_digest_hash(hashed_id8);
+    memcpy(entry->hashed_id8, hashed_id8, HASHED_ID8_SIZE);
+    entry->cert_sz = certificate.sz;
+    entry->key_sz = public_key.sz;
+    memcpy(entry->data, certificate.data, certificate.sz);
+    if (public_key.sz) {
+        memcpy(entry->data + certificate.sz, public_key.data, public_key.sz);
+    }
+
+    spin_lock_bh(&certs.lock);
+    rcu_table_insert_locked(&certs, &entry->node, hashed_id8, cert_table_max);
+    spin_unlock_bh(&certs.lock);
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+int cert_table_find(const __u8 * hashed_id8, data_t * certificate, data_t * public_key) {
+    cert_entry_t * entry;
+    int res = VIRGIL_OPERATION_UNAVAILABLE;
+
+    if (!hashed_id8) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    if (certificate) virgil_data_reset(certificate);
+    if (public_key) virgil_data_reset(public_key);
+
+    rcu_read_lock();
+    entry = (cert_entry_t *)rcu_table_find(&certs, hashed_id8, rcu_table_digest_hash(hashed_id8));
+    if (entry) {
+        res = VIRGIL_OPERATION_OK;
+
+        // Copies are done under RCU, so atomic allocation is used
+        if (certificate) {
+            certificate->data = kmemdup(entry->data, entry->cert_sz, GFP_ATOMIC);
+            certificate->sz = certificate->data ? entry->cert_sz : 0;
+            if (!certificate->data) res = VIRGIL_OPERATION_ERROR;
+        }
+
+        if (public_key && entry->key_sz && VIRGIL_OPERATION_OK == res) {
+            public_key->data = kmemdup(entry->data + entry->cert_sz, entry->key_sz, GFP_ATOMIC);
+            public_key->sz = public_key->data ? entry->key_sz : 0;
+            if (!public_key->data) res = VIRGIL_OPERATION_ERROR;
+        }
+    }
+    rcu_read_unlock();
+
+    if (VIRGIL_OPERATION_ERROR == res) {
+        if (certificate) virgil_data_free(certificate);
+        if (public_key) virgil_data_free(public_key);
+    }
+
+    return res;
+}
+
+/******************************************************************************/
+void cert_table_remove(const __u8 * hashed_id8) {
+    if (!hashed_id8) {
+        return;
+    }
+
+    rcu_table_remove(&certs, hashed_id8, rcu_table_digest_hash(hashed_id8));
+}
+
+/******************************************************************************/
+void cert_table_cleanup(void) {
+    rcu_table_destroy(&certs);
+}
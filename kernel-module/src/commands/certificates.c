@@ -45,21 +45,28 @@
 #include <virgil/kernel/private/usermode-communicator.h>
 #include <virgil/kernel/private/data-waiter.h>
 #include <virgil/kernel/private/fields.h>
+#include <virgil/kernel/private/cert-cache.h>
+#include <virgil/kernel/private/revocation.h>
 #include <virgil/kernel/foundation/key-value.h>
+#include <virgil/kernel/certificates.h>
 
 const char * KEY_IDENTITY = "v__IdentityKey";
 const char * KEY_PUBLIC_KEY = "v__PublicKeyKey";
 
 /******************************************************************************/
-static __u32 certificate_create_request(int ec_type,
+int virgil_certificate_create_submit(int ec_type,
 		const char * identifier,
-		kv_container_t addition_data) {
+		kv_container_t addition_data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[3];
-	__u32 res;
+	int res;
 	data_t serialized_data;
 	const __u8 _ec_type = ec_type;
 
+	// Check input parameters
+	VALID_STR(identifier);
+
 	virgil_data_reset(&serialized_data);
 
 	fields.count = 3;
@@ -70,10 +77,10 @@ static __u32 certificate_create_request(int ec_type,
 	FILL_FIELD(fields_ar[1], VIRGIL_FIELD_DATA, serialized_data);
 	FILL_FIELD_AR(fields_ar[2], VIRGIL_FIELD_CURVE_TYPE, &_ec_type, sizeof(_ec_type));
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_CREATE,
-			fields,
-			res,
-			"ERROR: Certificate creation can't be processed");
+	res = data_waiter_submit(VIRGIL_CMD_CERTIFICATE_CREATE, fields, opts, request);
+	if (VIRGIL_OPERATION_OK != res) {
+		LOG("ERROR: Certificate creation can't be processed");
+	}
 
 	virgil_data_free(&serialized_data);
 
@@ -81,21 +88,17 @@ static __u32 certificate_create_request(int ec_type,
 }
 
 /******************************************************************************/
-int virgil_certificate_create(int ec_type, const char * identifier,
-		kv_container_t addition_data, data_t * private_key,
-		data_t * certificate) {
-	__u32 id;
+int virgil_certificate_create_result(virgil_request_t * request,
+		data_t * private_key, data_t * certificate) {
 	__s16 err_res;
 	fields_t fields;
 
 	// Check input parameters
-	VALID_STR(identifier);
-	NOT_ZERO(private_key);
-	NOT_ZERO(certificate);
+	RESULT_NOT_ZERO(request, private_key);
+	RESULT_NOT_ZERO(request, certificate);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, certificate_create_request(ec_type, identifier, addition_data));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Clear output data
 	virgil_data_reset(private_key);
@@ -112,37 +115,53 @@ int virgil_certificate_create(int ec_type, const char * identifier,
 }
 
 /******************************************************************************/
-static __u32 certificate_get_request(const char * identifier) {
+int virgil_certificate_create(int ec_type, const char * identifier,
+		kv_container_t addition_data, data_t * private_key,
+		data_t * certificate) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(private_key);
+	NOT_ZERO(certificate);
+
+	// Send request and wait for response
+	CHECK(virgil_certificate_create_submit(ec_type, identifier, addition_data, 0, &request));
+	return virgil_certificate_create_result(request, private_key, certificate);
+}
+
+/******************************************************************************/
+int virgil_certificate_get_submit(const char * identifier,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
-	__u32 res;
 	struct package_field_t fields_ar[1];
 
+	// Check input parameters
+	VALID_STR(identifier);
+
 	fields.count = 1;
 	fields.ar = fields_ar;
 
 	FILL_FIELD_STR(fields_ar[0], VIRGIL_FIELD_IDENTITY, identifier);
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_GET,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_GET,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Certificate request can't be processed");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_certificate_get(const char * identifier, data_t * certificate) {
-	__u32 id;
+int virgil_certificate_get_result(virgil_request_t * request, data_t * certificate) {
 	__s16 err_res;
 	fields_t fields;
 
 	// Check input parameters
-	VALID_STR(identifier);
-	NOT_ZERO(certificate);
+	RESULT_NOT_ZERO(request, certificate);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, certificate_get_request(identifier));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Clear output data
 	virgil_data_reset(certificate);
@@ -157,9 +176,21 @@ int virgil_certificate_get(const char * identifier, data_t * certificate) {
 }
 
 /******************************************************************************/
-static __u32 certificate_verify_request(data_t certificate, data_t root_certificate) {
+int virgil_certificate_get(const char * identifier, data_t * certificate) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(certificate);
+
+	// Send request and wait for response
+	CHECK(virgil_certificate_get_submit(identifier, 0, &request));
+	return virgil_certificate_get_result(request, certificate);
+}
+
+/******************************************************************************/
+static int certificate_verify_send(data_t certificate, data_t root_certificate,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
-	__u32 res;
 	struct package_field_t fields_ar[2];
 
 	fields.count = 2;
@@ -168,27 +199,53 @@ static __u32 certificate_verify_request(data_t certificate, data_t root_certific
 	FILL_FIELD(fields_ar[0], VIRGIL_FIELD_CERT, certificate);
 	FILL_FIELD(fields_ar[1], VIRGIL_FIELD_ROOT_CERT, root_certificate);
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_VERIFY,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_VERIFY,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Certificate verification can't be processed");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_certificate_verify(data_t certificate, data_t root_certificate, bool * is_ok) {
-	__u32 id;
+int virgil_certificate_verify_submit(data_t certificate, data_t root_certificate,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	fields_t fields;
+	struct package_field_t fields_ar[1];
+	__u8 key[VIRGIL_CERT_CACHE_KEY_SZ];
+	bool is_ok;
+	__s16 result;
+
+	// Cached result is returned without request to service
+	if (VIRGIL_OPERATION_OK == cert_cache_key(certificate, root_certificate, key)
+			&& VIRGIL_OPERATION_OK == cert_cache_lookup(key, &is_ok)) {
+		result = is_ok ? VIRGIL_OPERATION_OK : VIRGIL_OPERATION_REJECTED;
+
+		fields.count = 1;
+		fields.ar = fields_ar;
+
+		FILL_FIELD_AR(fields_ar[0], VIRGIL_FIELD_RES, &result, sizeof(result));
+
+		return data_waiter_submit_done(VIRGIL_CMD_CERTIFICATE_VERIFY, fields, opts, request);
+	}
+
+	return certificate_verify_send(certificate, root_certificate, opts, request);
+}
+
+/******************************************************************************/
+/* Only definitive answer of service (is_definitive) can be cached: certificate is verified or rejected.
+ * Errors of service aren't cached, they can pass on retry. */
+static int certificate_verify_result(virgil_request_t * request, bool * is_ok, bool * is_definitive) {
 	__s16 result;
 	fields_t fields;
 	int res = 0;
 
 	// Check input parameters
-	NOT_ZERO(is_ok);
+	RESULT_NOT_ZERO(request, is_ok);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, certificate_verify_request(certificate, root_certificate));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Parse response
 	res = fields_result(fields, &result);
@@ -199,43 +256,80 @@ int virgil_certificate_verify(data_t certificate, data_t root_certificate, bool
 
 	*is_ok = VIRGIL_OPERATION_OK == result;
 
+	if (is_definitive) {
+		*is_definitive = VIRGIL_OPERATION_OK == res
+				&& (VIRGIL_OPERATION_OK == result || VIRGIL_OPERATION_REJECTED == result);
+	}
+
 	fields_free(&fields);
 
 	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-static __u32 certificate_parse_request(data_t certificate) {
+int virgil_certificate_verify_result(virgil_request_t * request, bool * is_ok) {
+	return certificate_verify_result(request, is_ok, 0);
+}
+
+/******************************************************************************/
+int virgil_certificate_verify(data_t certificate, data_t root_certificate, bool * is_ok) {
+	virgil_request_t * request;
+	__u8 key[VIRGIL_CERT_CACHE_KEY_SZ];
+	__u32 generation;
+	bool is_cacheable, is_definitive = false;
+	int res;
+
+	// Check input parameters
+	NOT_ZERO(is_ok);
+
+	is_cacheable = VIRGIL_OPERATION_OK == cert_cache_key(certificate, root_certificate, key);
+	if (is_cacheable && VIRGIL_OPERATION_OK == cert_cache_lookup(key, is_ok)) {
+		return VIRGIL_OPERATION_OK;
+	}
+	generation = cert_cache_generation();
+
+	// Send request and wait for response
+	CHECK(certificate_verify_send(certificate, root_certificate, 0, &request));
+	res = certificate_verify_result(request, is_ok, &is_definitive);
+
+	if (VIRGIL_OPERATION_OK == res && is_cacheable && is_definitive) {
+		cert_cache_add(key, *is_ok, generation);
+	}
+
+	return res;
+}
+
+/******************************************************************************/
+int virgil_certificate_parse_submit(data_t certificate,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[1];
-	__u32 res;
 
 	fields.count = 1;
 	fields.ar = fields_ar;
 
 	FILL_FIELD(fields_ar[0], VIRGIL_FIELD_CERT, certificate);
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_PARSE,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_PARSE,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Certificate parse can't be processed");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_certificate_parse(data_t certificate, kv_container_t * cert_data) {
-	__u32 id;
+int virgil_certificate_parse_result(virgil_request_t * request, kv_container_t * cert_data) {
 	__s16 err_res;
 	fields_t fields;
 	data_t kv_raw;
 
 	// Check input parameters
-	NOT_ZERO(cert_data);
+	RESULT_NOT_ZERO(request, cert_data);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, certificate_parse_request(certificate));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Clear output data
 	virgil_kv_reset(cert_data);
@@ -255,11 +349,26 @@ int virgil_certificate_parse(data_t certificate, kv_container_t * cert_data) {
 }
 
 /******************************************************************************/
-static __u32 certificate_revoke_request(const char * identifier,
-		data_t private_key) {
+int virgil_certificate_parse(data_t certificate, kv_container_t * cert_data) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(cert_data);
+
+	// Send request and wait for response
+	CHECK(virgil_certificate_parse_submit(certificate, 0, &request));
+	return virgil_certificate_parse_result(request, cert_data);
+}
+
+/******************************************************************************/
+int virgil_certificate_revoke_submit(const char * identifier,
+		data_t private_key,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[2];
-	__u32 res;
+
+	// Check input parameters
+	VALID_STR(identifier);
 
 	fields.count = 2;
 	fields.ar = fields_ar;
@@ -267,29 +376,26 @@ static __u32 certificate_revoke_request(const char * identifier,
 	FILL_FIELD_STR(fields_ar[0], VIRGIL_FIELD_IDENTITY, identifier);
 	FILL_FIELD(fields_ar[1], VIRGIL_FIELD_PRIVATE_KEY, private_key);
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_REVOKE,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_REVOKE,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Certificate revocation can't be processed");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_certificate_revoke(const char * identifier, data_t private_key,
-		bool * is_ok) {
-	__u32 id;
+int virgil_certificate_revoke_result(virgil_request_t * request, bool * is_ok) {
 	__s16 result;
 	fields_t fields;
 	int res = 0;
 
 	// Check input parameters
-	VALID_STR(identifier);
-	NOT_ZERO(is_ok);
+	RESULT_NOT_ZERO(request, is_ok);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, certificate_revoke_request(identifier, private_key));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Parse response
 	res = fields_result(fields, &result);
@@ -306,34 +412,45 @@ int virgil_certificate_revoke(const char * identifier, data_t private_key,
 }
 
 /******************************************************************************/
-static __u32 crl_info_request(void) {
+int virgil_certificate_revoke(const char * identifier, data_t private_key,
+		bool * is_ok) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(is_ok);
+
+	// Send request and wait for response
+	CHECK(virgil_certificate_revoke_submit(identifier, private_key, 0, &request));
+	return virgil_certificate_revoke_result(request, is_ok);
+}
+
+/******************************************************************************/
+int virgil_certificate_crl_info_submit(const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
-	__u32 res;
 
 	fields_reset(&fields);
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_CRL_INFO,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_CRL_INFO,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: CRL Can't be requested");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_certificate_crl_info(time_t * last, time_t * next) {
-	__u32 id;
+int virgil_certificate_crl_info_result(virgil_request_t * request, time_t * last, time_t * next) {
 	__s16 err_res;
 	fields_t fields;
 	data_t data;
 
 	// Check input parameters
-	NOT_ZERO(last);
-	NOT_ZERO(next);
+	RESULT_NOT_ZERO(request, last);
+	RESULT_NOT_ZERO(request, next);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, crl_info_request());
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Parse response
 	CHECK_ERROR(fields, err_res);
@@ -351,47 +468,128 @@ int virgil_certificate_crl_info(time_t * last, time_t * next) {
 }
 
 /******************************************************************************/
-static __u32 certificate_is_revoked_request(data_t certificate) {
+int virgil_certificate_crl_info(time_t * last, time_t * next) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(last);
+	NOT_ZERO(next);
+
+	// Send request and wait for response
+	CHECK(virgil_certificate_crl_info_submit(0, &request));
+	return virgil_certificate_crl_info_result(request, last, next);
+}
+
+/******************************************************************************/
+static int certificate_is_revoked_send(data_t certificate,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[1];
-	__u32 res;
 
 	fields.count = 1;
 	fields.ar = fields_ar;
 
 	FILL_FIELD(fields_ar[0], VIRGIL_FIELD_CERT, certificate);
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_CHECK_IS_REVOKED,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CERTIFICATE_CHECK_IS_REVOKED,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Certificate check can't be processed");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_certificate_is_revoked(data_t certificate, bool * is_revoked) {
-	__u32 id;
+int virgil_certificate_is_revoked_submit(data_t certificate,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	fields_t fields;
+	struct package_field_t fields_ar[1];
+	__u8 digest[VIRGIL_REVOCATION_DIGEST_SZ];
+	bool is_revoked;
+	__u8 revoked;
+
+	// Certificate with known id is checked in kernel
+	if (VIRGIL_OPERATION_OK == cert_cache_digest(certificate, digest)
+			&& VIRGIL_OPERATION_OK == revocation_check(digest, &is_revoked)) {
+		revoked = is_revoked ? 1 : 0;
+
+		fields.count = 1;
+		fields.ar = fields_ar;
+
+		FILL_FIELD_AR(fields_ar[0], VIRGIL_FIELD_OPTIONAL_1, &revoked, sizeof(revoked));
+
+		return data_waiter_submit_done(VIRGIL_CMD_CERTIFICATE_CHECK_IS_REVOKED, fields, opts, request);
+	}
+
+	return certificate_is_revoked_send(certificate, opts, request);
+}
+
+/******************************************************************************/
+/* Service reports id of certificate (SHA-256 of card id), it's copied to id if present */
+static int certificate_is_revoked_result(virgil_request_t * request, bool * is_revoked,
+		__u8 * id, bool * has_id) {
+	struct package_field_t * res_fields[1] = { 0 };
+	__u16 res_cnt = 0;
 	fields_t fields;
 	data_t data;
 
 	// Check input parameters
-	NOT_ZERO(is_revoked);
+	RESULT_NOT_ZERO(request, is_revoked);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, certificate_is_revoked_request(certificate));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Parse response
 	CHECK(fields_dup_first(VIRGIL_FIELD_OPTIONAL_1, fields, &data));
 	*is_revoked = !!((char *) data.data)[0];
 
+	if (id && has_id) {
+		fields_by_type(VIRGIL_FIELD_IDENTITY, fields, 1, &res_cnt, res_fields);
+		*has_id = res_cnt && VIRGIL_REVOCATION_DIGEST_SZ == res_fields[0]->data_sz;
+		if (*has_id) {
+			memcpy(id, res_fields[0]->data.p, VIRGIL_REVOCATION_DIGEST_SZ);
+		}
+	}
+
 	virgil_data_free(&data);
 	fields_free(&fields);
 
 	return VIRGIL_OPERATION_OK;
 }
 
+/******************************************************************************/
+int virgil_certificate_is_revoked_result(virgil_request_t * request, bool * is_revoked) {
+	return certificate_is_revoked_result(request, is_revoked, 0, 0);
+}
+
+/******************************************************************************/
+int virgil_certificate_is_revoked(data_t certificate, bool * is_revoked) {
+	virgil_request_t * request;
+	__u8 digest[VIRGIL_REVOCATION_DIGEST_SZ];
+	__u8 id[VIRGIL_REVOCATION_DIGEST_SZ];
+	bool has_digest, has_id = false;
+	int res;
+
+	// Check input parameters
+	NOT_ZERO(is_revoked);
+
+	has_digest = VIRGIL_OPERATION_OK == cert_cache_digest(certificate, digest);
+	if (has_digest && VIRGIL_OPERATION_OK == revocation_check(digest, is_revoked)) {
+		return VIRGIL_OPERATION_OK;
+	}
+
+	// Send request and wait for response
+	CHECK(certificate_is_revoked_send(certificate, 0, &request));
+	res = certificate_is_revoked_result(request, is_revoked, id, &has_id);
+
+	if (VIRGIL_OPERATION_OK == res && has_digest && has_id) {
+		revocation_learn(digest, id);
+	}
+
+	return res;
+}
+
 /******************************************************************************/
 int virgil_certificate_get_identity(data_t certificate, char ** identity) {
 	kv_container_t cert_data;
@@ -420,11 +618,25 @@ int virgil_certificate_get_identity(data_t certificate, char ** identity) {
 	return VIRGIL_OPERATION_ERROR;
 }
 
+EXPORT_SYMBOL( virgil_certificate_create_submit);
+EXPORT_SYMBOL( virgil_certificate_create_result);
 EXPORT_SYMBOL( virgil_certificate_create);
+EXPORT_SYMBOL( virgil_certificate_get_submit);
+EXPORT_SYMBOL( virgil_certificate_get_result);
 EXPORT_SYMBOL( virgil_certificate_get);
+EXPORT_SYMBOL( virgil_certificate_verify_submit);
+EXPORT_SYMBOL( virgil_certificate_verify_result);
 EXPORT_SYMBOL( virgil_certificate_verify);
+EXPORT_SYMBOL( virgil_certificate_parse_submit);
+EXPORT_SYMBOL( virgil_certificate_parse_result);
 EXPORT_SYMBOL( virgil_certificate_parse);
+EXPORT_SYMBOL( virgil_certificate_revoke_submit);
+EXPORT_SYMBOL( virgil_certificate_revoke_result);
 EXPORT_SYMBOL( virgil_certificate_revoke);
+EXPORT_SYMBOL( virgil_certificate_crl_info_submit);
+EXPORT_SYMBOL( virgil_certificate_crl_info_result);
 EXPORT_SYMBOL( virgil_certificate_crl_info);
+EXPORT_SYMBOL( virgil_certificate_is_revoked_submit);
+EXPORT_SYMBOL( virgil_certificate_is_revoked_result);
 EXPORT_SYMBOL( virgil_certificate_is_revoked);
 EXPORT_SYMBOL( virgil_certificate_get_identity);
@@ -48,10 +48,13 @@
 #include <virgil/kernel/crypto.h>
 
 /******************************************************************************/
-static __u32 decrypt_with_password_request(const char * password, data_t data) {
+int virgil_decrypt_with_password_submit(const char * password, data_t data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[2];
-	__u32 res;
+
+	// Check input parameters
+	VALID_STR(password);
 
 	fields.count = 2;
 	fields.ar = fields_ar;
@@ -59,45 +62,23 @@ static __u32 decrypt_with_password_request(const char * password, data_t data) {
 	FILL_FIELD_STR(fields_ar[0], VIRGIL_FIELD_PASSWORD, password);
 	FILL_FIELD(fields_ar[1], VIRGIL_FIELD_DATA, data);
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CRYPTO_DECRYPT_PASS,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CRYPTO_DECRYPT_PASS,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Decrypt with password can't be processed");
 
-	return res;
-}
-
-/******************************************************************************/
-int virgil_decrypt_with_password(const char * password, data_t data, data_t * decrypted_data) {
-	__u32 id;
-	__s16 err_res;
-	fields_t fields;
-
-	// Check input parameters
-	VALID_STR(password);
-	NOT_ZERO(decrypted_data);
-
-	// Send request and wait for response
-	REQUEST_CHECK(id, decrypt_with_password_request(password, data));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
-
-	// Clear output data
-	virgil_data_reset(decrypted_data);
-
-	// Parse response
-	CHECK_ERROR(fields, err_res);
-	CHECK(fields_dup_first(VIRGIL_FIELD_DATA, fields, decrypted_data));
-
-	fields_free(&fields);
-
 	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-static __u32 decrypt_with_key_request(data_t private_key, data_t data, const char * identity) {
+int virgil_decrypt_with_key_submit(data_t private_key, data_t data, const char * identity,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[3];
-	__u32 res;
+
+	// Check input parameters
+	VALID_STR(identity);
 
 	fields.count = 3;
 	fields.ar = fields_ar;
@@ -106,26 +87,25 @@ static __u32 decrypt_with_key_request(data_t private_key, data_t data, const cha
 	FILL_FIELD(fields_ar[1], VIRGIL_FIELD_DATA, data);
 	FILL_FIELD_STR(fields_ar[2], VIRGIL_FIELD_IDENTITY, identity);
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CRYPTO_DECRYPT,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CRYPTO_DECRYPT,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Decrypt can't be processed");
-	return res;
+
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_decrypt_with_key(data_t private_key, data_t data, const char * identity, data_t * decrypted_data) {
-	__u32 id;
+int virgil_decrypt_result(virgil_request_t * request, data_t * decrypted_data) {
 	__s16 err_res;
 	fields_t fields;
 
 	// Check input parameters
-	VALID_STR(identity);
-	NOT_ZERO(decrypted_data);
+	RESULT_NOT_ZERO(request, decrypted_data);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, decrypt_with_key_request(private_key, data, identity));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Clear output data
 	virgil_data_reset(decrypted_data);
@@ -139,5 +119,32 @@ int virgil_decrypt_with_key(data_t private_key, data_t data, const char * identi
 	return VIRGIL_OPERATION_OK;
 }
 
+/******************************************************************************/
+int virgil_decrypt_with_password(const char * password, data_t data, data_t * decrypted_data) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(decrypted_data);
+
+	// Send request and wait for response
+	CHECK(virgil_decrypt_with_password_submit(password, data, 0, &request));
+	return virgil_decrypt_result(request, decrypted_data);
+}
+
+/******************************************************************************/
+int virgil_decrypt_with_key(data_t private_key, data_t data, const char * identity, data_t * decrypted_data) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(decrypted_data);
+
+	// Send request and wait for response
+	CHECK(virgil_decrypt_with_key_submit(private_key, data, identity, 0, &request));
+	return virgil_decrypt_result(request, decrypted_data);
+}
+
+EXPORT_SYMBOL( virgil_decrypt_with_password_submit);
+EXPORT_SYMBOL( virgil_decrypt_with_key_submit);
+EXPORT_SYMBOL( virgil_decrypt_result);
 EXPORT_SYMBOL( virgil_decrypt_with_password);
 EXPORT_SYMBOL( virgil_decrypt_with_key);
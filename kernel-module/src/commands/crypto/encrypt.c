@@ -48,97 +48,178 @@
 #include <virgil/kernel/crypto.h>
 
 /******************************************************************************/
-static __u32 encrypt_with_password_request(const char * password, data_t data) {
+static int encrypt_with_password_submit(const char * password, const struct package_field_t * data_field,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[2];
-	__u32 res;
+
+	// Check input parameters
+	VALID_STR(password);
 
 	fields.count = 2;
 	fields.ar = fields_ar;
 
 	FILL_FIELD_STR(fields_ar[0], VIRGIL_FIELD_PASSWORD, password);
-	FILL_FIELD(fields_ar[1], VIRGIL_FIELD_DATA, data);
+	fields_ar[1] = *data_field;
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CRYPTO_ENCRYPT_PASS,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CRYPTO_ENCRYPT_PASS,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Encrypt with password can't be processed");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_encrypt_with_password(const char * password, data_t data, data_t * enc_data) {
-	__u32 id;
-	__s16 err_res;
+static int encrypt_with_pubkey_submit(__u32 recipients_count,
+		const data_t * public_keys, const char ** identities, const struct package_field_t * data_field,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
+	struct package_field_t fields_ar[VIRGIL_RECIPIENTS_COUNT_MAX * 2 + 1];
+	int i;
 
 	// Check input parameters
-	VALID_STR(password);
-	NOT_ZERO(enc_data);
+	NOT_ZERO(public_keys);
+	NOT_ZERO(identities);
+	if (!recipients_count || recipients_count > VIRGIL_RECIPIENTS_COUNT_MAX) return VIRGIL_OPERATION_ERROR;
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, encrypt_with_password_request(password, data));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	fields.count = recipients_count * 2 + 1;
+	fields.ar = fields_ar;
 
-	// Clear output data
-	virgil_data_reset(enc_data);
+	// Fill all data fields
+	for (i = 0; i < recipients_count; ++i) {
+		FILL_FIELD(fields.ar[i * 2], VIRGIL_FIELD_PUBLIC_KEY, public_keys[i]);
+		FILL_FIELD_STR(fields.ar[i * 2 + 1], VIRGIL_FIELD_IDENTITY, identities[i]);
+	}
 
-	// Parse response
-	CHECK_ERROR(fields, err_res);
-	CHECK(fields_dup_first(VIRGIL_FIELD_DATA, fields, enc_data));
+	fields.ar[recipients_count * 2] = *data_field;
+	// ~ Fill all data fields
 
-	fields_free(&fields);
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CRYPTO_ENCRYPT,
+			fields,
+			opts,
+			request,
+			"ERROR: Encrypt data with public keys can't be processed");
 
 	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-static __u32 encrypt_with_pub_key_request(__u32 recipients_count,
-		const data_t * pub_keys, const char ** identities, data_t data) {
+static int encrypt_with_cert_submit(__u32 recipients_count,
+		const data_t * certs, const struct package_field_t * data_field,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
-	struct package_field_t fields_ar[VIRGIL_RECIPIENTS_COUNT_MAX * 2 + 1];
-	__u32 res;
+	struct package_field_t fields_ar[VIRGIL_RECIPIENTS_COUNT_MAX + 1];
 	int i;
 
-	if (!recipients_count || recipients_count > 50) return VIRGIL_INVALID_ID;
+	// Check input parameters
+	NOT_ZERO(certs);
+	if (!recipients_count || recipients_count > VIRGIL_RECIPIENTS_COUNT_MAX) return VIRGIL_OPERATION_ERROR;
 
-	fields.count = recipients_count * 2 + 1;
+	fields.count = recipients_count + 1;
 	fields.ar = fields_ar;
 
 	// Fill all data fields
 	for (i = 0; i < recipients_count; ++i) {
-		FILL_FIELD(fields.ar[i * 2], VIRGIL_FIELD_PUBLIC_KEY, pub_keys[i]);
-		FILL_FIELD_STR(fields.ar[i * 2 + 1], VIRGIL_FIELD_IDENTITY, identities[i]);
+		FILL_FIELD(fields.ar[i], VIRGIL_FIELD_CERT, certs[i]);
 	}
 
-	FILL_FIELD(fields.ar[recipients_count * 2], VIRGIL_FIELD_DATA, data);
+	fields.ar[recipients_count] = *data_field;
 	// ~ Fill all data fields
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CRYPTO_ENCRYPT,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CRYPTO_ENCRYPT,
 			fields,
-			res,
-			"ERROR: Encrypt data with public keys can't be processed");
+			opts,
+			request,
+			"ERROR: Encrypt data with certificates can't be processed");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_encrypt_with_pubkey(__u32 recipients_count,
-        const data_t * public_keys, const char ** identities,
-        data_t data, data_t * enc_data) {
-	__u32 id;
+int virgil_encrypt_with_password_submit(const char * password, data_t data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	struct package_field_t data_field;
+
+	FILL_FIELD(data_field, VIRGIL_FIELD_DATA, data);
+
+	return encrypt_with_password_submit(password, &data_field, opts, request);
+}
+
+/******************************************************************************/
+int virgil_encrypt_with_pubkey_submit(__u32 recipients_count,
+		const data_t * public_keys, const char ** identities, data_t data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	struct package_field_t data_field;
+
+	FILL_FIELD(data_field, VIRGIL_FIELD_DATA, data);
+
+	return encrypt_with_pubkey_submit(recipients_count, public_keys, identities, &data_field, opts, request);
+}
+
+/******************************************************************************/
+int virgil_encrypt_with_cert_submit(__u32 recipients_count,
+		const data_t * certs, data_t data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	struct package_field_t data_field;
+
+	FILL_FIELD(data_field, VIRGIL_FIELD_DATA, data);
+
+	return encrypt_with_cert_submit(recipients_count, certs, &data_field, opts, request);
+}
+
+/******************************************************************************/
+int virgil_encrypt_with_password_sg_submit(const char * password, const data_sg_t * data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	struct package_field_t data_field;
+
+	// Check input parameters
+	CHECK(fields_data_sg_check(data));
+
+	FILL_FIELD_SG(data_field, VIRGIL_FIELD_DATA, data);
+
+	return encrypt_with_password_submit(password, &data_field, opts, request);
+}
+
+/******************************************************************************/
+int virgil_encrypt_with_pubkey_sg_submit(__u32 recipients_count,
+		const data_t * public_keys, const char ** identities, const data_sg_t * data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	struct package_field_t data_field;
+
+	// Check input parameters
+	CHECK(fields_data_sg_check(data));
+
+	FILL_FIELD_SG(data_field, VIRGIL_FIELD_DATA, data);
+
+	return encrypt_with_pubkey_submit(recipients_count, public_keys, identities, &data_field, opts, request);
+}
+
+/******************************************************************************/
+int virgil_encrypt_with_cert_sg_submit(__u32 recipients_count,
+		const data_t * certs, const data_sg_t * data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	struct package_field_t data_field;
+
+	// Check input parameters
+	CHECK(fields_data_sg_check(data));
+
+	FILL_FIELD_SG(data_field, VIRGIL_FIELD_DATA, data);
+
+	return encrypt_with_cert_submit(recipients_count, certs, &data_field, opts, request);
+}
+
+/******************************************************************************/
+int virgil_encrypt_result(virgil_request_t * request, data_t * enc_data) {
 	__s16 err_res;
 	fields_t fields;
 
 	// Check input parameters
-	NOT_ZERO(public_keys);
-	NOT_ZERO(identities);
-	NOT_ZERO(enc_data);
+	RESULT_NOT_ZERO(request, enc_data);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, encrypt_with_pub_key_request(recipients_count, public_keys, identities, data));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Clear output data
 	virgil_data_reset(enc_data);
@@ -153,60 +234,93 @@ int virgil_encrypt_with_pubkey(__u32 recipients_count,
 }
 
 /******************************************************************************/
-static __u32 encrypt_with_cert_request(__u32 recipients_count, const data_t * certs, data_t data) {
-	fields_t fields;
-	struct package_field_t fields_ar[VIRGIL_RECIPIENTS_COUNT_MAX + 1];
-	__u32 res;
-	int i;
-
-	if (!recipients_count || recipients_count > 50) return VIRGIL_INVALID_ID;
+int virgil_encrypt_with_password(const char * password, data_t data, data_t * enc_data) {
+	virgil_request_t * request;
 
-	fields.count = recipients_count + 1;
-	fields.ar = fields_ar;
+	// Check input parameters
+	NOT_ZERO(enc_data);
 
-	// Fill all data fields
-	for (i = 0; i < recipients_count; ++i) {
-		FILL_FIELD(fields.ar[i], VIRGIL_FIELD_CERT, certs[i]);
-	}
+	// Send request and wait for response
+	CHECK(virgil_encrypt_with_password_submit(password, data, 0, &request));
+	return virgil_encrypt_result(request, enc_data);
+}
 
-	FILL_FIELD(fields.ar[recipients_count], VIRGIL_FIELD_DATA, data);
-	// ~ Fill all data fields
+/******************************************************************************/
+int virgil_encrypt_with_pubkey(__u32 recipients_count,
+        const data_t * public_keys, const char ** identities,
+        data_t data, data_t * enc_data) {
+	virgil_request_t * request;
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CRYPTO_ENCRYPT,
-			fields,
-			res,
-			"ERROR: Encrypt data with certificates can't be processed");
+	// Check input parameters
+	NOT_ZERO(enc_data);
 
-	return res;
+	// Send request and wait for response
+	CHECK(virgil_encrypt_with_pubkey_submit(recipients_count, public_keys, identities, data, 0, &request));
+	return virgil_encrypt_result(request, enc_data);
 }
 
 /******************************************************************************/
 int virgil_encrypt_with_cert(__u32 recipients_count,
 		const data_t * certs, data_t data, data_t * enc_data) {
-	__u32 id;
-	__s16 err_res;
-	fields_t fields;
+	virgil_request_t * request;
 
 	// Check input parameters
-	NOT_ZERO(certs);
 	NOT_ZERO(enc_data);
 
 	// Send request and wait for response
-	REQUEST_CHECK(id, encrypt_with_cert_request(recipients_count, certs, data));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	CHECK(virgil_encrypt_with_cert_submit(recipients_count, certs, data, 0, &request));
+	return virgil_encrypt_result(request, enc_data);
+}
 
-	// Clear output data
-	virgil_data_reset(enc_data);
+/******************************************************************************/
+int virgil_encrypt_with_password_sg(const char * password, const data_sg_t * data, data_t * enc_data) {
+	virgil_request_t * request;
 
-	// Parse response
-	CHECK_ERROR(fields, err_res);
-	CHECK(fields_dup_first(VIRGIL_FIELD_DATA, fields, enc_data));
+	// Check input parameters
+	NOT_ZERO(enc_data);
 
-	fields_free(&fields);
+	// Send request and wait for response
+	CHECK(virgil_encrypt_with_password_sg_submit(password, data, 0, &request));
+	return virgil_encrypt_result(request, enc_data);
+}
 
-	return VIRGIL_OPERATION_OK;
+/******************************************************************************/
+int virgil_encrypt_with_pubkey_sg(__u32 recipients_count,
+		const data_t * public_keys, const char ** identities,
+		const data_sg_t * data, data_t * enc_data) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(enc_data);
+
+	// Send request and wait for response
+	CHECK(virgil_encrypt_with_pubkey_sg_submit(recipients_count, public_keys, identities, data, 0, &request));
+	return virgil_encrypt_result(request, enc_data);
+}
+
+/******************************************************************************/
+int virgil_encrypt_with_cert_sg(__u32 recipients_count,
+		const data_t * certs, const data_sg_t * data, data_t * enc_data) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(enc_data);
+
+	// Send request and wait for response
+	CHECK(virgil_encrypt_with_cert_sg_submit(recipients_count, certs, data, 0, &request));
+	return virgil_encrypt_result(request, enc_data);
 }
 
+EXPORT_SYMBOL( virgil_encrypt_with_password_submit);
+EXPORT_SYMBOL( virgil_encrypt_with_pubkey_submit);
+EXPORT_SYMBOL( virgil_encrypt_with_cert_submit);
+EXPORT_SYMBOL( virgil_encrypt_result);
 EXPORT_SYMBOL( virgil_encrypt_with_password);
 EXPORT_SYMBOL( virgil_encrypt_with_pubkey);
 EXPORT_SYMBOL( virgil_encrypt_with_cert);
+EXPORT_SYMBOL( virgil_encrypt_with_password_sg_submit);
+EXPORT_SYMBOL( virgil_encrypt_with_pubkey_sg_submit);
+EXPORT_SYMBOL( virgil_encrypt_with_cert_sg_submit);
+EXPORT_SYMBOL( virgil_encrypt_with_password_sg);
+EXPORT_SYMBOL( virgil_encrypt_with_pubkey_sg);
+EXPORT_SYMBOL( virgil_encrypt_with_cert_sg);
@@ -43,39 +43,80 @@
 
 #include <virgil/kernel/private/usermode-communicator.h>
 #include <virgil/kernel/private/data-waiter.h>
+#include <virgil/kernel/private/local-crypto.h>
+
+#include <virgil/kernel/crypto.h>
 
 /******************************************************************************/
-static __u32 hash_request(__u8 hash_type, data_t data) {
+static int hash_submit(__u8 hash_type, const struct package_field_t * data_field,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[2];
-	__u32 res;
+	__u8 digest[VIRGIL_LOCAL_DIGEST_MAX];
+	__u32 digest_sz;
+	int res;
+
+	// Hash is created in kernel if algorithm is available, service is used otherwise
+	res = local_hash(hash_type, data_field, digest, &digest_sz);
+	if (VIRGIL_OPERATION_UNAVAILABLE != res) {
+		CHECK(res);
+
+		fields.count = 1;
+		fields.ar = fields_ar;
+
+		FILL_FIELD_AR(fields_ar[0], VIRGIL_FIELD_DATA, digest, digest_sz);
+
+		return data_waiter_submit_done(VIRGIL_CMD_CRYPTO_HASH, fields, opts, request);
+	}
 
 	fields.count = 2;
 	fields.ar = fields_ar;
 
 	FILL_FIELD_AR(fields_ar[0], VIRGIL_FIELD_HASH_FUNC, &hash_type, 1);
-	FILL_FIELD(fields_ar[1], VIRGIL_FIELD_DATA, data);
+	fields_ar[1] = *data_field;
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CRYPTO_HASH,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CRYPTO_HASH,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Hash creation can't be processed");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_hash(__u8 hash_type, data_t data, data_t * hash_data) {
-	__u32 id;
+int virgil_hash_submit(__u8 hash_type, data_t data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	struct package_field_t data_field;
+
+	FILL_FIELD(data_field, VIRGIL_FIELD_DATA, data);
+
+	return hash_submit(hash_type, &data_field, opts, request);
+}
+
+/******************************************************************************/
+int virgil_hash_sg_submit(__u8 hash_type, const data_sg_t * data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	struct package_field_t data_field;
+
+	// Check input parameters
+	CHECK(fields_data_sg_check(data));
+
+	FILL_FIELD_SG(data_field, VIRGIL_FIELD_DATA, data);
+
+	return hash_submit(hash_type, &data_field, opts, request);
+}
+
+/******************************************************************************/
+int virgil_hash_result(virgil_request_t * request, data_t * hash_data) {
 	__s16 err_res;
 	fields_t fields;
 
 	// Check input parameters
-	NOT_ZERO(hash_data);
+	RESULT_NOT_ZERO(request, hash_data);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, hash_request(hash_type, data));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Clear output data
 	virgil_data_reset(hash_data);
@@ -89,4 +130,32 @@ int virgil_hash(__u8 hash_type, data_t data, data_t * hash_data) {
 	return VIRGIL_OPERATION_OK;
 }
 
+/******************************************************************************/
+int virgil_hash(__u8 hash_type, data_t data, data_t * hash_data) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(hash_data);
+
+	// Send request and wait for response
+	CHECK(virgil_hash_submit(hash_type, data, 0, &request));
+	return virgil_hash_result(request, hash_data);
+}
+
+/******************************************************************************/
+int virgil_hash_sg(__u8 hash_type, const data_sg_t * data, data_t * hash_data) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(hash_data);
+
+	// Send request and wait for response
+	CHECK(virgil_hash_sg_submit(hash_type, data, 0, &request));
+	return virgil_hash_result(request, hash_data);
+}
+
+EXPORT_SYMBOL( virgil_hash_submit);
+EXPORT_SYMBOL( virgil_hash_sg_submit);
+EXPORT_SYMBOL( virgil_hash_result);
 EXPORT_SYMBOL( virgil_hash);
+EXPORT_SYMBOL( virgil_hash_sg);
@@ -48,10 +48,10 @@
 #include <virgil/kernel/crypto.h>
 
 /******************************************************************************/
-static __u32 create_keypair_request(int ec_type) {
+int virgil_create_keypair_submit(int ec_type,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[1];
-	__u32 res;
 	const __u8 _ec_type = ec_type;
 
 	fields.count = 1;
@@ -59,28 +59,27 @@ static __u32 create_keypair_request(int ec_type) {
 
 	FILL_FIELD_AR(fields_ar[0], VIRGIL_FIELD_CURVE_TYPE, &_ec_type, sizeof(_ec_type));
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CRYPTO_KEYGEN,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CRYPTO_KEYGEN,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Keypair creation can't be processed");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_create_keypair(int ec_type, data_t * private_key, data_t * public_key) {
-	__u32 id;
+int virgil_create_keypair_result(virgil_request_t * request,
+		data_t * private_key, data_t * public_key) {
 	fields_t fields;
 	__s16 err_res;
-	int res = 0;
 
 	// Check input parameters
-	NOT_ZERO(private_key);
-	NOT_ZERO(public_key);
+	RESULT_NOT_ZERO(request, private_key);
+	RESULT_NOT_ZERO(request, public_key);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, create_keypair_request(ec_type));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Parse response
 	CHECK_ERROR(fields, err_res);
@@ -89,7 +88,22 @@ int virgil_create_keypair(int ec_type, data_t * private_key, data_t * public_key
 
 	fields_free(&fields);
 
-	return res;
+	return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+int virgil_create_keypair(int ec_type, data_t * private_key, data_t * public_key) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(private_key);
+	NOT_ZERO(public_key);
+
+	// Send request and wait for response
+	CHECK(virgil_create_keypair_submit(ec_type, 0, &request));
+	return virgil_create_keypair_result(request, private_key, public_key);
 }
 
+EXPORT_SYMBOL( virgil_create_keypair_submit);
+EXPORT_SYMBOL( virgil_create_keypair_result);
 EXPORT_SYMBOL( virgil_create_keypair);
@@ -40,6 +40,7 @@
  */
 
 #include <linux/module.h>
+#include <linux/slab.h>
 
 #include <virgil/kernel/private/usermode-communicator.h>
 #include <virgil/kernel/private/data-waiter.h>
@@ -47,37 +48,59 @@
 #include <virgil/kernel/crypto.h>
 
 /******************************************************************************/
-static __u32 sign_request(data_t private_key, data_t data) {
+static int sign_submit(data_t private_key, const struct package_field_t * data_field,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[2];
-	__u32 res;
 
 	fields.count = 2;
 	fields.ar = fields_ar;
 
 	FILL_FIELD(fields_ar[0], VIRGIL_FIELD_PRIVATE_KEY, private_key);
-	FILL_FIELD(fields_ar[1], VIRGIL_FIELD_DATA, data);
+	fields_ar[1] = *data_field;
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CRYPTO_SIGN,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CRYPTO_SIGN,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Data sign can't be processed");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_sign(data_t private_key, data_t data, data_t * signature) {
-	__u32 id;
+int virgil_sign_submit(data_t private_key, data_t data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	struct package_field_t data_field;
+
+	FILL_FIELD(data_field, VIRGIL_FIELD_DATA, data);
+
+	return sign_submit(private_key, &data_field, opts, request);
+}
+
+/******************************************************************************/
+int virgil_sign_sg_submit(data_t private_key, const data_sg_t * data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	struct package_field_t data_field;
+
+	// Check input parameters
+	CHECK(fields_data_sg_check(data));
+
+	FILL_FIELD_SG(data_field, VIRGIL_FIELD_DATA, data);
+
+	return sign_submit(private_key, &data_field, opts, request);
+}
+
+/******************************************************************************/
+int virgil_sign_result(virgil_request_t * request, data_t * signature) {
 	__s16 err_res;
 	fields_t fields;
 
 	// Check input parameters
-	NOT_ZERO(signature);
+	RESULT_NOT_ZERO(request, signature);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, sign_request(private_key, data));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Clear output data
 	virgil_data_reset(signature);
@@ -91,4 +114,128 @@ int virgil_sign(data_t private_key, data_t data, data_t * signature) {
 	return VIRGIL_OPERATION_OK;
 }
 
+/******************************************************************************/
+int virgil_sign(data_t private_key, data_t data, data_t * signature) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(signature);
+
+	// Send request and wait for response
+	CHECK(virgil_sign_submit(private_key, data, 0, &request));
+	return virgil_sign_result(request, signature);
+}
+
+/******************************************************************************/
+int virgil_sign_sg(data_t private_key, const data_sg_t * data, data_t * signature) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(signature);
+
+	// Send request and wait for response
+	CHECK(virgil_sign_sg_submit(private_key, data, 0, &request));
+	return virgil_sign_result(request, signature);
+}
+
+/******************************************************************************/
+int virgil_sign_batch_submit(data_t private_key, __u32 count, const data_t * data,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	fields_t fields;
+	struct package_field_t * fields_ar;
+	__u32 i;
+	int res;
+
+	// Check input parameters
+	NOT_ZERO(data);
+	if (!count || count > VIRGIL_BATCH_COUNT_MAX) return VIRGIL_OPERATION_ERROR;
+
+	// Private key is followed by all data items
+	fields_ar = kmalloc_array(count + 1, sizeof(*fields_ar), opts && opts->gfp ? opts->gfp : GFP_KERNEL);
+	if (!fields_ar) return VIRGIL_OPERATION_ERROR;
+
+	fields.count = count + 1;
+	fields.ar = fields_ar;
+
+	FILL_FIELD(fields_ar[0], VIRGIL_FIELD_PRIVATE_KEY, private_key);
+	for (i = 0; i < count; ++i) {
+		FILL_FIELD(fields_ar[i + 1], VIRGIL_FIELD_DATA, data[i]);
+	}
+
+	res = data_waiter_submit(VIRGIL_CMD_CRYPTO_SIGN_BATCH, fields, opts, request);
+	if (VIRGIL_OPERATION_OK != res) {
+		LOG("ERROR: Batch data sign can't be processed");
+	}
+
+	kfree(fields_ar);
+
+	return res;
+}
+
+/******************************************************************************/
+int virgil_sign_batch_result(virgil_request_t * request, __u32 count, data_t * signatures) {
+	__s16 err_res;
+	fields_t fields;
+	__u32 i, signatures_cnt = 0;
+	int res = VIRGIL_OPERATION_OK;
+
+	// Check input parameters
+	RESULT_NOT_ZERO(request, signatures);
+	if (!count || count > VIRGIL_BATCH_COUNT_MAX) {
+		virgil_request_free(request);
+		return VIRGIL_OPERATION_ERROR;
+	}
+
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+
+	// Clear output data
+	for (i = 0; i < count; ++i) {
+		virgil_data_reset(&signatures[i]);
+	}
+
+	// Parse response, signatures are in order of data items
+	CHECK_ERROR(fields, err_res);
+	for (i = 0; i < fields.count && VIRGIL_OPERATION_OK == res; ++i) {
+		if (VIRGIL_FIELD_SIGNATURE != fields.ar[i].type) continue;
+
+		if (signatures_cnt >= count) {
+			res = VIRGIL_OPERATION_ERROR;
+			break;
+		}
+
+		res = virgil_data_dup_ar(&signatures[signatures_cnt++], fields.ar[i].data_sz, fields.ar[i].data.p);
+	}
+
+	fields_free(&fields);
+
+	if (VIRGIL_OPERATION_OK != res || signatures_cnt != count) {
+		for (i = 0; i < count; ++i) {
+			virgil_data_free(&signatures[i]);
+		}
+		return VIRGIL_OPERATION_ERROR;
+	}
+
+	return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+int virgil_sign_batch(data_t private_key, __u32 count, const data_t * data, data_t * signatures) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(signatures);
+
+	// Send request and wait for response
+	CHECK(virgil_sign_batch_submit(private_key, count, data, 0, &request));
+	return virgil_sign_batch_result(request, count, signatures);
+}
+
+EXPORT_SYMBOL( virgil_sign_submit);
+EXPORT_SYMBOL( virgil_sign_sg_submit);
+EXPORT_SYMBOL( virgil_sign_result);
 EXPORT_SYMBOL( virgil_sign);
+EXPORT_SYMBOL( virgil_sign_sg);
+EXPORT_SYMBOL( virgil_sign_batch_submit);
+EXPORT_SYMBOL( virgil_sign_batch_result);
+EXPORT_SYMBOL( virgil_sign_batch);
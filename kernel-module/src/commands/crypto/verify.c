@@ -40,6 +40,8 @@
  */
 
 #include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/bitmap.h>
 
 #include <virgil/kernel/private/usermode-communicator.h>
 #include <virgil/kernel/private/data-waiter.h>
@@ -47,43 +49,87 @@
 #include <virgil/kernel/crypto.h>
 
 /******************************************************************************/
-static __u32 verify_request(bool use_pubkey, data_t cert_or_pubkey, data_t data, data_t signature) {
+static int verify_submit(bool use_pubkey, data_t cert_or_pubkey,
+		const struct package_field_t * data_field, data_t signature,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[3];
-	__u32 res;
 
 	fields.count = 3;
 	fields.ar = fields_ar;
 
 	FILL_FIELD(fields_ar[0], use_pubkey ? VIRGIL_FIELD_PUBLIC_KEY : VIRGIL_FIELD_CERT, cert_or_pubkey);
-	FILL_FIELD(fields_ar[1], VIRGIL_FIELD_DATA, data);
+	fields_ar[1] = *data_field;
 	FILL_FIELD(fields_ar[2], VIRGIL_FIELD_SIGNATURE, signature);
 
-	SEND_WITH_CHECK(VIRGIL_CMD_CRYPTO_VERIFY,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_CRYPTO_VERIFY,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Signature verification can't be processed");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+int virgil_verify_with_pubkey_submit(data_t public_key, data_t data, data_t signature,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	const bool use_pubkey = true;
+	struct package_field_t data_field;
+
+	FILL_FIELD(data_field, VIRGIL_FIELD_DATA, data);
+	return verify_submit(use_pubkey, public_key, &data_field, signature, opts, request);
+}
+
+/******************************************************************************/
+int virgil_verify_with_cert_submit(data_t cert, data_t data, data_t signature,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	const bool use_pubkey = false;
+	struct package_field_t data_field;
+
+	FILL_FIELD(data_field, VIRGIL_FIELD_DATA, data);
+	return verify_submit(use_pubkey, cert, &data_field, signature, opts, request);
+}
+
+/******************************************************************************/
+int virgil_verify_with_pubkey_sg_submit(data_t public_key, const data_sg_t * data, data_t signature,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	const bool use_pubkey = true;
+	struct package_field_t data_field;
+
+	CHECK(fields_data_sg_check(data));
+
+	FILL_FIELD_SG(data_field, VIRGIL_FIELD_DATA, data);
+	return verify_submit(use_pubkey, public_key, &data_field, signature, opts, request);
+}
+
+/******************************************************************************/
+int virgil_verify_with_cert_sg_submit(data_t cert, const data_sg_t * data, data_t signature,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	const bool use_pubkey = false;
+	struct package_field_t data_field;
+
+	CHECK(fields_data_sg_check(data));
+
+	FILL_FIELD_SG(data_field, VIRGIL_FIELD_DATA, data);
+	return verify_submit(use_pubkey, cert, &data_field, signature, opts, request);
 }
 
 /******************************************************************************/
-static int verify(bool use_pubkey, data_t cert_or_pubkey, data_t data, data_t signature, bool * is_verified) {
-	__u32 id;
+int virgil_verify_result(virgil_request_t * request, bool * is_verified) {
 	fields_t fields;
 	int res;
 	__s16 res_field;
 
 	// Check input parameters
-	NOT_ZERO(is_verified);
+	RESULT_NOT_ZERO(request, is_verified);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, verify_request(use_pubkey, cert_or_pubkey, data, signature));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	res = fields_result(fields, &res_field);
 
-	*is_verified = VIRGIL_OPERATION_OK == res_field;
+	*is_verified = VIRGIL_OPERATION_OK == res && VIRGIL_OPERATION_OK == res_field;
 
 	fields_free(&fields);
 
@@ -92,15 +138,150 @@ static int verify(bool use_pubkey, data_t cert_or_pubkey, data_t data, data_t si
 
 /******************************************************************************/
 int virgil_verify_with_pubkey(data_t public_key, data_t data, data_t signature, bool * is_verified) {
-	const bool use_pubkey = true;
-	return verify(use_pubkey, public_key, data, signature, is_verified);
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(is_verified);
+
+	// Send request and wait for response
+	CHECK(virgil_verify_with_pubkey_submit(public_key, data, signature, 0, &request));
+	return virgil_verify_result(request, is_verified);
 }
 
 /******************************************************************************/
 int virgil_verify_with_cert(data_t cert, data_t data, data_t signature, bool * is_verified) {
-	const bool use_pubkey = false;
-	return verify(use_pubkey, cert, data, signature, is_verified);
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(is_verified);
+
+	// Send request and wait for response
+	CHECK(virgil_verify_with_cert_submit(cert, data, signature, 0, &request));
+	return virgil_verify_result(request, is_verified);
+}
+
+/******************************************************************************/
+int virgil_verify_with_pubkey_sg(data_t public_key, const data_sg_t * data, data_t signature, bool * is_verified) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(is_verified);
+
+	// Send request and wait for response
+	CHECK(virgil_verify_with_pubkey_sg_submit(public_key, data, signature, 0, &request));
+	return virgil_verify_result(request, is_verified);
+}
+
+/******************************************************************************/
+int virgil_verify_with_cert_sg(data_t cert, const data_sg_t * data, data_t signature, bool * is_verified) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(is_verified);
+
+	// Send request and wait for response
+	CHECK(virgil_verify_with_cert_sg_submit(cert, data, signature, 0, &request));
+	return virgil_verify_result(request, is_verified);
+}
+
+/******************************************************************************/
+int virgil_verify_batch_submit(__u32 count, const virgil_verify_item_t * items,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
+	fields_t fields;
+	struct package_field_t * fields_ar;
+	__u32 i;
+	int res;
+
+	// Check input parameters
+	NOT_ZERO(items);
+	if (!count || count > VIRGIL_BATCH_COUNT_MAX) return VIRGIL_OPERATION_ERROR;
+
+	// Each item is key (public key or certificate), data and signature
+	fields_ar = kmalloc_array(count * 3, sizeof(*fields_ar), opts && opts->gfp ? opts->gfp : GFP_KERNEL);
+	if (!fields_ar) return VIRGIL_OPERATION_ERROR;
+
+	fields.count = count * 3;
+	fields.ar = fields_ar;
+
+	for (i = 0; i < count; ++i) {
+		FILL_FIELD(fields_ar[i * 3], items[i].is_cert ? VIRGIL_FIELD_CERT : VIRGIL_FIELD_PUBLIC_KEY, items[i].key);
+		FILL_FIELD(fields_ar[i * 3 + 1], VIRGIL_FIELD_DATA, items[i].data);
+		FILL_FIELD(fields_ar[i * 3 + 2], VIRGIL_FIELD_SIGNATURE, items[i].signature);
+	}
+
+	res = data_waiter_submit(VIRGIL_CMD_CRYPTO_VERIFY_BATCH, fields, opts, request);
+	if (VIRGIL_OPERATION_OK != res) {
+		LOG("ERROR: Batch signature verification can't be processed");
+	}
+
+	kfree(fields_ar);
+
+	return res;
+}
+
+/******************************************************************************/
+int virgil_verify_batch_result(virgil_request_t * request, __u32 count, unsigned long * verified) {
+	fields_t fields;
+	data_t bitmap;
+	__s16 err_res;
+	__u32 i;
+	int res;
+
+	// Check input parameters
+	RESULT_NOT_ZERO(request, verified);
+	if (!count || count > VIRGIL_BATCH_COUNT_MAX) {
+		virgil_request_free(request);
+		return VIRGIL_OPERATION_ERROR;
+	}
+
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+
+	bitmap_zero(verified, count);
+
+	// Parse response
+	CHECK_ERROR(fields, err_res);
+	res = fields_dup_first(VIRGIL_FIELD_DATA, fields, &bitmap);
+	fields_free(&fields);
+	CHECK(res);
+
+	if (bitmap.sz != DIV_ROUND_UP(count, 8)) {
+		virgil_data_free(&bitmap);
+		return VIRGIL_OPERATION_ERROR;
+	}
+
+	for (i = 0; i < count; ++i) {
+		if (((__u8 *)bitmap.data)[i / 8] & (1 << (i % 8))) {
+			__set_bit(i, verified);
+		}
+	}
+
+	virgil_data_free(&bitmap);
+
+	return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+int virgil_verify_batch(__u32 count, const virgil_verify_item_t * items, unsigned long * verified) {
+	virgil_request_t * request;
+
+	// Check input parameters
+	NOT_ZERO(verified);
+
+	// Send request and wait for response
+	CHECK(virgil_verify_batch_submit(count, items, 0, &request));
+	return virgil_verify_batch_result(request, count, verified);
 }
 
+EXPORT_SYMBOL( virgil_verify_with_pubkey_submit);
+EXPORT_SYMBOL( virgil_verify_with_cert_submit);
+EXPORT_SYMBOL( virgil_verify_with_pubkey_sg_submit);
+EXPORT_SYMBOL( virgil_verify_with_cert_sg_submit);
+EXPORT_SYMBOL( virgil_verify_result);
 EXPORT_SYMBOL( virgil_verify_with_pubkey);
 EXPORT_SYMBOL( virgil_verify_with_cert);
+EXPORT_SYMBOL( virgil_verify_with_pubkey_sg);
+EXPORT_SYMBOL( virgil_verify_with_cert_sg);
+EXPORT_SYMBOL( virgil_verify_batch_submit);
+EXPORT_SYMBOL( virgil_verify_batch_result);
+EXPORT_SYMBOL( virgil_verify_batch);
@@ -45,6 +45,9 @@
 #include <virgil/kernel/private/usermode-communicator.h>
 #include <virgil/kernel/private/data-waiter.h>
 #include <virgil/kernel/private/fields.h>
+#include <virgil/kernel/private/cert-cache.h>
+#include <virgil/kernel/private/cert-table.h>
+#include <virgil/kernel/private/local-crypto.h>
 #include <virgil/kernel/foundation/key-value.h>
 
 #include <virgil/kernel/crypto.h>
@@ -56,6 +59,9 @@ const char * KEY_SUFFIX_PUB = "PUBL_";
 const char * KEY_SUFFIX_CERT = "CERT_";
 const char * KEY_SUFFIX_SYM = "SYMM_";
 
+extern const char * KEY_IDENTITY;
+extern const char * KEY_PUBLIC_KEY;
+
 #define ID_SIZE (sizeof(cmh_t) * 2 + 1)
 #define KEY_PREFIX_SIZE 5
 
@@ -103,6 +109,59 @@ static void id_composition(cmh_t cmh, const char * prefix,
 	cmh2str(cmh, &str[KEY_PREFIX_SIZE]);
 }
 
+/******************************************************************************/
+/* Root certificate is loaded from storage once and is kept in kernel */
+static int load_root_cert(data_t * root_cert) {
+	__u32 generation;
+
+	if (VIRGIL_OPERATION_OK == cert_cache_root_get(root_cert)) {
+		return VIRGIL_OPERATION_OK;
+	}
+
+	generation = cert_cache_root_generation();
+	CHECK(virgil_ieee1609_load_key(ROOT_CERTIFICATE_CMH, KEY_TYPE_CERTIFICATE, root_cert));
+	cert_cache_root_set(*root_cert, generation);
+
+	return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+/* HashedId8 is low-order 8 bytes of SHA-256, service is used if SHA-256 isn't available in kernel */
+static int hashed_id8_create(data_t data, __u8 hashed_id8[HASHED_ID8_SIZE]) {
+	struct package_field_t field;
+	__u8 digest[VIRGIL_LOCAL_DIGEST_MAX];
+	__u32 digest_sz = 0;
+	data_t hash;
+	int res;
+
+	if (!data.data) {
+		return VIRGIL_OPERATION_ERROR;
+	}
+
+	FILL_FIELD(field, VIRGIL_FIELD_DATA, data);
+
+	res = local_hash(HASH_SHA256, &field, digest, &digest_sz);
+	if (VIRGIL_OPERATION_UNAVAILABLE == res) {
+		CHECK(virgil_hash(HASH_SHA256, data, &hash));
+		if (hash.sz >= HASHED_ID8_SIZE && hash.sz <= VIRGIL_LOCAL_DIGEST_MAX) {
+			memcpy(digest, hash.data, hash.sz);
+			digest_sz = hash.sz;
+			res = VIRGIL_OPERATION_OK;
+		} else {
+			res = VIRGIL_OPERATION_ERROR;
+		}
+		virgil_data_free(&hash);
+	}
+
+	if (VIRGIL_OPERATION_OK != res || digest_sz < HASHED_ID8_SIZE) {
+		return VIRGIL_OPERATION_ERROR;
+	}
+
+	memcpy(hashed_id8, &digest[digest_sz - HASHED_ID8_SIZE], HASHED_ID8_SIZE);
+
+	return VIRGIL_OPERATION_OK;
+}
+
 /******************************************************************************/
 int virgil_ieee1609_create_material(cmh_t cmh, int algorithm, kv_container_t addition_data,
 		data_t * private_key, data_t * certificate) {
@@ -132,7 +191,7 @@ int virgil_ieee1609_verify_cert(data_t certificate, bool * is_ok) {
 
 	virgil_data_reset(&root_cert);
 
-	CHECK(virgil_ieee1609_load_key(ROOT_CERTIFICATE_CMH, KEY_TYPE_CERTIFICATE, &root_cert));
+	CHECK(load_root_cert(&root_cert));
 
 	res = virgil_certificate_verify(certificate, root_cert, is_ok);
 
@@ -152,31 +211,58 @@ int virgil_ieee1609_revoke_cert(cmh_t cmh, data_t private_key, bool * is_ok) {
 /******************************************************************************/
 int virgil_ieee1609_add_cert(data_t certificate, bool is_root) {
 	char str_id[VIRGIL_KEYSTORAGE_ID_MAX_SIZE - KEY_PREFIX_SIZE];
-	char * identity = 0;
+	__u8 hashed_id8[HASHED_ID8_SIZE];
+	kv_container_t cert_data;
+	data_t identity;
 	int res, identity_len, copy_sz;
 
 	memset(str_id, 0, VIRGIL_KEYSTORAGE_ID_MAX_SIZE - KEY_PREFIX_SIZE);
 	memcpy(str_id, KEY_SUFFIX_CERT, KEY_PREFIX_SIZE);
+	virgil_kv_reset(&cert_data);
+
+	// Identity and public key are taken from the same parse of certificate
+	CHECK(hashed_id8_create(certificate, hashed_id8));
+	CHECK(virgil_certificate_parse(certificate, &cert_data));
+
 	if (is_root) {
 		cmh2str(ROOT_CERTIFICATE_CMH, str_id);
 	} else {
-		res = virgil_certificate_get_identity(certificate, &identity);
-		if (VIRGIL_OPERATION_OK != res || !identity) {
-			return res;
+		identity = virgil_kv_value(&cert_data, KEY_IDENTITY);
+		if (!identity.data || !identity.sz) {
+			virgil_kv_free(&cert_data);
+			return VIRGIL_OPERATION_ERROR;
 		}
-		identity_len = strlen(identity);
-		copy_sz = (identity_len >= (VIRGIL_KEYSTORAGE_ID_MAX_SIZE - KEY_PREFIX_SIZE)) ? (VIRGIL_KEYSTORAGE_ID_MAX_SIZE - 1) : identity_len;
-		memcpy(&str_id[KEY_PREFIX_SIZE], identity, copy_sz);
+		identity_len = strnlen(identity.data, identity.sz);
+		copy_sz = min_t(int, identity_len, sizeof(str_id) - KEY_PREFIX_SIZE - 1);
+		memcpy(&str_id[KEY_PREFIX_SIZE], identity.data, copy_sz);
+	}
+
+	// Pinned root certificate is dropped before and after save, so old one isn't pinned again
+	if (is_root) {
+		cert_cache_root_reset();
 	}
 
 	res = virgil_save_key(str_id, certificate, is_root ? VIRGIL_KEY_PERMANENT : VIRGIL_KEY_TEMPORARY);
 
+	if (is_root) {
+		cert_cache_root_reset();
+	}
+
+	// Signer of received data is resolved by HashedId8 in kernel. Table is best effort: certificate is stored already.
+	if (VIRGIL_OPERATION_OK == res
+			&& VIRGIL_OPERATION_OK != cert_table_add(hashed_id8, certificate, virgil_kv_value(&cert_data, KEY_PUBLIC_KEY))) {
+		LOG("ERROR: Certificate is saved, but it can't be resolved by HashedId8");
+	}
+
+	virgil_kv_free(&cert_data);
+
 	return res;
 }
 
 /******************************************************************************/
 int virgil_ieee1609_delete_cert(data_t certificate) {
 	char str_id[VIRGIL_KEYSTORAGE_ID_MAX_SIZE - KEY_PREFIX_SIZE];
+	__u8 hashed_id8[HASHED_ID8_SIZE];
 	char * identity = 0;
 	int res, identity_len, copy_sz;
 
@@ -187,11 +273,17 @@ int virgil_ieee1609_delete_cert(data_t certificate) {
 		return res;
 	}
 	identity_len = strlen(identity);
-	copy_sz = (identity_len >= (VIRGIL_KEYSTORAGE_ID_MAX_SIZE - KEY_PREFIX_SIZE)) ? (VIRGIL_KEYSTORAGE_ID_MAX_SIZE - 1) : identity_len;
+	copy_sz = min_t(int, identity_len, sizeof(str_id) - KEY_PREFIX_SIZE - 1);
 	memcpy(&str_id[KEY_PREFIX_SIZE], identity, copy_sz);
+	kfree(identity);
 
 	res = virgil_revoke_key(str_id);
 
+	// Certificate stays resolvable by HashedId8 while it's stored
+	if (VIRGIL_OPERATION_OK == res && VIRGIL_OPERATION_OK == hashed_id8_create(certificate, hashed_id8)) {
+		cert_table_remove(hashed_id8);
+	}
+
 	return res;
 }
 
@@ -255,7 +347,7 @@ int virgil_ieee1609_parse_cert(data_t certificate, kv_container_t * kv_data,
 
 	CHECK(virgil_ieee1609_get_crl_info(last_crl_time, next_crl_time));
 	CHECK(virgil_certificate_parse(certificate, kv_data));
-	CHECK(virgil_ieee1609_load_key(ROOT_CERTIFICATE_CMH, KEY_TYPE_CERTIFICATE, &root_cert));
+	CHECK(load_root_cert(&root_cert));
 
 	*is_root_cert = 0 == memcmp(certificate.data, root_cert.data, certificate.sz);
 
@@ -351,10 +443,44 @@ int virgil_ieee1609_cmh_sign(cmh_t cmh, data_t data, data_t * signature) {
 	return res;
 }
 
+/******************************************************************************/
+int virgil_ieee1609_cmh_sign_batch(cmh_t cmh, __u32 count, const data_t * data, data_t * signatures) {
+	data_t private_key;
+	int res;
+
+	virgil_data_reset(&private_key);
+
+	CHECK(virgil_ieee1609_load_key(cmh, KEY_TYPE_PRIVATE, &private_key));
+
+	res = virgil_sign_batch(private_key, count, data, signatures);
+
+	virgil_data_free(&private_key);
+
+	return res;
+}
+
 /******************************************************************************/
 int virgil_ieee1609_hashed_id8(data_t data, data_t * hashed_id8) {
+	__u8 id[HASHED_ID8_SIZE];
+
+	if (!hashed_id8) {
+		return VIRGIL_OPERATION_ERROR;
+	}
+
 	virgil_data_reset(hashed_id8);
-	return VIRGIL_OPERATION_OK;
+
+	CHECK(hashed_id8_create(data, id));
+
+	return virgil_data_dup_ar(hashed_id8, HASHED_ID8_SIZE, id);
+}
+
+/******************************************************************************/
+int virgil_ieee1609_cert_by_hashed_id8(data_t hashed_id8, data_t * certificate, data_t * public_key) {
+	if (!hashed_id8.data || HASHED_ID8_SIZE != hashed_id8.sz) {
+		return VIRGIL_OPERATION_ERROR;
+	}
+
+	return cert_table_find(hashed_id8.data, certificate, public_key);
 }
 
 /******************************************************************************/
@@ -378,7 +504,9 @@ EXPORT_SYMBOL( virgil_ieee1609_cmh_store_cert);
 EXPORT_SYMBOL( virgil_ieee1609_cmh_store_cert_and_key);
 EXPORT_SYMBOL( virgil_ieee1609_cmh_delete);
 EXPORT_SYMBOL( virgil_ieee1609_cmh_sign);
+EXPORT_SYMBOL( virgil_ieee1609_cmh_sign_batch);
 EXPORT_SYMBOL( virgil_ieee1609_hashed_id8);
+EXPORT_SYMBOL( virgil_ieee1609_cert_by_hashed_id8);
 EXPORT_SYMBOL( virgil_ieee1609_transform_private_key);
 EXPORT_SYMBOL( virgil_ieee1609_parse_cert);
 EXPORT_SYMBOL( virgil_ieee1609_verify_cert);
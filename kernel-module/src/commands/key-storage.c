@@ -38,7 +38,8 @@
  * @file key-storage.c
  * @brief API to key storage and caching functions.
  * Save, load and revoke keys. Can be used encryption for any key.
- * Synchronous calls.
+ * Synchronous calls and asynchronous submit/result pairs.
+ * Permanent keys loaded without password are cached in kernel (key-cache.h).
  */
 
 #include <linux/module.h>
@@ -47,14 +48,29 @@
 #include <virgil/kernel/private/fields.h>
 #include <virgil/kernel/private/data-waiter.h>
 #include <virgil/kernel/private/usermode-communicator.h>
+#include <virgil/kernel/private/key-cache.h>
 #include <virgil/kernel/key-storage.h>
 
 /******************************************************************************/
-static __u32 save_encrypted_key_request(const char * key_id,
-		data_t key, __u16 key_type, const char * key_password) {
+int virgil_save_encrypted_key_submit(const char * key_id,
+		data_t key, __u16 key_type, const char * key_password,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[4];
-	__u32 res;
+	int res;
+
+	// Check input parameters
+	VALID_STR(key_id);
+
+	if (strnlen(key_id, VIRGIL_KEYSTORAGE_ID_MAX_SIZE * 2) >= VIRGIL_KEYSTORAGE_ID_MAX_SIZE) {
+		LOG("Save key error: identifier too big. Maximum size is %d bytes", VIRGIL_KEYSTORAGE_ID_MAX_SIZE);
+		return VIRGIL_OPERATION_ERROR;
+	}
+
+	if (key.sz > VIRGIL_KEYSTORAGE_PERMANENT_KEY_MAX_SIZE) {
+		LOG("Save key error: data for save too big. Maximum size is %d bytes", VIRGIL_KEYSTORAGE_PERMANENT_KEY_MAX_SIZE);
+		return VIRGIL_OPERATION_ERROR;
+	}
 
 	fields.count = 3;
 	fields.ar = fields_ar;
@@ -68,37 +84,25 @@ static __u32 save_encrypted_key_request(const char * key_id,
 		fields.count ++;
 	}
 
-	SEND_WITH_CHECK(VIRGIL_CMD_STORAGE_STORE,
-			fields,
-			res,
-			"ERROR: Save key with encryption can't be processed");
+	// Cached key is removed, loads which are in progress aren't cached until save request is freed
+	key_cache_write_begin(key_id);
 
-	return res;
+	res = data_waiter_submit_release(VIRGIL_CMD_STORAGE_STORE, fields, opts, key_cache_write_end, request);
+	if (VIRGIL_OPERATION_OK != res) {
+		LOG("ERROR: Save key with encryption can't be processed");
+		return res;
+	}
+
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_save_encrypted_key(const char * key_id,
-		data_t key, __u16 key_type, const char * key_password) {
-	__u32 id;
+int virgil_save_key_result(virgil_request_t * request) {
 	__s16 err_res;
 	fields_t fields;
 
-	// Check input parameters
-	VALID_STR(key_id);
-
-	if (strnlen(key_id, VIRGIL_KEYSTORAGE_ID_MAX_SIZE * 2) >= VIRGIL_KEYSTORAGE_ID_MAX_SIZE) {
-		LOG("Save key error: identifier too big. Maximum size is %d bytes", VIRGIL_KEYSTORAGE_ID_MAX_SIZE);
-		return VIRGIL_OPERATION_ERROR;
-	}
-
-	if (key.sz > VIRGIL_KEYSTORAGE_PERMANENT_KEY_MAX_SIZE) {
-		LOG("Save key error: data for save too big. Maximum size is %d bytes", VIRGIL_KEYSTORAGE_PERMANENT_KEY_MAX_SIZE);
-		return VIRGIL_OPERATION_ERROR;
-	}
-
-	// Send request and wait for response
-	REQUEST_CHECK(id, save_encrypted_key_request(key_id, key, key_type, key_password));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Parse response
 	CHECK_ERROR(fields, err_res);
@@ -108,20 +112,45 @@ int virgil_save_encrypted_key(const char * key_id,
 	return VIRGIL_OPERATION_OK;
 }
 
+/******************************************************************************/
+int virgil_save_encrypted_key(const char * key_id,
+		data_t key, __u16 key_type, const char * key_password) {
+	virgil_request_t * request;
+
+	// Send request and wait for response
+	CHECK(virgil_save_encrypted_key_submit(key_id, key, key_type, key_password, 0, &request));
+	return virgil_save_key_result(request);
+}
+
 /******************************************************************************/
 int virgil_save_key(const char * key_id, data_t key, __u16 key_type) {
 	return virgil_save_encrypted_key(key_id, key, key_type, 0);
 }
 
 /******************************************************************************/
-static __u32 load_encrypted_key_request(const char * key_id, const char * key_password) {
+int virgil_load_encrypted_key_submit(const char * key_id, const char * key_password,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[2];
-	__u32 res;
+	data_t key;
+	int res;
+
+	// Check input parameters
+	VALID_STR(key_id);
 
 	fields.count = 1;
 	fields.ar = fields_ar;
 
+	// Cached key is returned without request to service
+	if (!key_password
+			&& VIRGIL_OPERATION_OK == key_cache_get(key_id, &key, opts && opts->gfp ? opts->gfp : GFP_KERNEL)) {
+		FILL_FIELD(fields_ar[0], VIRGIL_FIELD_DATA, key);
+		res = data_waiter_submit_done(VIRGIL_CMD_STORAGE_LOAD, fields, opts, request);
+		memzero_explicit(key.data, key.sz);
+		virgil_data_free(&key);
+		return res;
+	}
+
 	FILL_FIELD_STR(fields_ar[0], VIRGIL_FIELD_IDENTITY, key_id);
 
 	if (key_password) {
@@ -129,28 +158,42 @@ static __u32 load_encrypted_key_request(const char * key_id, const char * key_pa
 		fields.count ++;
 	}
 
-	SEND_WITH_CHECK(VIRGIL_CMD_STORAGE_LOAD,
+	SUBMIT_WITH_CHECK(VIRGIL_CMD_STORAGE_LOAD,
 			fields,
-			res,
+			opts,
+			request,
 			"ERROR: Load encrypted key can't be processed");
 
-	return res;
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_load_encrypted_key(const char * key_id,
-		const char * key_password, data_t * loaded_key) {
-	__u32 id;
+/* Service adds type of storage to response, only permanent keys are cached */
+static bool is_permanent_key(fields_t fields) {
+	struct package_field_t * res_fields[1] = { 0 };
+	__u16 res_cnt = 0;
+	__u16 key_type;
+
+	fields_by_type(VIRGIL_FIELD_KEY_TYPE, fields, 1, &res_cnt, res_fields);
+	if (!res_cnt || sizeof(key_type) != res_fields[0]->data_sz) {
+		return false;
+	}
+
+	memcpy(&key_type, res_fields[0]->data.p, sizeof(key_type));
+
+	return VIRGIL_KEY_PERMANENT == key_type;
+}
+
+/******************************************************************************/
+static int load_key_result(virgil_request_t * request, data_t * loaded_key, bool * is_permanent) {
 	__s16 err_res;
 	fields_t fields;
 
 	// Check input parameters
-	VALID_STR(key_id);
-	NOT_ZERO(loaded_key);
+	RESULT_NOT_ZERO(request, loaded_key);
 
-	// Send request and wait for response
-	REQUEST_CHECK(id, load_encrypted_key_request(key_id, key_password));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Clear output data
 	virgil_data_reset(loaded_key);
@@ -159,47 +202,86 @@ int virgil_load_encrypted_key(const char * key_id,
 	CHECK_ERROR(fields, err_res);
 	CHECK(fields_dup_first(VIRGIL_FIELD_DATA, fields, loaded_key));
 
+	if (is_permanent) {
+		*is_permanent = is_permanent_key(fields);
+	}
+
 	fields_free(&fields);
 
 	return VIRGIL_OPERATION_OK;
 }
 
+/******************************************************************************/
+int virgil_load_key_result(virgil_request_t * request, data_t * loaded_key) {
+	return load_key_result(request, loaded_key, 0);
+}
+
+/******************************************************************************/
+int virgil_load_encrypted_key(const char * key_id,
+		const char * key_password, data_t * loaded_key) {
+	virgil_request_t * request;
+	__u32 generation = 0;
+	bool is_permanent = false;
+	int res;
+
+	// Check input parameters
+	NOT_ZERO(loaded_key);
+	VALID_STR(key_id);
+
+	// Key is looked up in cache by submit, generation is taken before to skip keys changed meanwhile
+	if (!key_password) {
+		generation = key_cache_generation();
+	}
+
+	// Send request and wait for response
+	CHECK(virgil_load_encrypted_key_submit(key_id, key_password, 0, &request));
+	res = load_key_result(request, loaded_key, &is_permanent);
+
+	if (VIRGIL_OPERATION_OK == res && is_permanent && !key_password) {
+		key_cache_add(key_id, *loaded_key, generation);
+	}
+
+	return res;
+}
+
 /******************************************************************************/
 int virgil_load_key(const char * key_id, data_t * loaded_key) {
 	return virgil_load_encrypted_key(key_id, 0, loaded_key);
 }
 
 /******************************************************************************/
-static __u32 revoke_key_request(const char * key_id) {
+int virgil_revoke_key_submit(const char * key_id,
+		const virgil_request_opts_t * opts, virgil_request_t ** request) {
 	fields_t fields;
 	struct package_field_t fields_ar[1];
-	__u32 res;
+	int res;
+
+	// Check input parameters
+	VALID_STR(key_id);
 
 	fields.count = 1;
 	fields.ar = fields_ar;
 
 	FILL_FIELD_STR(fields_ar[0], VIRGIL_FIELD_IDENTITY, key_id);
 
-	SEND_WITH_CHECK(VIRGIL_CMD_STORAGE_REMOVE,
-			fields,
-			res,
-			"ERROR: Key revoke can't be processed");
+	key_cache_write_begin(key_id);
 
-	return res;
+	res = data_waiter_submit_release(VIRGIL_CMD_STORAGE_REMOVE, fields, opts, key_cache_write_end, request);
+	if (VIRGIL_OPERATION_OK != res) {
+		LOG("ERROR: Key revoke can't be processed");
+		return res;
+	}
+
+	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int virgil_revoke_key(const char * key_id) {
-	__u32 id;
+int virgil_revoke_key_result(virgil_request_t * request) {
 	__s16 err_res;
 	fields_t fields;
 
-	// Check input parameters
-	VALID_STR(key_id);
-
-	// Send request and wait for response
-	REQUEST_CHECK(id, revoke_key_request(key_id));
-	CHECK(data_waiter_execute(id, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
+	// Wait for response
+	CHECK(data_waiter_result(request, &fields, VIRGIL_OPERATION_TIMEOUT_MS));
 
 	// Parse response
 	CHECK_ERROR(fields, err_res);
@@ -209,10 +291,25 @@ int virgil_revoke_key(const char * key_id) {
 	return VIRGIL_OPERATION_OK;
 }
 
+/******************************************************************************/
+int virgil_revoke_key(const char * key_id) {
+	virgil_request_t * request;
+
+	// Send request and wait for response
+	CHECK(virgil_revoke_key_submit(key_id, 0, &request));
+	return virgil_revoke_key_result(request);
+}
+
+EXPORT_SYMBOL( virgil_save_encrypted_key_submit);
+EXPORT_SYMBOL( virgil_save_key_result);
 EXPORT_SYMBOL( virgil_save_encrypted_key);
 EXPORT_SYMBOL( virgil_save_key);
 
+EXPORT_SYMBOL( virgil_load_encrypted_key_submit);
+EXPORT_SYMBOL( virgil_load_key_result);
 EXPORT_SYMBOL( virgil_load_encrypted_key);
 EXPORT_SYMBOL( virgil_load_key);
 
+EXPORT_SYMBOL( virgil_revoke_key_submit);
+EXPORT_SYMBOL( virgil_revoke_key_result);
 EXPORT_SYMBOL( virgil_revoke_key);
@@ -37,116 +37,852 @@
 /**
  * @file data-waiter.c
  * @brief Functionality to wait response from user-space.
- * Data waiter connected to user-space communicator and receives data. After receive need command data waiter will wake up.
+ * Every request is registered in table of pending requests before sending. After receive of response
+ * corresponding request will be completed and waiter (if present) will wake up.
  * If data not received, then time out will be produced.
+ * Requests which can't be sent right now (windows of workers are full or service is restarting) keep copy
+ * of their data and wait in queue of their priority class. Queues are served with weighted fair queueing.
+ * Idempotent requests of disconnected worker return to queue and are sent again to new worker.
+ * Expired requests are failed.
  */
 
 #include <linux/module.h>
 #include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/mempool.h>
+#include <linux/spinlock.h>
+#include <linux/jiffies.h>
+#include <linux/hashtable.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
 
 #include <virgil/kernel/private/log.h>
 #include <virgil/kernel/private/fields.h>
 #include <virgil/kernel/private/data-waiter.h>
 #include <virgil/kernel/private/usermode-communicator.h>
+#include <virgil/kernel/private/ports.h>
 
-static data_wait_element_t data_waiters[VIRGIL_DATA_WAITER_COUNT];
-static int is_prepared = 0;
+static DEFINE_HASHTABLE(pending, VIRGIL_DATA_WAITER_HASH_BITS);
+static DEFINE_SPINLOCK(pending_lock);
+static unsigned int pending_count = 0;
 
-static DECLARE_WAIT_QUEUE_HEAD( wait_queue);
+// Admission control. Submitters can wait for free room.
+static unsigned int max_requests = VIRGIL_REQUESTS_MAX;
+module_param(max_requests, uint, 0644);
+MODULE_PARM_DESC(max_requests, "Maximum count of pending requests to user-space service");
+
+static DECLARE_WAIT_QUEUE_HEAD(admission_wait);
+
+// Requests which wait for worker, one queue per priority class (protected by pending_lock)
+static struct list_head parked[VIRGIL_PRIORITY_CLASSES] = {
+        LIST_HEAD_INIT(parked[0]),
+        LIST_HEAD_INIT(parked[1]),
+        LIST_HEAD_INIT(parked[2]),
+        LIST_HEAD_INIT(parked[3])
+};
+static int parked_count = 0;
+
+// Weighted fair queueing. Each request gets finish tag, request with the least tag is sent first.
+static const __u32 class_weight[VIRGIL_PRIORITY_CLASSES] = {
+        1,                              // VIRGIL_PRIORITY_DEFAULT (not used)
+        VIRGIL_WEIGHT_CRITICAL,         // VIRGIL_PRIORITY_CRITICAL
+        VIRGIL_WEIGHT_NORMAL,           // VIRGIL_PRIORITY_NORMAL
+        VIRGIL_WEIGHT_BULK              // VIRGIL_PRIORITY_BULK
+};
+static __u64 class_tag[VIRGIL_PRIORITY_CLASSES];
+static __u64 virtual_time = 0;
+
+static void replay(struct work_struct * work);
+static DECLARE_DELAYED_WORK(replay_work, replay);
+
+// Requests are allocated from own cache with reserve, so submit doesn't fail under memory pressure
+static struct kmem_cache * request_cache = 0;
+static mempool_t * request_pool = 0;
 
 /******************************************************************************/
-static void prepare(void) {
+static void request_release(struct kref * ref) {
+    virgil_request_t * request = container_of(ref, virgil_request_t, ref);
+
+    void (*release)(void) = request->release;
+
+    fields_free(&request->fields);
+    fields_free(&request->copy);
+    mempool_free(request, request_pool);
+
+    if (release) {
+        release();
+    }
+}
+
+/******************************************************************************/
+/* Requests which don't change state of service and can be sent again */
+static bool is_replayable(__u16 command) {
+    switch (command) {
+    case VIRGIL_CMD_CRYPTO_HASH:
+    case VIRGIL_CMD_CRYPTO_VERIFY:
+    case VIRGIL_CMD_CRYPTO_VERIFY_BATCH:
+    case VIRGIL_CMD_STORAGE_LOAD:
+    case VIRGIL_CMD_CERTIFICATE_VERIFY:
+    case VIRGIL_CMD_CERTIFICATE_PARSE:
+    case VIRGIL_CMD_CERTIFICATE_CRL_INFO:
+    case VIRGIL_CMD_CERTIFICATE_CHECK_IS_REVOKED:
+        return true;
+    }
+
+    return false;
+}
+
+/******************************************************************************/
+/* Priority class of command, if it isn't set by caller */
+static __u8 default_priority(__u16 command) {
+    switch (command) {
+    case VIRGIL_CMD_CRYPTO_SIGN:
+    case VIRGIL_CMD_CRYPTO_SIGN_BATCH:
+    case VIRGIL_CMD_CRYPTO_VERIFY:
+    case VIRGIL_CMD_CRYPTO_VERIFY_BATCH:
+    case VIRGIL_CMD_CRYPTO_HASH:
+        return VIRGIL_PRIORITY_CRITICAL;
+
+    case VIRGIL_CMD_CERTIFICATE_CREATE:
+    case VIRGIL_CMD_CERTIFICATE_GET:
+    case VIRGIL_CMD_CERTIFICATE_REVOKE:
+        return VIRGIL_PRIORITY_BULK;
+    }
+
+    return VIRGIL_PRIORITY_NORMAL;
+}
+
+/******************************************************************************/
+/* Copy fields into single memory block. Request can't wait in queue if copy can't be done. */
+static void request_copy(virgil_request_t * request, fields_t fields, gfp_t gfp) {
+    if (request->copy.ar) {
+        return;
+    }
+
+    if (!fields.count || fields_size(fields) > VIRGIL_REPLAY_DATA_MAX) {
+        return;
+    }
+
+    fields_copy(&request->copy, fields, gfp);
+}
+
+/******************************************************************************/
+/* Put request into queue of requests which wait for worker. pending_lock must be held. */
+static bool park_locked(virgil_request_t * request) {
+    if (!request->copy.ar || !hash_hashed(&request->node)
+            || parked_count >= VIRGIL_PARKED_MAX
+            || time_after_eq(jiffies, request->deadline)) {
+        return false;
+    }
+
+    request->port = VIRGIL_PORT_NONE;
+    if (!request->is_parked) {
+        request->tag = max(virtual_time, class_tag[request->priority])
+                + VIRGIL_WEIGHT_SCALE / class_weight[request->priority];
+        class_tag[request->priority] = request->tag;
+
+        request->is_parked = true;
+        list_add_tail(&request->parked, &parked[request->priority]);
+        ++parked_count;
+    }
+
+    return true;
+}
+
+/******************************************************************************/
+static void unpark_locked(virgil_request_t * request) {
+    if (request->is_parked) {
+        request->is_parked = false;
+        list_del_init(&request->parked);
+        --parked_count;
+    }
+}
+
+/******************************************************************************/
+/* Return request, which couldn't be sent, to head of its queue. It keeps its tag. */
+static bool repark(virgil_request_t * request) {
+    bool res = false;
+
+    spin_lock_bh(&pending_lock);
+    if (hash_hashed(&request->node) && !request->is_parked) {
+        request->port = VIRGIL_PORT_NONE;
+        request->is_parked = true;
+        list_add(&request->parked, &parked[request->priority]);
+        ++parked_count;
+        res = true;
+    }
+    spin_unlock_bh(&pending_lock);
+
+    return res;
+}
+
+/******************************************************************************/
+/* Request with the least finish tag among heads of queues, which aren't blocked */
+static virgil_request_t * pick_locked(unsigned int blocked) {
+    virgil_request_t * request;
+    virgil_request_t * res = 0;
     int i;
 
-    if (!is_prepared) {
-        is_prepared = 1;
+    for (i = 0; i < VIRGIL_PRIORITY_CLASSES; ++i) {
+        if ((blocked & (1 << i)) || list_empty(&parked[i])) {
+            continue;
+        }
 
-        for (i = 0; i < VIRGIL_DATA_WAITER_COUNT; ++i) {
-            data_waiters[i].id = VIRGIL_INVALID_ID;
-            data_waiters[i].condition = 0;
+        request = list_first_entry(&parked[i], virgil_request_t, parked);
+        if (!res || request->tag < res->tag) {
+            res = request;
         }
     }
+
+    return res;
 }
 
 /******************************************************************************/
-int data_waiter_command_processor(__u32 request_id, __u16 command_type, fields_t fields) {
-    int i, res;
+static bool park(virgil_request_t * request) {
+    bool res;
+
+    spin_lock_bh(&pending_lock);
+    res = park_locked(request);
+    spin_unlock_bh(&pending_lock);
+
+    // Parked requests are checked periodically, so expired ones are failed even without worker
+    if (res) {
+        schedule_delayed_work(&replay_work, msecs_to_jiffies(VIRGIL_SERVICE_START_TIMEOUT_MS));
+    }
+
+    return res;
+}
+
+/******************************************************************************/
+static bool class_is_parked(__u8 priority) {
+    bool res;
+
+    spin_lock_bh(&pending_lock);
+    res = !list_empty(&parked[priority]);
+    spin_unlock_bh(&pending_lock);
+
+    return res;
+}
+
+/******************************************************************************/
+static void request_put(virgil_request_t * request) {
+    kref_put(&request->ref, request_release);
+}
+
+/******************************************************************************/
+/* Register request if there is room for it */
+static bool pending_push(virgil_request_t * request) {
+    bool res;
+
+    spin_lock_bh(&pending_lock);
+    res = pending_count < ACCESS_ONCE(max_requests);
+    if (res) {
+        kref_get(&request->ref);
+        hash_add(pending, &request->node, request->id);
+        ++pending_count;
+    }
+    spin_unlock_bh(&pending_lock);
+
+    return res;
+}
+
+/******************************************************************************/
+/* Remove request from table of pending requests. pending_lock must be held. */
+static void pending_del_locked(virgil_request_t * request) {
+    hash_del(&request->node);
+    unpark_locked(request);
+    --pending_count;
+
+    wake_up(&admission_wait);
+}
+
+/******************************************************************************/
+/* Register request. If there are too many pending requests, caller waits for free room up to wait_ms. */
+static bool admit(virgil_request_t * request, __u32 wait_ms, gfp_t gfp) {
+    unsigned long deadline, now;
+
+    if (pending_push(request)) {
+        return true;
+    }
 
-    prepare();
+    if (!wait_ms || !GFP_CAN_SLEEP(gfp)) {
+        return false;
+    }
+
+    deadline = jiffies + msecs_to_jiffies(wait_ms);
+    for (;;) {
+        now = jiffies;
+        if (!time_before(now, deadline)
+                || wait_event_interruptible_timeout(admission_wait,
+                        ACCESS_ONCE(pending_count) < ACCESS_ONCE(max_requests), deadline - now) <= 0) {
+            return false;
+        }
+
+        if (pending_push(request)) {
+            return true;
+        }
+    }
+}
+
+/******************************************************************************/
+/* Returns reference owned by table of pending requests */
+static virgil_request_t * pending_take(__u32 id) {
+    virgil_request_t * request;
+    virgil_request_t * res = 0;
+
+    spin_lock_bh(&pending_lock);
+    hash_for_each_possible(pending, request, node, id) {
+        if (request->id == id) {
+            pending_del_locked(request);
+            res = request;
+            break;
+        }
+    }
+    spin_unlock_bh(&pending_lock);
+
+    return res;
+}
+
+/******************************************************************************/
+/* Worker has room for one more request, so queued one can be sent */
+static void request_finished(virgil_request_t * request) {
+    ports_release(request->port, request->priority);
+
+    if (VIRGIL_PORT_NONE != request->port && ACCESS_ONCE(parked_count)) {
+        data_waiter_replay();
+    }
+}
+
+/******************************************************************************/
+/* Set worker of sent request. If request has been taken while it was sent (response, timeout or cancel),
+ * taker has seen no worker, so worker is released here. */
+static void request_sent(virgil_request_t * request, __u32 port) {
+    virgil_request_t * pending_request;
+    bool is_pending = false;
+
+    spin_lock_bh(&pending_lock);
+    hash_for_each_possible(pending, pending_request, node, request->id) {
+        if (pending_request == request) {
+            request->port = port;
+            is_pending = true;
+            break;
+        }
+    }
+    spin_unlock_bh(&pending_lock);
+
+    if (!is_pending) {
+        communicator_cancel(request->id, port);
+        ports_release(port, request->priority);
+
+        if (ACCESS_ONCE(parked_count)) {
+            data_waiter_replay();
+        }
+    }
+}
+
+/******************************************************************************/
+/* Request which is being processed right now isn't waited for, its processor holds own reference */
+static void request_cancel(virgil_request_t * request) {
+    virgil_request_t * pending_request;
+
+    pending_request = pending_take(request->id);
+    if (pending_request) {
+        // Worker doesn't spend time for request which nobody waits
+        communicator_cancel(pending_request->id, pending_request->port);
+        request_finished(pending_request);
+        request_put(pending_request);
+    }
+}
+
+/******************************************************************************/
+static void request_complete(virgil_request_t * request) {
+    complete_all(&request->done);
+
+    if (request->callback) {
+        request->callback(request, request->ctx);
+    }
+
+    request_put(request);
+}
+
+/******************************************************************************/
+int data_waiter_command_processor(__u32 request_id, __u16 command_type, fields_t fields, fields_owner_t * owner) {
+    virgil_request_t * request;
 
-    res = VIRGIL_OPERATION_ERROR;
     if (VIRGIL_INVALID_ID == request_id) {
         return VIRGIL_OPERATION_ERROR;
     }
 
-    for (i = 0; i < VIRGIL_DATA_WAITER_COUNT; ++i) {
-        if (data_waiters[i].id == request_id) {
-            res = fields_dup(&data_waiters[i].fields, fields);
-            if (VIRGIL_OPERATION_OK == res) {
-                data_waiters[i].condition = 1;
-                wake_up_interruptible(&wait_queue);
+    request = pending_take(request_id);
+    if (!request) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    request_finished(request);
+
+    if (VIRGIL_OPERATION_OK == fields_take(&request->fields, fields, owner, GFP_KERNEL)
+            && (request->fields.ar || !fields.count)) {
+        request->status = VIRGIL_OPERATION_OK;
+    }
+
+    request_complete(request);
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+void data_waiter_fail_port(__u32 port) {
+    virgil_request_t * request;
+    struct hlist_node * tmp;
+    bool is_parked;
+    int bkt;
+    HLIST_HEAD(failed);
+
+    if (VIRGIL_PORT_NONE == port) {
+        return;
+    }
+
+    spin_lock_bh(&pending_lock);
+    hash_for_each_safe(pending, bkt, tmp, request, node) {
+        if (request->port != port) {
+            continue;
+        }
+
+        if (!is_replayable(request->command) || !park_locked(request)) {
+            pending_del_locked(request);
+            hlist_add_head(&request->node, &failed);
+        }
+    }
+    is_parked = parked_count > 0;
+    spin_unlock_bh(&pending_lock);
+
+    if (is_parked) {
+        schedule_delayed_work(&replay_work, msecs_to_jiffies(VIRGIL_SERVICE_START_TIMEOUT_MS));
+    }
+
+    // Waiters are woken up outside of lock, because callbacks can submit new requests
+    hlist_for_each_entry_safe(request, tmp, &failed, node) {
+        hlist_del(&request->node);
+        request->status = VIRGIL_OPERATION_UNAVAILABLE;
+        request_complete(request);
+    }
+}
+
+/******************************************************************************/
+void data_waiter_fail_request(__u32 request_id, int status) {
+    virgil_request_t * request;
+
+    request = pending_take(request_id);
+    if (!request) {
+        return;
+    }
+
+    request_finished(request);
+    request->status = status;
+    request_complete(request);
+}
+
+/******************************************************************************/
+static void replay(struct work_struct * work) {
+    virgil_request_t * request;
+    virgil_request_t * taken;
+    virgil_request_t * tmp;
+    struct hlist_node * node_tmp;
+    unsigned int blocked = 0;
+    bool is_parked;
+    __u32 port;
+    int i, res;
+    HLIST_HEAD(expired);
+
+    spin_lock_bh(&pending_lock);
+    for (i = 0; i < VIRGIL_PRIORITY_CLASSES; ++i) {
+        list_for_each_entry_safe(request, tmp, &parked[i], parked) {
+            if (time_after_eq(jiffies, request->deadline)) {
+                pending_del_locked(request);
+                hlist_add_head(&request->node, &expired);
             }
+        }
+    }
+    spin_unlock_bh(&pending_lock);
+
+    hlist_for_each_entry_safe(request, node_tmp, &expired, node) {
+        hlist_del(&request->node);
+        request_complete(request);
+    }
+
+    // Send requests in order of finish tags while workers have room for them
+    while (ports_count() > 0) {
+        spin_lock_bh(&pending_lock);
+        request = pick_locked(blocked);
+        if (request) {
+            // Request is held by own reference while it's being sent
+            unpark_locked(request);
+            kref_get(&request->ref);
+            virtual_time = max(virtual_time, request->tag);
+        }
+        spin_unlock_bh(&pending_lock);
+
+        if (!request) {
             break;
         }
+
+        // Port is set under lock after sending, request can be taken meanwhile
+        res = communicator_send(request->id, request->command, request->priority, request->deadline,
+                request->copy, GFP_KERNEL, 0, &port);
+
+        if (VIRGIL_OPERATION_OK == res) {
+            request_sent(request, port);
+        } else if ((VIRGIL_OPERATION_BUSY == res || VIRGIL_OPERATION_UNAVAILABLE == res) && repark(request)) {
+            // Class waits for free room in window
+            blocked |= 1 << request->priority;
+        } else {
+            // Request could be cancelled while it has been sent
+            taken = pending_take(request->id);
+            if (taken) {
+                taken->status = res;
+                request_complete(taken);
+            }
+        }
+
+        request_put(request);
     }
 
-    return VIRGIL_OPERATION_OK;
+    spin_lock_bh(&pending_lock);
+    is_parked = parked_count > 0;
+    spin_unlock_bh(&pending_lock);
+
+    if (is_parked) {
+        schedule_delayed_work(&replay_work, msecs_to_jiffies(VIRGIL_SERVICE_START_TIMEOUT_MS));
+    }
 }
 
 /******************************************************************************/
-static int data_waiter_push(__u32 id) {
-    int i;
+static virgil_request_t * request_alloc(__u16 command, const virgil_request_opts_t * opts, gfp_t gfp) {
+    virgil_request_t * res;
 
-    prepare();
+    if (opts && opts->priority >= VIRGIL_PRIORITY_CLASSES) {
+        return 0;
+    }
 
-    if (VIRGIL_INVALID_ID == id) {
-        return -1;
+    res = mempool_alloc(request_pool, gfp);
+    if (!res) {
+        LOG("ERROR: No memory for request");
+        return 0;
     }
+    memset(res, 0, sizeof(*res));
 
-    for (i = 0; i < VIRGIL_DATA_WAITER_COUNT; ++i) {
-        if (VIRGIL_INVALID_ID == data_waiters[i].id) {
-            data_waiters[i].id = id;
-            data_waiters[i].condition = 0;
-            fields_reset(&data_waiters[i].fields);
-            return i;
+    kref_init(&res->ref);
+    init_completion(&res->done);
+    res->status = VIRGIL_OPERATION_ERROR;
+    res->id = communicator_next_id();
+    res->command = command;
+    res->priority = default_priority(command);
+    res->deadline = jiffies + msecs_to_jiffies(VIRGIL_OPERATION_TIMEOUT_MS);
+    INIT_LIST_HEAD(&res->parked);
+    if (opts) {
+        res->callback = opts->callback;
+        res->ctx = opts->ctx;
+        if (opts->timeout_ms) {
+            res->deadline = jiffies + msecs_to_jiffies(opts->timeout_ms);
+        }
+        if (VIRGIL_PRIORITY_DEFAULT != opts->priority) {
+            res->priority = opts->priority;
         }
     }
 
-    return -1;
+    return res;
 }
 
 /******************************************************************************/
-static int data_waiter_pop(__u32 id, fields_t * fields) {
-    int i;
+/* Register and send request. Request isn't registered or is cancelled in case of error. */
+static int request_submit(virgil_request_t * request, fields_t fields,
+        const virgil_request_opts_t * opts, gfp_t gfp) {
+    __u32 port;
+    int send_res;
 
-    prepare();
+    if (is_replayable(request->command)) {
+        request_copy(request, fields, gfp);
+    }
+
+    // Request isn't sent if there are too many pending requests
+    if (!admit(request, opts ? opts->busy_wait_ms : 0, gfp)) {
+        return VIRGIL_OPERATION_BUSY;
+    }
+
+    // Wait for restart of service instead of immediate fail
+    if (request->copy.ar && !ports_count() && park(request)) {
+        return VIRGIL_OPERATION_OK;
+    }
 
-    if (VIRGIL_INVALID_ID == id || !fields) {
+    // Requests of one class are sent in order
+    if (class_is_parked(request->priority)) {
+        send_res = VIRGIL_OPERATION_BUSY;
+    } else {
+        // Request is pending already, so port is set under lock after sending
+        send_res = communicator_send(request->id, request->command, request->priority, request->deadline,
+                fields, gfp, opts ? opts->batch : 0, &port);
+        if (VIRGIL_OPERATION_OK == send_res) {
+            request_sent(request, port);
+        }
+    }
+
+    if (VIRGIL_OPERATION_BUSY == send_res) {
+        request_copy(request, fields, gfp);
+    }
+
+    if ((VIRGIL_OPERATION_BUSY == send_res || VIRGIL_OPERATION_UNAVAILABLE == send_res) && park(request)) {
+        if (VIRGIL_OPERATION_BUSY == send_res) {
+            data_waiter_replay();
+        }
+        send_res = VIRGIL_OPERATION_OK;
+    }
+
+    if (VIRGIL_OPERATION_OK != send_res) {
+        request_cancel(request);
+    }
+
+    return send_res;
+}
+
+/******************************************************************************/
+int data_waiter_submit_release(__u16 command, fields_t fields,
+        const virgil_request_opts_t * opts,
+        void (*release)(void),
+        virgil_request_t ** request) {
+    virgil_request_t * res;
+    gfp_t gfp = GFP_KERNEL;
+    int send_res;
+
+    if (request) {
+        *request = 0;
+    }
+
+    if (opts && opts->gfp) {
+        gfp = opts->gfp;
+    }
+
+    res = request ? request_alloc(command, opts, gfp) : 0;
+    if (!res) {
+        if (release) {
+            release();
+        }
+        return VIRGIL_OPERATION_ERROR;
+    }
+    res->release = release;
+
+    // Response can come before submit ends. Handle is set before and submit holds own reference,
+    // because completion callback can release reference of caller.
+    kref_get(&res->ref);
+    *request = res;
+
+    send_res = request_submit(res, fields, opts, gfp);
+    if (VIRGIL_OPERATION_OK != send_res) {
+        *request = 0;
+        request_put(res);
+    }
+
+    request_put(res);
+
+    return send_res;
+}
+
+/******************************************************************************/
+int data_waiter_submit(__u16 command, fields_t fields,
+        const virgil_request_opts_t * opts,
+        virgil_request_t ** request) {
+    return data_waiter_submit_release(command, fields, opts, 0, request);
+}
+
+/******************************************************************************/
+int data_waiter_submit_done(__u16 command, fields_t response,
+        const virgil_request_opts_t * opts,
+        virgil_request_t ** request) {
+    virgil_request_t * res;
+    gfp_t gfp = GFP_KERNEL;
+
+    if (!request) {
         return VIRGIL_OPERATION_ERROR;
     }
+    *request = 0;
 
-    for (i = 0; i < VIRGIL_DATA_WAITER_COUNT; ++i) {
-        if (data_waiters[i].id == id) {
-            fields->count = data_waiters[i].fields.count;
-            fields->ar = data_waiters[i].fields.ar;
-            data_waiters[i].id = VIRGIL_INVALID_ID;
-            return VIRGIL_OPERATION_OK;
+    if (opts && opts->gfp) {
+        gfp = opts->gfp;
+    }
+
+    res = request_alloc(command, opts, gfp);
+    if (!res) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    if (VIRGIL_OPERATION_OK != fields_copy(&res->fields, response, gfp)) {
+        request_put(res);
+        return VIRGIL_OPERATION_ERROR;
+    }
+    res->status = VIRGIL_OPERATION_OK;
+
+    // Reference of caller stays, the second one is released by completion and the third one by submit.
+    // Handle is set before completion callback, which can release reference of caller.
+    kref_get(&res->ref);
+    kref_get(&res->ref);
+    *request = res;
+    request_complete(res);
+    request_put(res);
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+int data_waiter_result(virgil_request_t * request, fields_t * fields, __u32 timeout_ms) {
+    int res;
+
+    if (!request) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    if (!fields) {
+        virgil_request_free(request);
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    if (wait_for_completion_interruptible_timeout(&request->done, msecs_to_jiffies(timeout_ms)) <= 0) {
+        request_cancel(request);
+    }
+
+    // Result of request, which is still being processed, isn't read
+    res = completion_done(&request->done) ? request->status : VIRGIL_OPERATION_ERROR;
+    if (VIRGIL_OPERATION_OK == res) {
+        *fields = request->fields;
+        fields_reset(&request->fields);
+    }
+
+    request_put(request);
+
+    return res;
+}
+
+/******************************************************************************/
+bool virgil_request_is_done(virgil_request_t * request) {
+    return request && completion_done(&request->done);
+}
+
+/******************************************************************************/
+int virgil_request_wait(virgil_request_t * request, __u32 timeout_ms) {
+    if (!request) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    if (wait_for_completion_interruptible_timeout(&request->done, msecs_to_jiffies(timeout_ms)) <= 0) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+int virgil_request_wait_all(virgil_request_t ** requests, __u32 count, __u32 timeout_ms) {
+    __u32 i;
+    unsigned long deadline, now;
+
+    if (!requests) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    deadline = jiffies + msecs_to_jiffies(timeout_ms);
+
+    for (i = 0; i < count; ++i) {
+        if (!requests[i]) {
+            return VIRGIL_OPERATION_ERROR;
+        }
+
+        if (completion_done(&requests[i]->done)) {
+            continue;
         }
+
+        now = jiffies;
+        if (time_after_eq(now, deadline)
+                || wait_for_completion_interruptible_timeout(&requests[i]->done, deadline - now) <= 0) {
+            return VIRGIL_OPERATION_ERROR;
+        }
+    }
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+void virgil_request_free(virgil_request_t * request) {
+    if (!request) {
+        return;
     }
 
-    return VIRGIL_OPERATION_ERROR;
+    if (!completion_done(&request->done)) {
+        request_cancel(request);
+    }
+
+    request_put(request);
+}
+
+/******************************************************************************/
+void data_waiter_replay(void) {
+    mod_delayed_work(system_wq, &replay_work, 0);
 }
 
 /******************************************************************************/
-int data_waiter_execute(__u32 id, fields_t * fields, __u16 timeout_ms) {
-    int pos = -1;
+int data_waiter_init(void) {
+    request_cache = KMEM_CACHE(virgil_request, 0);
+    if (!request_cache) {
+        return VIRGIL_OPERATION_ERROR;
+    }
 
-    pos = data_waiter_push(id);
-    if (pos < 0)
+    request_pool = mempool_create_slab_pool(VIRGIL_REQUESTS_RESERVE, request_cache);
+    if (!request_pool) {
+        kmem_cache_destroy(request_cache);
+        request_cache = 0;
         return VIRGIL_OPERATION_ERROR;
+    }
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+/* Complete all pending and parked requests, workers are stopped already */
+static void fail_all(void) {
+    virgil_request_t * request;
+    struct hlist_node * tmp;
+    int bkt;
+    HLIST_HEAD(failed);
+
+    spin_lock_bh(&pending_lock);
+    hash_for_each_safe(pending, bkt, tmp, request, node) {
+        pending_del_locked(request);
+        hlist_add_head(&request->node, &failed);
+    }
+    spin_unlock_bh(&pending_lock);
 
-    wait_event_interruptible_timeout(wait_queue,
-            data_waiters[pos].condition == 1, timeout_ms * HZ / 1000);
+    hlist_for_each_entry_safe(request, tmp, &failed, node) {
+        hlist_del(&request->node);
+        request->status = VIRGIL_OPERATION_UNAVAILABLE;
+        request_complete(request);
+    }
+}
+
+/******************************************************************************/
+void data_waiter_stop(void) {
+    // Requests must be released before their pool is destroyed
+    fail_all();
+    cancel_delayed_work_sync(&replay_work);
 
-    return data_waiter_pop(id, fields);
+    if (request_pool) {
+        mempool_destroy(request_pool);
+        request_pool = 0;
+    }
+
+    if (request_cache) {
+        kmem_cache_destroy(request_cache);
+        request_cache = 0;
+    }
 }
+
+EXPORT_SYMBOL( virgil_request_is_done);
+EXPORT_SYMBOL( virgil_request_wait);
+EXPORT_SYMBOL( virgil_request_wait_all);
+EXPORT_SYMBOL( virgil_request_free);
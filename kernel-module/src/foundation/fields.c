@@ -43,11 +43,71 @@
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/slab.h>
+#include <linux/mempool.h>
+#include <linux/scatterlist.h>
+#include <linux/skbuff.h>
 
 #include <virgil/kernel/types.h>
 #include <virgil/kernel/private/log.h>
 #include <virgil/kernel/private/fields.h>
 
+// Small blocks of fields (most of responses) are allocated from own cache with reserve
+static struct kmem_cache * fields_cache = 0;
+static mempool_t * fields_pool = 0;
+
+/**
+ * @struct fields_block_t
+ * Header of memory block with fields. Array of fields follows it,
+ * data of fields follows array or is kept in buffer of owner.
+ */
+typedef struct {
+    size_t sz;                  /**< Size of block including header */
+    fields_owner_t owner;       /**< Buffer with data of fields (if data isn't copied into block) */
+} fields_block_t;
+
+/******************************************************************************/
+int fields_init(void) {
+    fields_cache = kmem_cache_create("virgil_fields", VIRGIL_FIELDS_SMALL_SZ, 0, 0, NULL);
+    if (!fields_cache) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    fields_pool = mempool_create_slab_pool(VIRGIL_FIELDS_RESERVE, fields_cache);
+    if (!fields_pool) {
+        kmem_cache_destroy(fields_cache);
+        fields_cache = 0;
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+void fields_cleanup(void) {
+    if (fields_pool) {
+        mempool_destroy(fields_pool);
+        fields_pool = 0;
+    }
+
+    if (fields_cache) {
+        kmem_cache_destroy(fields_cache);
+        fields_cache = 0;
+    }
+}
+
+/******************************************************************************/
+size_t fields_size(fields_t fields) {
+    size_t sz;
+    int i;
+
+    sz = sizeof(struct package_field_t) * fields.count;
+    for (i = 0; i < fields.count; ++i) {
+        sz += fields.ar[i].data_sz;
+    }
+
+    return sz;
+}
+
 /******************************************************************************/
 int fields_reset(fields_t * fields) {
     if (!fields) return VIRGIL_OPERATION_ERROR;
@@ -56,20 +116,47 @@ int fields_reset(fields_t * fields) {
     return VIRGIL_OPERATION_OK;
 }
 
+/******************************************************************************/
+static fields_t fields_block_alloc(__u16 count, size_t sz, gfp_t gfp) {
+    fields_block_t * block;
+    fields_t res;
+
+    fields_reset(&res);
+
+    sz += sizeof(fields_block_t) + sizeof(struct package_field_t) * count;
+    if (sz <= VIRGIL_FIELDS_SMALL_SZ) {
+        block = mempool_alloc(fields_pool, gfp);
+    } else {
+        block = kmalloc(sz, gfp);
+    }
+    if (!block) return res;
+
+    block->sz = sz;
+    block->owner.buffer = 0;
+    block->owner.release = 0;
+
+    res.count = count;
+    res.ar = (struct package_field_t *)(block + 1);
+
+    return res;
+}
+
 /******************************************************************************/
 void fields_free(fields_t * fields) {
-    int i;
+    fields_block_t * block;
 
     if (!fields || !fields->ar) return;
 
-    for (i = 0; i < fields->count; ++i) {
-        if (fields->ar[i].data.p) {
-            kfree(fields->ar[i].data.p);
-        }
+    block = (fields_block_t *)fields->ar - 1;
+
+    if (block->owner.buffer && block->owner.release) {
+        block->owner.release(block->owner.buffer);
     }
 
-    if (fields->ar) {
-        kfree(fields->ar);
+    if (block->sz <= VIRGIL_FIELDS_SMALL_SZ) {
+        mempool_free(block, fields_pool);
+    } else {
+        kfree(block);
     }
 
     fields_reset(fields);
@@ -113,34 +200,98 @@ int fields_result(fields_t fields, __s16 * result) {
 }
 
 /******************************************************************************/
-int fields_dup(fields_t * dst, fields_t src) {
-    int i, is_ok;
+int fields_copy(fields_t * dst, fields_t src, gfp_t gfp) {
+    __u8 * payload;
+    int i;
+
+    fields_reset(dst);
+    if (!src.count) {
+        return VIRGIL_OPERATION_OK;
+    }
 
-    dst->count = src.count;
-    dst->ar =  kcalloc(src.count, sizeof(struct package_field_t), GFP_KERNEL);
+    // Array of fields and data of all fields are placed into single block
+    *dst = fields_block_alloc(src.count, fields_size(src) - sizeof(struct package_field_t) * src.count, gfp);
     if (!dst->ar) return VIRGIL_OPERATION_ERROR;
 
-    is_ok = 1;
+    payload = (__u8 *)(dst->ar + src.count);
     for (i = 0; i < src.count; ++i) {
-        dst->ar[i].type = src.ar[i].type;
+        dst->ar[i].type = VIRGIL_FIELD_TYPE(src.ar[i].type);
         dst->ar[i].data_sz = src.ar[i].data_sz;
-        dst->ar[i].data.p = kmemdup(src.ar[i].data.p, src.ar[i].data_sz, GFP_KERNEL);
-        if (!dst->ar[i].data.p) {
-            is_ok = 0;
-            break;
-        }
+        dst->ar[i].data.p = payload;
+        fields_data_read(&src.ar[i], 0, payload, src.ar[i].data_sz);
+        payload += src.ar[i].data_sz;
+    }
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+int fields_take(fields_t * dst, fields_t src, fields_owner_t * owner, gfp_t gfp) {
+    fields_block_t * block;
+
+    // Small data is copied, so big buffer isn't held for it
+    if (!owner || !owner->buffer || !src.count
+            || fields_size(src) + sizeof(fields_block_t) <= VIRGIL_FIELDS_SMALL_SZ) {
+        return fields_copy(dst, src, gfp);
+    }
+
+    // Only array of fields is copied, data stays in buffer of owner
+    *dst = fields_block_alloc(src.count, 0, gfp);
+    if (!dst->ar) return VIRGIL_OPERATION_ERROR;
+
+    memcpy(dst->ar, src.ar, sizeof(struct package_field_t) * src.count);
+
+    block = (fields_block_t *)dst->ar - 1;
+    block->owner = *owner;
+    owner->buffer = 0;
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+void fields_data_read(const struct package_field_t * field, __u32 offset, void * dst, __u32 len) {
+    const data_sg_t * data;
+
+    if (!len) return;
+
+    if (!(field->type & VIRGIL_FIELD_FLAG_SG)) {
+        memcpy(dst, (const __u8 *)field->data.p + offset, len);
+        return;
     }
 
-    // Clear mem in case of error
-    if (!is_ok) {
-        fields_free(dst);
-        kfree(dst->ar);
-        dst->ar = 0;
+    data = field->data.p;
+    if (data->skb) {
+        skb_copy_bits(data->skb, data->offset + offset, dst, len);
+    } else {
+        sg_pcopy_to_buffer(data->sg, sg_nents(data->sg), dst, len, data->offset + offset);
     }
+}
+
+/******************************************************************************/
+int fields_data_sg_check(const data_sg_t * data) {
+    struct scatterlist * sg;
+    __u64 sz = 0;
+
+    if (!data || (!data->sg == !data->skb)) return VIRGIL_OPERATION_ERROR;
+
+    if (data->skb) {
+        sz = data->skb->len;
+    } else {
+        for (sg = data->sg; sg; sg = sg_next(sg)) {
+            sz += sg->length;
+        }
+    }
+
+    if ((__u64)data->offset + data->sz > sz) return VIRGIL_OPERATION_ERROR;
 
     return VIRGIL_OPERATION_OK;
 }
 
+/******************************************************************************/
+int fields_dup(fields_t * dst, fields_t src) {
+    return fields_copy(dst, src, GFP_KERNEL);
+}
+
 /******************************************************************************/
 int fields_dup_first(int field_type, fields_t fields, data_t * dst) {
     struct package_field_t * res_fields[1] = { 0 };
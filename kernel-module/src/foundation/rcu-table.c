@@ -0,0 +1,150 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file rcu-table.c
+ * @brief Bounded hash table with lock-free lookups (rcu-table.h).
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/rculist.h>
+
+#include <virgil/kernel/private/rcu-table.h>
+
+/******************************************************************************/
+static struct hlist_head * bucket(rcu_table_t * table, __u32 hash) {
+    return &table->buckets[hash_32(hash, table->bits)];
+}
+
+/******************************************************************************/
+rcu_table_node_t * rcu_table_find(rcu_table_t * table, const void * key, __u32 hash) {
+    rcu_table_node_t * node;
+
+    hlist_for_each_entry_rcu(node, bucket(table, hash), node) {
+        if (node->hash == hash && table->match(node, key)) {
+            return node;
+        }
+    }
+
+    return 0;
+}
+
+/******************************************************************************/
+void rcu_table_remove_locked(rcu_table_t * table, rcu_table_node_t * node) {
+    hlist_del_rcu(&node->node);
+    list_del(&node->order);
+    table->count--;
+
+    // Node is the first member of entry, so it's freed by address of node
+    if (table->free_rcu) {
+        call_rcu(&node->rcu, table->free_rcu);
+    } else {
+        kfree_rcu(node, rcu);
+    }
+}
+
+/******************************************************************************/
+unsigned long rcu_table_evict_locked(rcu_table_t * table, unsigned long nr) {
+    rcu_table_node_t * node;
+    unsigned long freed = 0;
+    unsigned int scan = table->count * 2;
+
+    while (freed < nr && scan && !list_empty(&table->order)) {
+        scan--;
+        node = list_first_entry(&table->order, rcu_table_node_t, order);
+        if (node->referenced) {
+            node->referenced = 0;
+            list_move_tail(&node->order, &table->order);
+            continue;
+        }
+        rcu_table_remove_locked(table, node);
+        freed++;
+    }
+
+    return freed;
+}
+
+/******************************************************************************/
+void rcu_table_insert_locked(rcu_table_t * table, rcu_table_node_t * node, const void * key, unsigned int max) {
+    rcu_table_node_t * old;
+
+    old = rcu_table_find(table, key, node->hash);
+    if (old) {
+        rcu_table_remove_locked(table, old);
+    }
+
+    while (table->count >= max && rcu_table_evict_locked(table, 1)) {
+    }
+
+    node->referenced = 0;
+    hlist_add_head_rcu(&node->node, bucket(table, node->hash));
+    list_add_tail(&node->order, &table->order);
+    table->count++;
+}
+
+/******************************************************************************/
+void rcu_table_clear_locked(rcu_table_t * table) {
+    rcu_table_node_t * node;
+    rcu_table_node_t * tmp;
+
+    list_for_each_entry_safe(node, tmp, &table->order, order) {
+        rcu_table_remove_locked(table, node);
+    }
+}
+
+/******************************************************************************/
+void rcu_table_remove(rcu_table_t * table, const void * key, __u32 hash) {
+    rcu_table_node_t * node;
+
+    spin_lock_bh(&table->lock);
+    node = rcu_table_find(table, key, hash);
+    if (node) {
+        rcu_table_remove_locked(table, node);
+    }
+    spin_unlock_bh(&table->lock);
+}
+
+/******************************************************************************/
+void rcu_table_destroy(rcu_table_t * table) {
+    spin_lock_bh(&table->lock);
+    rcu_table_clear_locked(table);
+    spin_unlock_bh(&table->lock);
+
+    // Wait for free of removed entries before module is unloaded
+    rcu_barrier();
+}
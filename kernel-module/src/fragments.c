@@ -0,0 +1,192 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file fragments.c
+ * @brief Reassembly of fragmented frames received from user-space.
+ * Memory used by incomplete frames is limited by VIRGIL_REASSEMBLY_MEM_MAX.
+ * Incomplete frame is dropped after VIRGIL_OPERATION_TIMEOUT_MS.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/jiffies.h>
+
+#include <virgil/kernel/private/log.h>
+#include <virgil/kernel/private/fragments.h>
+
+/** Frame in reassembly */
+typedef struct {
+    struct list_head list;              /**< element of list of frames */
+    __u32 id;                           /**< id of request */
+    __u32 frame_sz;                     /**< size of whole frame */
+    __u32 received;                     /**< size of received part */
+    unsigned long expires;              /**< time of drop for incomplete frame */
+    __u8 * data;                        /**< frame data */
+} fragmented_frame_t;
+
+static LIST_HEAD(frames);
+static DEFINE_MUTEX(frames_mutex);
+static __u32 frames_mem = 0;
+
+/******************************************************************************/
+static void frame_drop(fragmented_frame_t * frame) {
+    list_del(&frame->list);
+    frames_mem -= frame->frame_sz;
+    vfree(frame->data);
+    kfree(frame);
+}
+
+/******************************************************************************/
+static fragmented_frame_t * frame_find(__u32 id) {
+    fragmented_frame_t * frame, * tmp;
+    fragmented_frame_t * res = 0;
+
+    list_for_each_entry_safe(frame, tmp, &frames, list) {
+        if (frame->id == id) {
+            res = frame;
+        } else if (time_after(jiffies, frame->expires)) {
+            LOG("Incomplete frame has been dropped (id : %u)", frame->id);
+            frame_drop(frame);
+        }
+    }
+
+    return res;
+}
+
+/******************************************************************************/
+static fragmented_frame_t * frame_create(__u32 id, __u32 frame_sz) {
+    fragmented_frame_t * frame;
+
+    if (frames_mem + frame_sz > VIRGIL_REASSEMBLY_MEM_MAX) {
+        LOG("ERROR: No memory for frame reassembly");
+        return 0;
+    }
+
+    frame = kzalloc(sizeof(*frame), GFP_KERNEL);
+    if (!frame) return 0;
+
+    frame->data = vmalloc(frame_sz);
+    if (!frame->data) {
+        kfree(frame);
+        return 0;
+    }
+
+    frame->id = id;
+    frame->frame_sz = frame_sz;
+    frame->expires = jiffies + msecs_to_jiffies(VIRGIL_OPERATION_TIMEOUT_MS);
+    frames_mem += frame_sz;
+    list_add_tail(&frame->list, &frames);
+
+    return frame;
+}
+
+/******************************************************************************/
+int fragments_receive(__u32 id, const void * data, __u32 data_sz, void ** frame, __u32 * frame_sz) {
+    fragment_header_t header;
+    fragmented_frame_t * assembled;
+    __u32 part_sz;
+    int res = VIRGIL_OPERATION_ERROR;
+
+    if (!data || !frame || !frame_sz || data_sz <= sizeof(header)) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    *frame = 0;
+    *frame_sz = 0;
+
+    memcpy(&header, data, sizeof(header));
+    part_sz = data_sz - sizeof(header);
+
+    if (header.frame_sz > VIRGIL_FRAME_SZ_MAX
+            || header.offset >= header.frame_sz
+            || part_sz > header.frame_sz - header.offset) {
+        LOG("ERROR: Wrong fragment (id : %u)", id);
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    mutex_lock(&frames_mutex);
+
+    assembled = frame_find(id);
+
+    // First fragment starts new frame
+    if (!header.offset) {
+        if (assembled) {
+            frame_drop(assembled);
+        }
+        assembled = frame_create(id, header.frame_sz);
+    }
+
+    if (!assembled) {
+        goto terminate;
+    }
+
+    if (header.offset != assembled->received || header.frame_sz != assembled->frame_sz) {
+        LOG("ERROR: Fragment out of order (id : %u)", id);
+        frame_drop(assembled);
+        goto terminate;
+    }
+
+    memcpy(assembled->data + assembled->received, (const __u8 *)data + sizeof(header), part_sz);
+    assembled->received += part_sz;
+    res = VIRGIL_OPERATION_OK;
+
+    if (assembled->received == assembled->frame_sz) {
+        *frame = assembled->data;
+        *frame_sz = assembled->frame_sz;
+        assembled->data = 0;
+        frame_drop(assembled);
+    }
+
+terminate:
+    mutex_unlock(&frames_mutex);
+
+    return res;
+}
+
+/******************************************************************************/
+void fragments_cleanup(void) {
+    fragmented_frame_t * frame, * tmp;
+
+    mutex_lock(&frames_mutex);
+    list_for_each_entry_safe(frame, tmp, &frames, list) {
+        frame_drop(frame);
+    }
+    mutex_unlock(&frames_mutex);
+}
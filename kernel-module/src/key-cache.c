@@ -0,0 +1,247 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file key-cache.c
+ * @brief Cache of keys loaded from key storage of user-space service (rcu-table.h).
+ * Removed keys are wiped after grace period. Cache is shrunk under memory pressure.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/rcupdate.h>
+#include <linux/jhash.h>
+#include <linux/shrinker.h>
+
+#include <virgil/kernel/key-storage.h>
+#include <virgil/kernel/private/log.h>
+#include <virgil/kernel/private/rcu-table.h>
+#include <virgil/kernel/private/key-cache.h>
+
+typedef struct {
+    rcu_table_node_t node;
+    __u32 sz;
+    char id[VIRGIL_KEYSTORAGE_ID_MAX_SIZE];
+    __u8 data[0];
+} key_entry_t;
+
+// Loaded key isn't cached if it could be changed while load request was processed
+static __u32 generation = 0;
+static unsigned int writes_in_progress = 0;
+
+static unsigned int key_cache_max = VIRGIL_KEY_CACHE_MAX;
+module_param(key_cache_max, uint, 0644);
+MODULE_PARM_DESC(key_cache_max, "Maximum count of keys cached in kernel (0 disables cache)");
+
+/******************************************************************************/
+static __u32 key_hash(const char * key_id) {
+    return jhash(key_id, strlen(key_id), 0);
+}
+
+/******************************************************************************/
+static bool entry_match(const rcu_table_node_t * node, const void * key_id) {
+    return 0 == strcmp(((const key_entry_t *)node)->id, key_id);
+}
+
+/******************************************************************************/
+static void entry_wipe(key_entry_t * entry) {
+    memzero_explicit(entry, sizeof(*entry) + entry->sz);
+    kfree(entry);
+}
+
+/******************************************************************************/
+static void entry_free_rcu(struct rcu_head * rcu) {
+    entry_wipe(container_of(rcu, key_entry_t, node.rcu));
+}
+
+// Changes of keys, generation and writes are done under lock of table
+DEFINE_RCU_TABLE(keys, VIRGIL_KEY_CACHE_HASH_BITS, entry_match, entry_free_rcu);
+
+/******************************************************************************/
+static unsigned long cache_count(struct shrinker * shrinker, struct shrink_control * sc) {
+    return rcu_table_count(&keys);
+}
+
+/******************************************************************************/
+static unsigned long cache_scan(struct shrinker * shrinker, struct shrink_control * sc) {
+    unsigned long freed;
+
+    spin_lock_bh(&keys.lock);
+    freed = rcu_table_evict_locked(&keys, sc->nr_to_scan);
+    spin_unlock_bh(&keys.lock);
+
+    return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker cache_shrinker = {
+        .count_objects = cache_count,
+        .scan_objects = cache_scan,
+        .seeks = DEFAULT_SEEKS
+};
+
+/******************************************************************************/
+int key_cache_get(const char * key_id, data_t * key, gfp_t gfp) {
+    key_entry_t * entry;
+    __u8 * buf;
+    __u32 hash;
+    int res = VIRGIL_OPERATION_UNAVAILABLE;
+
+    if (!key_id || !key) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    if (!rcu_table_count(&keys)) {
+        return VIRGIL_OPERATION_UNAVAILABLE;
+    }
+
+    // Size is unknown before lookup, buffer of maximum size is allocated out of RCU section
+    buf = kmalloc(VIRGIL_KEYSTORAGE_PERMANENT_KEY_MAX_SIZE, gfp);
+    if (!buf) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    hash = key_hash(key_id);
+
+    rcu_read_lock();
+    entry = (key_entry_t *)rcu_table_find(&keys, key_id, hash);
+    if (entry) {
+        memcpy(buf, entry->data, entry->sz);
+        key->sz = entry->sz;
+        rcu_table_touch(&entry->node);
+        res = VIRGIL_OPERATION_OK;
+    }
+    rcu_read_unlock();
+
+    if (VIRGIL_OPERATION_OK != res) {
+        kfree(buf);
+        return res;
+    }
+
+    key->data = buf;
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+__u32 key_cache_generation(void) {
+    return ACCESS_ONCE(generation);
+}
+
+/******************************************************************************/
+void key_cache_add(const char * key_id, data_t key, __u32 key_generation) {
+    key_entry_t * entry;
+    size_t id_sz;
+
+    if (!key_id || !key.data || !key.sz || key.sz > VIRGIL_KEYSTORAGE_PERMANENT_KEY_MAX_SIZE
+            || !ACCESS_ONCE(key_cache_max)) {
+        return;
+    }
+
+    id_sz = strnlen(key_id, VIRGIL_KEYSTORAGE_ID_MAX_SIZE);
+    if (id_sz >= VIRGIL_KEYSTORAGE_ID_MAX_SIZE) {
+        return;
+    }
+
+    entry = kzalloc(sizeof(*entry) + key.sz, GFP_KERNEL);
+    if (!entry) {
+        return;
+    }
+
+    entry->node.hash = key_hash(key_id);
+    entry->sz = key.sz;
+    memcpy(entry->id, key_id, id_sz);
+    memcpy(entry->data, key.data, key.sz);
+
+    spin_lock_bh(&keys.lock);
+
+    if (writes_in_progress || key_generation != generation) {
+        spin_unlock_bh(&keys.lock);
+        entry_wipe(entry);
+        return;
+    }
+
+    rcu_table_insert_locked(&keys, &entry->node, key_id, key_cache_max);
+
+    spin_unlock_bh(&keys.lock);
+}
+
+/******************************************************************************/
+void key_cache_write_begin(const char * key_id) {
+    rcu_table_node_t * node;
+
+    spin_lock_bh(&keys.lock);
+
+    writes_in_progress++;
+    generation++;
+
+    if (key_id) {
+        node = rcu_table_find(&keys, key_id, key_hash(key_id));
+        if (node) {
+            rcu_table_remove_locked(&keys, node);
+        }
+    }
+
+    spin_unlock_bh(&keys.lock);
+}
+
+/******************************************************************************/
+void key_cache_write_end(void) {
+    spin_lock_bh(&keys.lock);
+    if (writes_in_progress) {
+        writes_in_progress--;
+    }
+    generation++;
+    spin_unlock_bh(&keys.lock);
+}
+
+/******************************************************************************/
+int key_cache_init(void) {
+    if (register_shrinker(&cache_shrinker)) {
+        LOG("ERROR: Can't register shrinker of key cache");
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+void key_cache_cleanup(void) {
+    unregister_shrinker(&cache_shrinker);
+
+    // Removed entries are wiped before module is unloaded
+    rcu_table_destroy(&keys);
+}
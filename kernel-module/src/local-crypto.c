@@ -0,0 +1,156 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file local-crypto.c
+ * @brief Crypto operations which are done in kernel (kernel crypto API) without user-space service.
+ */
+
+#include <linux/module.h>
+#include <linux/err.h>
+#include <crypto/hash.h>
+
+#include <virgil/kernel/crypto.h>
+#include <virgil/kernel/private/log.h>
+#include <virgil/kernel/private/local-crypto.h>
+
+#define HASH_CHUNK_SZ   256     /**< Size of chunk for hashing of non-linear data */
+
+// Index is identifier of hash function (HASH_xxx)
+static const char * hash_names[] = {
+        "sha256",       // HASH_SHA256
+        "sha384",       // HASH_SHA384
+        "sha512",       // HASH_SHA512
+        "md5"           // HASH_MD5
+};
+
+// Transforms are shared, state of hashing is kept in descriptor
+static struct crypto_shash * hash_tfm[ARRAY_SIZE(hash_names)];
+
+/******************************************************************************/
+void local_crypto_init(void) {
+    struct crypto_shash * tfm;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(hash_names); ++i) {
+        tfm = crypto_alloc_shash(hash_names[i], 0, 0);
+        if (IS_ERR(tfm)) {
+            LOG("Hash %s isn't available in kernel", hash_names[i]);
+            continue;
+        }
+
+        if (crypto_shash_digestsize(tfm) > VIRGIL_LOCAL_DIGEST_MAX) {
+            crypto_free_shash(tfm);
+            continue;
+        }
+
+        hash_tfm[i] = tfm;
+    }
+}
+
+/******************************************************************************/
+void local_crypto_cleanup(void) {
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(hash_tfm); ++i) {
+        if (hash_tfm[i]) {
+            crypto_free_shash(hash_tfm[i]);
+            hash_tfm[i] = 0;
+        }
+    }
+}
+
+/******************************************************************************/
+/* Non-linear data is hashed by chunks */
+static int hash_update_sg(struct shash_desc * desc, const struct package_field_t * data_field) {
+    __u8 chunk[HASH_CHUNK_SZ];
+    __u32 pos, len;
+    int res = 0;
+
+    for (pos = 0; pos < data_field->data_sz && !res; pos += len) {
+        len = min_t(__u32, sizeof(chunk), data_field->data_sz - pos);
+        fields_data_read(data_field, pos, chunk, len);
+        res = crypto_shash_update(desc, chunk, len);
+    }
+
+    return res;
+}
+
+/******************************************************************************/
+static int hash_digest(struct crypto_shash * tfm, const struct package_field_t * data_field, __u8 * digest) {
+    SHASH_DESC_ON_STACK(desc, tfm);
+    int res;
+
+    desc->tfm = tfm;
+    desc->flags = 0;
+
+    if (!(data_field->type & VIRGIL_FIELD_FLAG_SG)) {
+        return crypto_shash_digest(desc, data_field->data.p, data_field->data_sz, digest);
+    }
+
+    res = crypto_shash_init(desc);
+    if (!res) {
+        res = hash_update_sg(desc, data_field);
+    }
+    if (!res) {
+        res = crypto_shash_final(desc, digest);
+    }
+
+    return res;
+}
+
+/******************************************************************************/
+int local_hash(__u8 hash_type, const struct package_field_t * data_field,
+        __u8 * digest, __u32 * digest_sz) {
+    struct crypto_shash * tfm;
+
+    if (!data_field || !digest || !digest_sz) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    tfm = hash_type < ARRAY_SIZE(hash_tfm) ? hash_tfm[hash_type] : 0;
+    if (!tfm) {
+        return VIRGIL_OPERATION_UNAVAILABLE;
+    }
+
+    if (hash_digest(tfm, data_field, digest)) {
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    *digest_sz = crypto_shash_digestsize(tfm);
+
+    return VIRGIL_OPERATION_OK;
+}
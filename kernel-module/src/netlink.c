@@ -51,51 +51,72 @@
 
 #include <virgil/kernel/private/log.h>
 #include <virgil/kernel/private/netlink.h>
+#include <virgil/kernel/private/ports.h>
 
 #define VIRGIL_NETLINK 27
 
 static struct sock *netlink_sock = 0;
 static netlink_processor_cb data_processor = 0;
-static int user_space_pid = -1;
 
 #if !defined(VIRGIL_NETLINK_DEBUG)
 //#define VIRGIL_NETLINK_DEBUG
 #endif
 
-/******************************************************************************/
-bool netlink_is_valid(void) {
-    return (0 < user_space_pid);
-}
-
 /******************************************************************************/
 static void netlink_data_ready(struct sk_buff * buffer) {
     struct nlmsghdr *nlh = NULL;
     int data_sz = -1;
+    int remaining;
+    __u32 portid;
 
     if (!buffer) {
         return;
     }
 
+    // Port of sender is set by kernel, nlmsg_pid of message can be forged
+    portid = NETLINK_CB(buffer).portid;
+    if (!portid || VIRGIL_PORT_IS_RING(portid)) {
+        return;
+    }
+
+    // Datagram can contain a batch of messages
     nlh = (struct nlmsghdr *) buffer->data;
+    remaining = buffer->len;
 
-    data_sz = NLMSG_PAYLOAD(nlh, 0);
+    for (; nlmsg_ok(nlh, remaining); nlh = nlmsg_next(nlh, &remaining)) {
+        data_sz = NLMSG_PAYLOAD(nlh, 0);
 
 #if defined(VIRGIL_NETLINK_DEBUG)
-    LOG("received netlink message payload (%d bytes) from %d", data_sz, user_space_pid);
+        LOG("received netlink message payload (%d bytes) from %d", data_sz, (int)portid);
 #endif
 
-    if (data_sz <= 0 || data_sz > (7 * 1024)) {
-        //LOG("ERROR: Wrong package size. Package has been dropped.  Type : 0x%x \n", (int)nlh->nlmsg_type);
-        return;
+        if (data_sz <= 0 || data_sz > VIRGIL_MESSAGE_SZ_MAX) {
+            //LOG("ERROR: Wrong package size. Package has been dropped.  Type : 0x%x \n", (int)nlh->nlmsg_type);
+            continue;
+        }
+
+        if (data_processor) {
+            (*data_processor)(portid, NLMSG_DATA(nlh), data_sz, buffer);
+        }
     }
+}
 
-    user_space_pid = nlh->nlmsg_pid;
+/******************************************************************************/
+/* Socket of worker has been closed */
+static int netlink_release_event(struct notifier_block * nb, unsigned long event, void * ptr) {
+    struct netlink_notify * notify = ptr;
 
-    if (data_processor) {
-        (*data_processor)(NLMSG_DATA(nlh), data_sz);
+    if (NETLINK_URELEASE == event && notify && VIRGIL_NETLINK == notify->protocol) {
+        ports_remove(notify->portid);
     }
+
+    return NOTIFY_DONE;
 }
 
+static struct notifier_block netlink_release_notifier = {
+    .notifier_call = netlink_release_event,
+};
+
 /******************************************************************************/
 void netlink_start(void) {
 #if 0
@@ -110,12 +131,18 @@ void netlink_start(void) {
 
     if (!netlink_sock) {
         LOG("ERROR: can't create socket.");
+        return;
     }
+
+    netlink_register_notifier(&netlink_release_notifier);
 }
 
 /******************************************************************************/
 void netlink_stop(void) {
     LOG("netlink stop");
+    if (netlink_sock) {
+        netlink_unregister_notifier(&netlink_release_notifier);
+    }
     if (netlink_sock && netlink_sock->sk_socket) {
         sock_release(netlink_sock->sk_socket);
     }
@@ -127,29 +154,77 @@ void netlink_set_processor(netlink_processor_cb processor) {
 }
 
 /******************************************************************************/
-bool netlink_send(const void * data, __u32 data_sz) {
-	struct nlmsghdr *nlh;
+struct sk_buff * netlink_batch_alloc(gfp_t gfp) {
     struct sk_buff * skb_out;
 
-    if (!data || !data_sz || !netlink_is_valid()) return false;
+    skb_out = nlmsg_new(VIRGIL_BATCH_SZ_MAX, gfp);
+    if (!skb_out) {
+        LOG("ERROR: Can't send data (no memory)");
+        return 0;
+    }
 
-#if defined(VIRGIL_NETLINK_DEBUG)
-    LOG("netlink send : %lu", (long unsigned int) data_sz);
-#endif
+    NETLINK_CB(skb_out).dst_group = 0;
+
+    return skb_out;
+}
+
+/******************************************************************************/
+void * netlink_frame_append(struct sk_buff * skb, __u32 data_sz) {
+    struct nlmsghdr *nlh;
 
-    skb_out = nlmsg_new(NLMSG_DEFAULT_SIZE, GFP_KERNEL);
+    if (!skb || !data_sz) return 0;
+
+    nlh = nlmsg_put(skb, 0, 0, NLM_F_REQUEST, data_sz, 0);
+
+    return nlh ? NLMSG_DATA(nlh) : 0;
+}
+
+/******************************************************************************/
+struct sk_buff * netlink_frame_alloc(__u32 data_sz, gfp_t gfp, void ** data) {
+    struct sk_buff * skb_out;
+
+    if (!data || !data_sz) return 0;
+
+    skb_out = nlmsg_new(data_sz, gfp);
     if (!skb_out) {
         LOG("ERROR: Can't send data (no memory)");
-        return false;
+        return 0;
     }
 
-    nlh = nlmsg_put(skb_out, 0, 0, NLM_F_REQUEST, data_sz, 0);
     NETLINK_CB(skb_out).dst_group = 0;
-    memcpy(NLMSG_DATA(nlh), data, data_sz);
-    if (0 != nlmsg_unicast(netlink_sock, skb_out, user_space_pid)) {
-    	LOG("Netlink Error (send)");
-    	user_space_pid = -1;
-    	return false;
+
+    *data = netlink_frame_append(skb_out, data_sz);
+    if (!*data) {
+        kfree_skb(skb_out);
+        return 0;
+    }
+
+    return skb_out;
+}
+
+/******************************************************************************/
+bool netlink_frame_send(struct sk_buff * skb, __u32 pid) {
+    int res;
+
+    if (!skb) return false;
+
+    if (VIRGIL_PORT_NONE == pid || VIRGIL_PORT_IS_RING(pid) || !netlink_sock) {
+        kfree_skb(skb);
+        return false;
+    }
+
+#if defined(VIRGIL_NETLINK_DEBUG)
+    LOG("netlink send : %lu to %u", (long unsigned int) skb->len, pid);
+#endif
+
+    // skb is consumed in any case
+    res = nlmsg_unicast(netlink_sock, skb, pid);
+    if (0 != res) {
+        LOG("Netlink Error (send)");
+        if (-ECONNREFUSED == res) {
+            ports_remove(pid);
+        }
+        return false;
     }
     return true;
 }
@@ -0,0 +1,401 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file ports.c
+ * @brief Registry of user-space service workers.
+ */
+
+#include <linux/module.h>
+#include <linux/spinlock.h>
+#include <linux/slab.h>
+#include <linux/rcupdate.h>
+#include <linux/atomic.h>
+
+#include <virgil/kernel/private/log.h>
+#include <virgil/kernel/private/ports.h>
+
+typedef struct {
+    __u32 port;
+    atomic_t outstanding;
+    atomic_t class_outstanding[VIRGIL_PRIORITY_CLASSES];
+    atomic_t load;
+    struct rcu_head rcu;
+} worker_t;
+
+// Workers are kept in order of registration, so the first one is primary.
+// Table is replaced on registration changes and read without locks.
+typedef struct {
+    int count;
+    worker_t * ar[VIRGIL_PORTS_MAX];
+    struct rcu_head rcu;
+} workers_t;
+
+static unsigned int window = VIRGIL_PORT_WINDOW;
+module_param(window, uint, 0644);
+MODULE_PARM_DESC(window, "Maximum count of outstanding requests of one worker");
+
+static unsigned int window_normal = VIRGIL_PORT_WINDOW_NORMAL;
+module_param(window_normal, uint, 0644);
+MODULE_PARM_DESC(window_normal, "Maximum count of outstanding requests of normal priority class of one worker");
+
+static unsigned int window_bulk = VIRGIL_PORT_WINDOW_BULK;
+module_param(window_bulk, uint, 0644);
+MODULE_PARM_DESC(window_bulk, "Maximum count of outstanding requests of bulk priority class of one worker");
+
+// Protects replacement of table of workers
+static DEFINE_SPINLOCK(ports_lock);
+
+static workers_t __rcu * workers = 0;
+static ports_event_cb event_listener = 0;
+
+/******************************************************************************/
+void ports_set_listener(ports_event_cb listener) {
+    event_listener = listener;
+}
+
+/******************************************************************************/
+static void notify(__u32 port, bool added) {
+    ports_event_cb listener = ACCESS_ONCE(event_listener);
+
+    if (listener) {
+        (*listener)(port, added);
+    }
+}
+
+/******************************************************************************/
+static int worker_pos(const workers_t * table, __u32 port) {
+    int i;
+
+    for (i = 0; table && i < table->count; ++i) {
+        if (table->ar[i]->port == port) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/******************************************************************************/
+/* Must be called under rcu_read_lock */
+static worker_t * worker_find(__u32 port) {
+    workers_t * table = rcu_dereference(workers);
+    int pos = worker_pos(table, port);
+
+    return pos >= 0 ? table->ar[pos] : 0;
+}
+
+/******************************************************************************/
+void ports_add(__u32 port) {
+    workers_t * table;
+    workers_t * old;
+    worker_t * worker;
+    bool added = false;
+
+    if (VIRGIL_PORT_NONE == port) return;
+
+    // Allocation is done in advance, because registration happens rarely
+    table = kzalloc(sizeof(*table), GFP_ATOMIC);
+    worker = kzalloc(sizeof(*worker), GFP_ATOMIC);
+    if (!table || !worker) {
+        LOG("ERROR: No memory for worker 0x%x", port);
+        kfree(table);
+        kfree(worker);
+        return;
+    }
+    worker->port = port;
+
+    spin_lock_bh(&ports_lock);
+    old = rcu_dereference_protected(workers, lockdep_is_held(&ports_lock));
+    if (worker_pos(old, port) < 0) {
+        if (!old || old->count < VIRGIL_PORTS_MAX) {
+            if (old) {
+                memcpy(table->ar, old->ar, old->count * sizeof(worker_t *));
+                table->count = old->count;
+            }
+            table->ar[table->count++] = worker;
+            rcu_assign_pointer(workers, table);
+            added = true;
+        } else {
+            LOG("ERROR: Too many workers. Worker 0x%x is ignored", port);
+        }
+    }
+    spin_unlock_bh(&ports_lock);
+
+    if (!added) {
+        kfree(table);
+        kfree(worker);
+        return;
+    }
+
+    if (old) {
+        kfree_rcu(old, rcu);
+    }
+
+    LOG("Worker 0x%x is registered", port);
+    notify(port, true);
+}
+
+/******************************************************************************/
+void ports_remove(__u32 port) {
+    workers_t * table;
+    workers_t * old;
+    worker_t * worker = 0;
+    int pos;
+
+    table = kzalloc(sizeof(*table), GFP_ATOMIC);
+    if (!table) {
+        LOG("ERROR: No memory for unregistration of worker 0x%x", port);
+        return;
+    }
+
+    spin_lock_bh(&ports_lock);
+    old = rcu_dereference_protected(workers, lockdep_is_held(&ports_lock));
+    pos = worker_pos(old, port);
+    if (pos >= 0) {
+        worker = old->ar[pos];
+        memcpy(table->ar, old->ar, pos * sizeof(worker_t *));
+        memcpy(table->ar + pos, old->ar + pos + 1, (old->count - pos - 1) * sizeof(worker_t *));
+        table->count = old->count - 1;
+        rcu_assign_pointer(workers, table);
+    }
+    spin_unlock_bh(&ports_lock);
+
+    if (!worker) {
+        kfree(table);
+        return;
+    }
+
+    kfree_rcu(old, rcu);
+    kfree_rcu(worker, rcu);
+
+    LOG("Worker 0x%x is unregistered", port);
+    notify(port, false);
+}
+
+/******************************************************************************/
+void ports_cleanup(void) {
+    workers_t * old;
+    int i;
+
+    spin_lock_bh(&ports_lock);
+    old = rcu_dereference_protected(workers, lockdep_is_held(&ports_lock));
+    RCU_INIT_POINTER(workers, 0);
+    spin_unlock_bh(&ports_lock);
+
+    if (!old) return;
+
+    synchronize_rcu();
+
+    for (i = 0; i < old->count; ++i) {
+        kfree(old->ar[i]);
+    }
+    kfree(old);
+}
+
+/******************************************************************************/
+/* Share of window which can be used by priority class */
+static __u32 class_window(__u8 priority) {
+    switch (priority) {
+    case VIRGIL_PRIORITY_NORMAL:
+        return ACCESS_ONCE(window_normal);
+    case VIRGIL_PRIORITY_BULK:
+        return ACCESS_ONCE(window_bulk);
+    }
+
+    return ACCESS_ONCE(window);
+}
+
+/******************************************************************************/
+/* Queue depth of worker after which it doesn't receive requests of priority class */
+static __u32 class_load_limit(__u8 priority) {
+    return VIRGIL_PRIORITY_CRITICAL == priority ? VIRGIL_PORT_LOAD_MAX : VIRGIL_PORT_LOAD_THROTTLE;
+}
+
+/******************************************************************************/
+static bool has_room(worker_t * worker, __u8 priority) {
+    return (__u32)atomic_read(&worker->outstanding) < ACCESS_ONCE(window)
+            && (__u32)atomic_read(&worker->class_outstanding[priority]) < class_window(priority)
+            && (__u32)atomic_read(&worker->load) < class_load_limit(priority);
+}
+
+/******************************************************************************/
+/* Take room in window of worker. Counter is incremented before check, so window can't be exceeded by concurrent callers. */
+static bool worker_get(worker_t * worker, __u8 priority) {
+    if ((__u32)atomic_read(&worker->load) >= class_load_limit(priority)) {
+        return false;
+    }
+
+    if ((__u32)atomic_inc_return(&worker->class_outstanding[priority]) > class_window(priority)) {
+        atomic_dec(&worker->class_outstanding[priority]);
+        return false;
+    }
+
+    if ((__u32)atomic_inc_return(&worker->outstanding) > ACCESS_ONCE(window)) {
+        atomic_dec(&worker->outstanding);
+        atomic_dec(&worker->class_outstanding[priority]);
+        return false;
+    }
+
+    return true;
+}
+
+/******************************************************************************/
+__u32 ports_acquire(bool primary, __u8 priority) {
+    __u32 res = VIRGIL_PORT_NONE;
+    __u32 tried = 0;
+    workers_t * table;
+    worker_t * worker;
+    int i, best, count;
+
+    if (priority >= VIRGIL_PRIORITY_CLASSES) return VIRGIL_PORT_NONE;
+
+    rcu_read_lock();
+    table = rcu_dereference(workers);
+    count = table ? table->count : 0;
+    if (primary) {
+        count = min(count, 1);
+    }
+
+    // Least loaded worker is taken. Next one is tried if concurrent caller has taken the last room.
+    do {
+        best = -1;
+        for (i = 0; i < count; ++i) {
+            worker = table->ar[i];
+            if (!(tried & (1 << i)) && has_room(worker, priority)
+                    && (best < 0 || atomic_read(&worker->outstanding) < atomic_read(&table->ar[best]->outstanding))) {
+                best = i;
+            }
+        }
+
+        if (best >= 0) {
+            tried |= 1 << best;
+            if (worker_get(table->ar[best], priority)) {
+                res = table->ar[best]->port;
+            }
+        }
+    } while (best >= 0 && VIRGIL_PORT_NONE == res);
+    rcu_read_unlock();
+
+    return res;
+}
+
+/******************************************************************************/
+bool ports_get(__u32 port, __u8 priority) {
+    worker_t * worker;
+    bool res;
+
+    if (priority >= VIRGIL_PRIORITY_CLASSES) return false;
+
+    rcu_read_lock();
+    worker = worker_find(port);
+    res = worker && worker_get(worker, priority);
+    rcu_read_unlock();
+
+    return res;
+}
+
+/******************************************************************************/
+void ports_release(__u32 port, __u8 priority) {
+    worker_t * worker;
+
+    if (VIRGIL_PORT_NONE == port || priority >= VIRGIL_PRIORITY_CLASSES) return;
+
+    rcu_read_lock();
+    worker = worker_find(port);
+    if (worker) {
+        atomic_add_unless(&worker->outstanding, -1, 0);
+        atomic_add_unless(&worker->class_outstanding[priority], -1, 0);
+    }
+    rcu_read_unlock();
+}
+
+/******************************************************************************/
+bool ports_set_load(__u32 port, __u32 load) {
+    worker_t * worker;
+    bool res = false;
+
+    rcu_read_lock();
+    worker = worker_find(port);
+    if (worker) {
+        res = load < (__u32)atomic_xchg(&worker->load, load);
+    }
+    rcu_read_unlock();
+
+    return res;
+}
+
+/******************************************************************************/
+bool ports_contains(__u32 port) {
+    bool res;
+
+    rcu_read_lock();
+    res = 0 != worker_find(port);
+    rcu_read_unlock();
+
+    return res;
+}
+
+/******************************************************************************/
+int ports_count(void) {
+    workers_t * table;
+    int res;
+
+    rcu_read_lock();
+    table = rcu_dereference(workers);
+    res = table ? table->count : 0;
+    rcu_read_unlock();
+
+    return res;
+}
+
+/******************************************************************************/
+int ports_list(__u32 * list, int max) {
+    workers_t * table;
+    int i, res;
+
+    if (!list) return 0;
+
+    rcu_read_lock();
+    table = rcu_dereference(workers);
+    res = table ? min(max, table->count) : 0;
+    for (i = 0; i < res; ++i) {
+        list[i] = table->ar[i]->port;
+    }
+    rcu_read_unlock();
+
+    return res;
+}
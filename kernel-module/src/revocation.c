@@ -0,0 +1,268 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file revocation.c
+ * @brief Revocation checks in kernel.
+ * Revocation set is replaced under RCU, old set is freed after grace period. Known certificates
+ * are kept in table (rcu-table.h).
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/bsearch.h>
+#include <linux/atomic.h>
+
+#include <virgil/kernel/private/log.h>
+#include <virgil/kernel/private/rcu-table.h>
+#include <virgil/kernel/private/revocation.h>
+
+typedef struct {
+    __u64 version;
+    __u32 filter_bits;
+    __u32 ids_count;
+    __u8 hashes;
+    bool is_complete;
+    const __u8 * ids;                   // sorted ids (after filter)
+    __u8 filter[0];
+} revocation_set_t;
+
+typedef struct {
+    rcu_table_node_t node;
+    __u8 cert_digest[VIRGIL_REVOCATION_DIGEST_SZ];
+    __u8 id[VIRGIL_REVOCATION_DIGEST_SZ];
+} cert_entry_t;
+
+static revocation_set_t __rcu * revocation_set = 0;
+static DEFINE_MUTEX(set_lock);
+static atomic_t version_reset = ATOMIC_INIT(0);
+
+/******************************************************************************/
+static __u32 word_le(const __u8 * p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((__u32)p[3] << 24);
+}
+
+/******************************************************************************/
+static bool filter_test(const revocation_set_t * set, const __u8 * id) {
+    __u32 bit;
+    int i;
+
+    for (i = 0; i < set->hashes; ++i) {
+        bit = word_le(id + i * sizeof(__u32)) & (set->filter_bits - 1);
+        if (!(set->filter[bit >> 3] & (1 << (bit & 7)))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/******************************************************************************/
+static int id_cmp(const void * key, const void * elt) {
+    return memcmp(key, elt, VIRGIL_REVOCATION_DIGEST_SZ);
+}
+
+/******************************************************************************/
+static bool cert_match(const rcu_table_node_t * node, const void * cert_digest) {
+    return 0 == memcmp(((const cert_entry_t *)node)->cert_digest, cert_digest, VIRGIL_REVOCATION_DIGEST_SZ);
+}
+
+DEFINE_RCU_TABLE(certs, VIRGIL_REVOCATION_CERTS_HASH_BITS, cert_match, 0);
+
+/******************************************************************************/
+/* Set is built by service, it's checked before use */
+static revocation_set_t * set_create(const __u8 * data, __u32 data_sz) {
+    revocation_set_header_t header;
+    revocation_set_t * set;
+    __u32 filter_sz, ids_sz, i;
+    const __u8 * ids;
+
+    if (data_sz < sizeof(header)) {
+        return 0;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (!header.version
+            || header.filter_bits < 8 || header.filter_bits > VIRGIL_REVOCATION_FILTER_BITS_MAX
+            || (header.filter_bits & (header.filter_bits - 1))
+            || !header.hashes || header.hashes > VIRGIL_REVOCATION_HASHES_MAX
+            || header.ids_count > VIRGIL_REVOCATION_IDS_MAX) {
+        return 0;
+    }
+
+    filter_sz = header.filter_bits / 8;
+    ids_sz = header.ids_count * VIRGIL_REVOCATION_DIGEST_SZ;
+    if (data_sz != sizeof(header) + filter_sz + ids_sz) {
+        return 0;
+    }
+
+    // Exact set is searched with binary search
+    ids = data + sizeof(header) + filter_sz;
+    for (i = 1; i < header.ids_count; ++i) {
+        if (id_cmp(ids + i * VIRGIL_REVOCATION_DIGEST_SZ, ids + (i - 1) * VIRGIL_REVOCATION_DIGEST_SZ) <= 0) {
+            return 0;
+        }
+    }
+
+    set = vmalloc(sizeof(*set) + filter_sz + ids_sz);
+    if (!set) {
+        return 0;
+    }
+
+    set->version = header.version;
+    set->filter_bits = header.filter_bits;
+    set->ids_count = header.ids_count;
+    set->hashes = header.hashes;
+    set->is_complete = !!header.is_complete;
+    memcpy(set->filter, data + sizeof(header), filter_sz + ids_sz);
+    set->ids = set->filter + filter_sz;
+
+    return set;
+}
+
+/******************************************************************************/
+int revocation_update(fields_t fields) {
+    struct package_field_t * res_fields[1] = { 0 };
+    __u16 res_cnt = 0;
+    revocation_set_t * set;
+    revocation_set_t * old;
+
+    // Notice without set is sent before CRL is received
+    fields_by_type(VIRGIL_FIELD_DATA, fields, 1, &res_cnt, res_fields);
+    if (!res_cnt) {
+        return VIRGIL_OPERATION_OK;
+    }
+
+    set = set_create(res_fields[0]->data.p, res_fields[0]->data_sz);
+    if (!set) {
+        LOG("ERROR: Wrong revocation set");
+        return VIRGIL_OPERATION_ERROR;
+    }
+
+    mutex_lock(&set_lock);
+    old = rcu_dereference_protected(revocation_set, lockdep_is_held(&set_lock));
+
+    // Workers receive CRL at different time, the newest set is used.
+    // Order is reset on registration of worker, so wrong version doesn't block sets until reload.
+    if (old && !atomic_xchg(&version_reset, 0) && old->version > set->version) {
+        mutex_unlock(&set_lock);
+        vfree(set);
+        return VIRGIL_OPERATION_OK;
+    }
+
+    rcu_assign_pointer(revocation_set, set);
+    mutex_unlock(&set_lock);
+
+    if (old) {
+        synchronize_rcu();
+        vfree(old);
+    }
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+void revocation_reset_version(void) {
+    atomic_set(&version_reset, 1);
+}
+
+/******************************************************************************/
+int revocation_check(const __u8 * cert_digest, bool * is_revoked) {
+    revocation_set_t * set;
+    cert_entry_t * entry;
+    int res = VIRGIL_OPERATION_UNAVAILABLE;
+
+    rcu_read_lock();
+
+    set = rcu_dereference(revocation_set);
+    entry = set ? (cert_entry_t *)rcu_table_find(&certs, cert_digest, rcu_table_digest_hash(cert_digest)) : 0;
+
+    if (entry) {
+        if (!filter_test(set, entry->id)) {
+            *is_revoked = false;
+            res = VIRGIL_OPERATION_OK;
+        } else if (bsearch(entry->id, set->ids, set->ids_count, VIRGIL_REVOCATION_DIGEST_SZ, id_cmp)) {
+            *is_revoked = true;
+            res = VIRGIL_OPERATION_OK;
+        } else if (set->is_complete) {
+            *is_revoked = false;
+            res = VIRGIL_OPERATION_OK;
+        }
+    }
+
+    rcu_read_unlock();
+
+    return res;
+}
+
+/******************************************************************************/
+void revocation_learn(const __u8 * cert_digest, const __u8 * id) {
+    cert_entry_t * entry;
+
+    entry = kmalloc(sizeof(*entry), GFP_KERNEL);
+    if (!entry) {
+        return;
+    }
+
+    entry->node.hash = rcu_table_digest_hash(cert_digest);
+    memcpy(entry->cert_digest, cert_digest, VIRGIL_REVOCATION_DIGEST_SZ);
+    memcpy(entry->id, id, VIRGIL_REVOCATION_DIGEST_SZ);
+
+    spin_lock_bh(&certs.lock);
+    rcu_table_insert_locked(&certs, &entry->node, cert_digest, VIRGIL_REVOCATION_CERTS_MAX);
+    spin_unlock_bh(&certs.lock);
+}
+
+/******************************************************************************/
+void revocation_cleanup(void) {
+    revocation_set_t * old;
+
+    rcu_table_destroy(&certs);
+
+    mutex_lock(&set_lock);
+    old = rcu_dereference_protected(revocation_set, lockdep_is_held(&set_lock));
+    RCU_INIT_POINTER(revocation_set, 0);
+    mutex_unlock(&set_lock);
+
+    if (old) {
+        synchronize_rcu();
+        vfree(old);
+    }
+}
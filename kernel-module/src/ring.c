@@ -0,0 +1,382 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file ring.c
+ * @brief Communication through shared memory rings of character device.
+ * Every opening of device creates separate ring instance, so each worker of service has its own rings.
+ * Open device doesn't hold module. On stop workers get hang-up from poll and module waits
+ * until all rings are closed, so memory isn't freed while it's mapped.
+ */
+
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/miscdevice.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/spinlock.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+
+#include <virgil/kernel/private/log.h>
+#include <virgil/kernel/private/ports.h>
+#include <virgil/kernel/private/ring.h>
+
+#define RING_MASK (VIRGIL_RING_SLOTS_CNT - 1)
+
+typedef struct {
+    spinlock_t lock;                    /**< protects submission ring */
+    struct mutex drain_mutex;           /**< serializes processing of completion ring */
+    wait_queue_head_t wait;             /**< poll waiters */
+    void * mem;                         /**< shared memory */
+    bool mapped;                        /**< memory is mapped by worker */
+    bool opened;                        /**< instance is used */
+} ring_t;
+
+static DEFINE_SPINLOCK(rings_lock);
+static ring_t rings[VIRGIL_RING_INSTANCES_MAX];
+static bool ring_registered = false;
+static bool rings_stopping = false;     /**< rings are being closed, protected by rings_lock */
+static DECLARE_WAIT_QUEUE_HEAD(closed_wait);
+static ring_processor_cb data_processor = 0;
+
+/******************************************************************************/
+static virgil_ring_header_t * ring_header(ring_t * ring) {
+    return (virgil_ring_header_t *) ring->mem;
+}
+
+/******************************************************************************/
+static __u8 * sq_slot(ring_t * ring, __u32 idx) {
+    return (__u8 *) ring->mem + VIRGIL_RING_HEADER_SZ + (idx & RING_MASK) * VIRGIL_RING_SLOT_SZ;
+}
+
+/******************************************************************************/
+static __u8 * cq_slot(ring_t * ring, __u32 idx) {
+    return sq_slot(ring, 0) + (VIRGIL_RING_SLOTS_CNT + (idx & RING_MASK)) * VIRGIL_RING_SLOT_SZ;
+}
+
+/******************************************************************************/
+static ring_t * ring_by_port(__u32 port) {
+    if (!VIRGIL_PORT_IS_RING(port) || VIRGIL_PORT_RING_IDX(port) >= VIRGIL_RING_INSTANCES_MAX) {
+        return 0;
+    }
+
+    return &rings[VIRGIL_PORT_RING_IDX(port)];
+}
+
+/******************************************************************************/
+void * ring_frame_reserve(__u32 port, __u32 data_sz) {
+    virgil_ring_header_t * header;
+    ring_t * ring;
+
+    ring = ring_by_port(port);
+    if (!ring || !data_sz || data_sz > VIRGIL_RING_SLOT_SZ) {
+        return 0;
+    }
+
+    spin_lock_bh(&ring->lock);
+
+    header = ring_header(ring);
+    if (!ring->mapped || header->sq_tail - ACCESS_ONCE(header->sq_head) >= VIRGIL_RING_SLOTS_CNT) {
+        spin_unlock_bh(&ring->lock);
+        return 0;
+    }
+
+    return sq_slot(ring, header->sq_tail);
+}
+
+/******************************************************************************/
+void ring_frame_commit(__u32 port, __u32 data_sz) {
+    virgil_ring_header_t * header;
+    ring_t * ring;
+
+    ring = ring_by_port(port);
+    header = ring_header(ring);
+    header->sq_sizes[header->sq_tail & RING_MASK] = data_sz;
+
+    // Message must be visible before new tail
+    smp_wmb();
+    ACCESS_ONCE(header->sq_tail) = header->sq_tail + 1;
+
+    spin_unlock_bh(&ring->lock);
+
+    wake_up_interruptible(&ring->wait);
+}
+
+/******************************************************************************/
+/* Process all completions written by service */
+static void ring_drain(ring_t * ring) {
+    virgil_ring_header_t * header;
+    __u32 head, tail, data_sz;
+
+    mutex_lock(&ring->drain_mutex);
+
+    header = ring_header(ring);
+    head = header->cq_head;
+    tail = ACCESS_ONCE(header->cq_tail);
+
+    // Read messages only after tail
+    smp_rmb();
+
+    if (tail - head > VIRGIL_RING_SLOTS_CNT) {
+        LOG("ERROR: Wrong completion ring state");
+        tail = head;
+    }
+
+    for (; head != tail; ++head) {
+        data_sz = ACCESS_ONCE(header->cq_sizes[head & RING_MASK]);
+        if (data_sz && data_sz <= VIRGIL_RING_SLOT_SZ && data_processor) {
+            (*data_processor)(VIRGIL_PORT_RING(ring - rings), cq_slot(ring, head), data_sz);
+        }
+    }
+
+    // Slots are released after processing
+    smp_mb();
+    ACCESS_ONCE(header->cq_head) = head;
+
+    mutex_unlock(&ring->drain_mutex);
+}
+
+/******************************************************************************/
+static int ring_open(struct inode * inode, struct file * file) {
+    virgil_ring_header_t * header;
+    ring_t * ring = 0;
+    void * mem;
+    int i;
+
+    mem = vmalloc_user(VIRGIL_RING_MEM_SZ);
+    if (!mem) {
+        return -ENOMEM;
+    }
+
+    header = (virgil_ring_header_t *) mem;
+    header->magic = VIRGIL_RING_MAGIC;
+    header->version = VIRGIL_RING_VERSION;
+    header->slots_cnt = VIRGIL_RING_SLOTS_CNT;
+    header->slot_sz = VIRGIL_RING_SLOT_SZ;
+
+    spin_lock_bh(&rings_lock);
+    for (i = 0; i < VIRGIL_RING_INSTANCES_MAX && !rings_stopping; ++i) {
+        if (!rings[i].opened) {
+            ring = &rings[i];
+            ring->opened = true;
+            break;
+        }
+    }
+    spin_unlock_bh(&rings_lock);
+
+    if (!ring) {
+        vfree(mem);
+        return -EBUSY;
+    }
+
+    spin_lock_bh(&ring->lock);
+    ring->mem = mem;
+    ring->mapped = false;
+    spin_unlock_bh(&ring->lock);
+
+    file->private_data = ring;
+
+    return 0;
+}
+
+/******************************************************************************/
+static int ring_release(struct inode * inode, struct file * file) {
+    ring_t * ring = file->private_data;
+    void * mem;
+
+    ports_remove(VIRGIL_PORT_RING(ring - rings));
+
+    mutex_lock(&ring->drain_mutex);
+    spin_lock_bh(&ring->lock);
+    mem = ring->mem;
+    ring->mem = 0;
+    ring->mapped = false;
+    spin_unlock_bh(&ring->lock);
+    mutex_unlock(&ring->drain_mutex);
+
+    vfree(mem);
+
+    spin_lock_bh(&rings_lock);
+    ring->opened = false;
+    spin_unlock_bh(&rings_lock);
+
+    wake_up(&closed_wait);
+
+    LOG("Ring %d is closed", (int)(ring - rings));
+
+    return 0;
+}
+
+/******************************************************************************/
+static int ring_mmap(struct file * file, struct vm_area_struct * vma) {
+    ring_t * ring = file->private_data;
+    int res;
+
+    if (vma->vm_pgoff || vma->vm_end - vma->vm_start != VIRGIL_RING_MEM_SZ) {
+        return -EINVAL;
+    }
+
+    res = remap_vmalloc_range(vma, ring->mem, 0);
+    if (0 == res) {
+        spin_lock_bh(&ring->lock);
+        ring->mapped = true;
+        spin_unlock_bh(&ring->lock);
+
+        LOG("Ring %d is mapped", (int)(ring - rings));
+    }
+
+    return res;
+}
+
+/******************************************************************************/
+static unsigned int ring_poll(struct file * file, poll_table * wait) {
+    ring_t * ring = file->private_data;
+    virgil_ring_header_t * header;
+    unsigned int mask = 0;
+
+    poll_wait(file, &ring->wait, wait);
+
+    // Worker unmaps and closes rings on hang-up
+    if (ACCESS_ONCE(rings_stopping)) {
+        return POLLHUP | POLLERR;
+    }
+
+    header = ring_header(ring);
+    if (ACCESS_ONCE(header->sq_head) != ACCESS_ONCE(header->sq_tail)) {
+        mask |= POLLIN | POLLRDNORM;
+    }
+
+    return mask;
+}
+
+/******************************************************************************/
+static long ring_ioctl(struct file * file, unsigned int cmd, unsigned long arg) {
+    ring_t * ring = file->private_data;
+
+    if (VIRGIL_RING_IOC_NOTIFY != cmd) {
+        return -ENOTTY;
+    }
+
+    if (!ACCESS_ONCE(ring->mapped)) {
+        return -EINVAL;
+    }
+
+    ring_drain(ring);
+
+    return 0;
+}
+
+// Owner isn't set: service keeps rings for its whole life, ring_stop waits for their closing instead
+static const struct file_operations ring_fops = {
+    .open = ring_open,
+    .release = ring_release,
+    .mmap = ring_mmap,
+    .poll = ring_poll,
+    .unlocked_ioctl = ring_ioctl,
+};
+
+static struct miscdevice ring_device = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = VIRGIL_RING_DEVICE_NAME,
+    .fops = &ring_fops,
+};
+
+/******************************************************************************/
+void ring_set_processor(ring_processor_cb processor) {
+    data_processor = processor;
+}
+
+/******************************************************************************/
+int ring_start(void) {
+    int i;
+
+    LOG("ring start");
+
+    for (i = 0; i < VIRGIL_RING_INSTANCES_MAX; ++i) {
+        spin_lock_init(&rings[i].lock);
+        mutex_init(&rings[i].drain_mutex);
+        init_waitqueue_head(&rings[i].wait);
+    }
+    rings_stopping = false;
+
+    if (0 != misc_register(&ring_device)) {
+        LOG("ERROR: can't register ring device.");
+        return VIRGIL_OPERATION_ERROR;
+    }
+    ring_registered = true;
+
+    return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+static bool rings_closed(void) {
+    bool res = true;
+    int i;
+
+    spin_lock_bh(&rings_lock);
+    for (i = 0; i < VIRGIL_RING_INSTANCES_MAX; ++i) {
+        res = res && !rings[i].opened;
+    }
+    spin_unlock_bh(&rings_lock);
+
+    return res;
+}
+
+/******************************************************************************/
+void ring_stop(void) {
+    int i;
+
+    LOG("ring stop");
+    if (ring_registered) {
+        misc_deregister(&ring_device);
+        ring_registered = false;
+    }
+
+    spin_lock_bh(&rings_lock);
+    rings_stopping = true;
+    spin_unlock_bh(&rings_lock);
+
+    for (i = 0; i < VIRGIL_RING_INSTANCES_MAX; ++i) {
+        wake_up_interruptible(&rings[i].wait);
+    }
+
+    // Code of module is needed until the last ring is released
+    while (!wait_event_timeout(closed_wait, rings_closed(), msecs_to_jiffies(VIRGIL_RING_CLOSE_TIMEOUT_MS))) {
+        LOG("Waiting for workers to close rings");
+    }
+}
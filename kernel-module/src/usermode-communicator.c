@@ -41,19 +41,47 @@
 
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/atomic.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/skbuff.h>
 
 #include <virgil/kernel/types.h>
 #include <virgil/kernel/private/log.h>
 #include <virgil/kernel/private/usermodehelper.h>
 #include <virgil/kernel/private/usermode-communicator.h>
 #include <virgil/kernel/private/netlink.h>
+#include <virgil/kernel/private/ring.h>
+#include <virgil/kernel/private/ports.h>
+#include <virgil/kernel/private/data-waiter.h>
 #include <virgil/kernel/private/fields.h>
+#include <virgil/kernel/private/fragments.h>
+#include <virgil/kernel/private/revocation.h>
 
-static __u32 id_counter = 0;
+static atomic_t id_counter = ATOMIC_INIT(0);
 
-static command_processor_cb processors[VIRGIL_CMD_PROCESSORS_MAX];
-static int processors_count = 0;
-static struct timer_list timer;
+// Processors are registered rarely and read for every frame, so table is replaced (RCU)
+typedef struct {
+	int count;
+	command_processor_cb ar[VIRGIL_CMD_PROCESSORS_MAX];
+	struct rcu_head rcu;
+} processors_t;
+
+static processors_t __rcu * processors = 0;
+static DEFINE_MUTEX(processors_mutex);
+
+static void supervise(struct work_struct * work);
+static DECLARE_DELAYED_WORK(supervise_work, supervise);
+static DECLARE_WAIT_QUEUE_HEAD(ready_wait);
+
+static unsigned int workers = 1;
+module_param(workers, uint, 0444);
+MODULE_PARM_DESC(workers, "Count of user-space service workers");
 
 #if !defined(VIRGIL_COMMUNICATOR_DEBUG)
 //#define VIRGIL_COMMUNICATOR_DEBUG
@@ -73,43 +101,117 @@ static int terminate_user_space_service(bool wait) {
 	return VIRGIL_OPERATION_OK;
 }
 
+/******************************************************************************/
+static void launch_workers(bool wait) {
+	unsigned int i;
+
+	for (i = 0; i < max(workers, 1U); ++i) {
+		launch_user_space_service(wait);
+	}
+}
+
 /******************************************************************************/
 static void restart_user_space_service(bool wait) {
 	LOG("Restart user-space service ...");
 	terminate_user_space_service(wait);
-	launch_user_space_service(wait);
+	launch_workers(wait);
 }
+
 /******************************************************************************/
-static void timer_action(unsigned long arg) {
-	static char dummy = 0x00;
+/* Launch missing workers and check them again if they don't become ready in time */
+static void supervise(struct work_struct * work) {
+	unsigned int count;
 
-	netlink_send(&dummy, 1);
+	count = ports_count();
+	if (count >= max(workers, 1U)) {
+		return;
+	}
 
-	if (! netlink_is_valid()) {
-		restart_user_space_service(false);
+	if (!count) {
+		restart_user_space_service(true);
+	} else {
+		for (; count < workers; ++count) {
+			launch_user_space_service(true);
+		}
 	}
-	timer.expires = jiffies + 2 * HZ;
-	add_timer(&timer);
+
+	schedule_delayed_work(&supervise_work, msecs_to_jiffies(VIRGIL_SERVICE_START_TIMEOUT_MS));
+}
+
+/******************************************************************************/
+static void worker_event(__u32 port, bool added) {
+	if (added) {
+		wake_up_all(&ready_wait);
+
+		// New worker sends its revocation set, it replaces current one regardless of version
+		revocation_reset_version();
+
+		// Requests waiting for restart of service go to new worker
+		data_waiter_replay();
+	} else {
+		// Requests of disconnected worker won't be answered
+		data_waiter_fail_port(port);
+
+		// Disconnected worker is replaced immediately
+		mod_delayed_work(system_wq, &supervise_work, 0);
+	}
+}
+
+static int send_frame(__u32 port, const frame_header_t * header, fields_t fields, gfp_t gfp,
+		__u32 frame_sz);
+
+/******************************************************************************/
+/* Send frame without data */
+static void send_notice(__u32 port, __u32 id, __u16 command) {
+	frame_header_t header;
+	fields_t fields;
+
+	memset(&header, 0, sizeof(header));
+	memset(&fields, 0, sizeof(fields));
+	header.id = id;
+	header.command = command;
+
+	send_frame(port, &header, fields, GFP_ATOMIC, VIRGIL_FRAME_HEADER_SZ);
 }
 
 /******************************************************************************/
-static void start_controll_timer(void) {
-	init_timer(&timer);
-	timer.function = timer_action;
-	timer.expires = jiffies + 2 * HZ;
-	timer.data = 0;
-	add_timer(&timer);
+/* Ping from worker means it's ready. Kernel answers with ping. */
+static void worker_ready(__u32 port) {
+	ports_add(port);
+	send_notice(port, VIRGIL_INVALID_ID, VIRGIL_CMD_PING);
 }
 
 /******************************************************************************/
-void communicator_parser_data(void * data, __u32 data_sz) {
+/* Worker reports depth of its queue. Requests are throttled while it's loaded. */
+static void worker_load(__u32 port, fields_t fields) {
+	__u32 load;
+	int i;
+
+	for (i = 0; i < fields.count; ++i) {
+		if (VIRGIL_FIELD_QUEUE_DEPTH == fields.ar[i].type && sizeof(load) == fields.ar[i].data_sz) {
+			memcpy(&load, fields.ar[i].data.p, sizeof(load));
+
+			// Waiting requests can be sent to unloaded worker
+			if (ports_set_load(port, load)) {
+				data_waiter_replay();
+			}
+			return;
+		}
+	}
+}
+
+/******************************************************************************/
+static void process_frame(__u32 port, void * data, __u32 data_sz, fields_owner_t * owner) {
 	char * payload = 0;
 	int i, pos;
 	__u32 id;
 	__u16 command;
 	__u16 fields_cnt;
-	__u32 min_sz;
+	__u32 min_sz, payload_sz;
 	fields_t fields;
+	processors_t * table;
+	command_processor_cb callbacks[VIRGIL_CMD_PROCESSORS_MAX];
+	int count;
 
 	struct package_field_t * fields_ar;
 
@@ -117,7 +219,7 @@ void communicator_parser_data(void * data, __u32 data_sz) {
 	LOG("Response parse ...");
 #endif
 
-	min_sz = sizeof(id) + sizeof(command) + sizeof(fields_cnt);
+	min_sz = VIRGIL_FRAME_HEADER_SZ;
 	if (!data || data_sz < min_sz) {
 		return;
 	}
@@ -128,12 +230,22 @@ void communicator_parser_data(void * data, __u32 data_sz) {
 	command = *((__u16 *) ((__u8 *)data + pos)), pos += sizeof(command);
 	fields_cnt = *((__u16 *) ((__u8 *)data + pos)), pos += sizeof(fields_cnt);
 
+	if (data_sz < min_sz + sizeof(struct package_field_t) * fields_cnt) {
+		LOG("ERROR: Wrong frame size");
+		return;
+	}
+
 	fields_ar = (struct package_field_t *)((__u8 *)data + min_sz);
 	payload = (void *)fields_ar + sizeof(struct package_field_t) * fields_cnt;
+	payload_sz = data_sz - min_sz - sizeof(struct package_field_t) * fields_cnt;
 	pos = 0;
 
 	// Restore pointers in structs
 	for (i = 0; i < fields_cnt; ++ i) {
+		if (fields_ar[i].data_sz > payload_sz - pos) {
+			LOG("ERROR: Wrong field size");
+			return;
+		}
 		fields_ar[i].data.p = payload + pos;
 		pos += fields_ar[i].data_sz;
 	}
@@ -152,114 +264,580 @@ void communicator_parser_data(void * data, __u32 data_sz) {
 	LOG("Response parse done");
 #endif
 
+	fields.count = fields_cnt;
+	fields.ar = fields_ar;
+
 	if (VIRGIL_CMD_PING == command) {
 		LOG("Ping from user space");
-	} else {
-		fields.count = fields_cnt;
-		fields.ar = fields_ar;
-		for (i = 0; i < processors_count; ++i) {
-			if (VIRGIL_OPERATION_OK == (*processors[i])(id, command, fields)) {
+		worker_ready(port);
+	} else if (!ports_contains(port)) {
+		// Responses and notices are accepted from registered workers only
+		LOG("ERROR: Frame from unknown port 0x%x is dropped", port);
+	} else if (VIRGIL_CMD_LOAD == command) {
+		worker_load(port, fields);
+	} else if (VIRGIL_CMD_FRAGMENT != command) {
+		// Processors can sleep, so they are called outside of RCU read section.
+		// They are functions of this module and are never removed.
+		rcu_read_lock();
+		table = rcu_dereference(processors);
+		count = table ? table->count : 0;
+		for (i = 0; i < count; ++i) {
+			callbacks[i] = table->ar[i];
+		}
+		rcu_read_unlock();
+
+		for (i = 0; i < count; ++i) {
+			if (VIRGIL_OPERATION_OK == (*callbacks[i])(id, command, fields, owner)) {
 				break;
 			}
 		}
 	}
 }
 
+/******************************************************************************/
+static void skb_release(void * skb) {
+	consume_skb((struct sk_buff *)skb);
+}
+
+/******************************************************************************/
+static void frame_release(void * frame) {
+	vfree(frame);
+}
+
+/******************************************************************************/
+static void copy_release(void * data) {
+	kfree(data);
+}
+
+/******************************************************************************/
+/* Frame or fragment is parsed from buffer described by data_owner, which is released at the end */
+static void parser_data(__u32 port, void * data, __u32 data_sz, fields_owner_t * data_owner) {
+	__u32 id;
+	__u16 command;
+	void * frame;
+	__u32 frame_sz;
+	fields_owner_t owner;
+
+	if (!data || data_sz < VIRGIL_FRAME_HEADER_SZ) {
+		goto release;
+	}
+
+	id = *((__u32 *) data);
+	command = *((__u16 *) ((__u8 *)data + sizeof(id)));
+
+	// Processor can keep received buffer instead of copying of response data
+	if (VIRGIL_CMD_FRAGMENT != command) {
+		process_frame(port, data, data_sz, data_owner);
+	} else if (VIRGIL_OPERATION_OK == fragments_receive(id,
+			(__u8 *)data + VIRGIL_FRAME_HEADER_SZ, data_sz - VIRGIL_FRAME_HEADER_SZ,
+			&frame, &frame_sz) && frame) {
+		owner.buffer = frame;
+		owner.release = frame_release;
+		process_frame(port, frame, frame_sz, &owner);
+
+		if (owner.buffer) {
+			owner.release(owner.buffer);
+		}
+	}
+
+release:
+	if (data_owner->buffer) {
+		data_owner->release(data_owner->buffer);
+	}
+}
+
+/******************************************************************************/
+/* Ring slot is mapped by user space and can be changed at any moment, so only its copy is parsed */
+static void ring_parser_data(__u32 port, void * data, __u32 data_sz) {
+	fields_owner_t owner;
+
+	owner.buffer = kmemdup(data, data_sz, GFP_KERNEL);
+	owner.release = copy_release;
+
+	if (!owner.buffer) {
+		LOG("ERROR: Message of ring can't be copied");
+		return;
+	}
+
+	parser_data(port, owner.buffer, data_sz, &owner);
+}
+
+/******************************************************************************/
+void communicator_parser_data(__u32 port, void * data, __u32 data_sz, struct sk_buff * skb) {
+	fields_owner_t owner;
+
+	owner.buffer = skb ? skb_get(skb) : 0;
+	owner.release = skb_release;
+
+	parser_data(port, data, data_sz, &owner);
+}
+
 /******************************************************************************/
 int communicator_add_processor_callback(command_processor_cb callback) {
-	if (!callback || processors_count >= VIRGIL_CMD_PROCESSORS_MAX) {
+	processors_t * table;
+	processors_t * old;
+
+	if (!callback) {
+		return VIRGIL_OPERATION_ERROR;
+	}
+
+	table = kzalloc(sizeof(*table), GFP_KERNEL);
+	if (!table) {
 		return VIRGIL_OPERATION_ERROR;
 	}
 
-	processors[processors_count++] = callback;
+	mutex_lock(&processors_mutex);
+	old = rcu_dereference_protected(processors, lockdep_is_held(&processors_mutex));
+	if (old && old->count >= VIRGIL_CMD_PROCESSORS_MAX) {
+		mutex_unlock(&processors_mutex);
+		kfree(table);
+		return VIRGIL_OPERATION_ERROR;
+	}
+
+	if (old) {
+		memcpy(table->ar, old->ar, old->count * sizeof(command_processor_cb));
+		table->count = old->count;
+	}
+	table->ar[table->count++] = callback;
+	rcu_assign_pointer(processors, table);
+	mutex_unlock(&processors_mutex);
+
+	if (old) {
+		kfree_rcu(old, rcu);
+	}
 
 	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
-int communicator_start(void) {
-	launch_user_space_service(true);
+static void processors_cleanup(void) {
+	processors_t * old;
 
+	mutex_lock(&processors_mutex);
+	old = rcu_dereference_protected(processors, lockdep_is_held(&processors_mutex));
+	RCU_INIT_POINTER(processors, 0);
+	mutex_unlock(&processors_mutex);
+
+	synchronize_rcu();
+	kfree(old);
+}
+
+/******************************************************************************/
+int communicator_start(void) {
 	// Prepare netlink communication
 	netlink_set_processor(&communicator_parser_data);
 	netlink_start();
 
-	start_controll_timer();
+	// Prepare shared memory communication
+	ring_set_processor(&ring_parser_data);
+	ring_start();
+
+	ports_set_listener(&worker_event);
+	launch_workers(true);
+
+	// Check that workers have become ready
+	schedule_delayed_work(&supervise_work, msecs_to_jiffies(VIRGIL_SERVICE_START_TIMEOUT_MS));
 
 	return VIRGIL_OPERATION_OK;
 }
 
 /******************************************************************************/
 void communicator_stop(void) {
-	// Stop timer
-	del_timer(&timer);
+	// Stop supervision
+	ports_set_listener(0);
+	cancel_delayed_work_sync(&supervise_work);
 
 	// Terminate user space service
 	terminate_user_space_service(true);
+
+	ring_stop();
+	fragments_cleanup();
+	ports_cleanup();
+	processors_cleanup();
 }
 
 /******************************************************************************/
-__u32 communicator_send_data(__u16 command, fields_t fields) {
+__u32 communicator_next_id(void) {
+	__u32 res;
 
-	__u32 header_sz, res;
-	int i, pos, cnt;
-	void * data_for_send;
-	__u32 data_for_send_sz, payload_sz = 0;
+	// Counter wraps around, VIRGIL_INVALID_ID is skipped
+	do {
+		res = (__u32)atomic_inc_return(&id_counter);
+	} while (VIRGIL_INVALID_ID == res);
 
+	return res;
+}
 
-	for (cnt = 0; cnt < 3; ++ cnt) {
-		++id_counter;
+/******************************************************************************/
+static __u32 frame_size(fields_t fields) {
+	__u32 res;
+	int i;
+
+	res = VIRGIL_FRAME_HEADER_SZ + sizeof(struct package_field_t) * fields.count;
+
+	for (i = 0; i < fields.count; ++i) {
+		res += fields.ar[i].data_sz;
+	}
+
+	return res;
+}
+
+/******************************************************************************/
+/* Copy part of frame segment [seg_pos, seg_pos + seg_sz) which is inside of window [offset, offset + len) */
+static __u32 copy_segment(__u8 * dst, __u32 offset, __u32 len,
+		__u32 seg_pos, const void * seg, __u32 seg_sz) {
+	__u32 from, to;
+
+	from = max_t(__u32, seg_pos, offset);
+	to = min_t(__u32, seg_pos + seg_sz, offset + len);
+	if (from < to) {
+		memcpy(dst + (from - offset), (const __u8 *)seg + (from - seg_pos), to - from);
+	}
+
+	return seg_pos + seg_sz;
+}
+
+/******************************************************************************/
+/* Same as copy_segment for data of field, which can be non-linear */
+static __u32 copy_field(__u8 * dst, __u32 offset, __u32 len,
+		__u32 seg_pos, const struct package_field_t * field) {
+	__u32 from, to;
+
+	from = max_t(__u32, seg_pos, offset);
+	to = min_t(__u32, seg_pos + field->data_sz, offset + len);
+	if (from < to) {
+		fields_data_read(field, from - seg_pos, dst + (from - offset), to - from);
+	}
+
+	return seg_pos + field->data_sz;
+}
 
-		header_sz = sizeof(id_counter) + sizeof(command) + sizeof(fields.count);
+/******************************************************************************/
+/* Serialize part [offset, offset + len) of frame */
+static void frame_write_range(void * dst, const frame_header_t * header, fields_t fields,
+		__u32 offset, __u32 len) {
+	struct package_field_t field;
+	__u32 pos;
+	int i;
+
+	pos = copy_segment(dst, offset, len, 0, header, sizeof(*header));
+
+	for (i = 0; i < fields.count; ++i) {
+		field.type = VIRGIL_FIELD_TYPE(fields.ar[i].type);
+		field.data_sz = fields.ar[i].data_sz;
+		memset(field.data.pad, 0, sizeof(field.data.pad));	// Pointers are restored by receiver
+		pos = copy_segment(dst, offset, len, pos, &field, sizeof(field));
+	}
+
+	for (i = 0; i < fields.count && pos < offset + len; ++i) {
+		pos = copy_field(dst, offset, len, pos, &fields.ar[i]);
+	}
+}
+
+/******************************************************************************/
+/* Serialize whole frame or its fragment */
+static void message_write(__u8 * payload, const frame_header_t * header, fields_t fields,
+		__u32 frame_sz, __u32 offset, __u32 len) {
+	frame_header_t fragment_frame;
+	fragment_header_t fragment;
+	__u32 pos;
 
-		for (i = 0; i < fields.count; ++i) {
-			payload_sz += fields.ar[i].data_sz;
+	pos = 0;
+	if (len != frame_sz) {
+		memset(&fragment_frame, 0, sizeof(fragment_frame));
+		fragment_frame.id = header->id;
+		fragment_frame.command = VIRGIL_CMD_FRAGMENT;
+
+		fragment.frame_sz = frame_sz;
+		fragment.offset = offset;
+
+		memcpy(payload, &fragment_frame, sizeof(fragment_frame)),
+				pos += sizeof(fragment_frame);
+		memcpy(payload + pos, &fragment, sizeof(fragment)),
+				pos += sizeof(fragment);
+	}
+
+	frame_write_range(payload + pos, header, fields, offset, len);
+}
+
+/******************************************************************************/
+/* Send whole frame or its fragment to worker. Data is serialized directly into ring slot or netlink message. */
+static int send_message(__u32 port, const frame_header_t * header, fields_t fields, gfp_t gfp,
+		__u32 frame_sz, __u32 offset, __u32 len) {
+	struct sk_buff * skb;
+	__u8 * payload;
+	__u32 message_sz;
+	int cnt;
+
+	message_sz = len != frame_sz ? VIRGIL_FRAME_HEADER_SZ + sizeof(fragment_header_t) + len : len;
+
+	if (VIRGIL_PORT_IS_RING(port)) {
+		payload = ring_frame_reserve(port, message_sz);
+		if (!payload) {
+			return VIRGIL_OPERATION_ERROR;
 		}
-		data_for_send_sz = header_sz +
-				sizeof(struct package_field_t) * fields.count +
-				payload_sz;
-
-		data_for_send = kmalloc(data_for_send_sz, GFP_KERNEL);
-		if (!data_for_send) {
-			LOG("ERROR: No memory for data send");
-			return VIRGIL_INVALID_ID;
+
+		message_write(payload, header, fields, frame_sz, offset, len);
+		ring_frame_commit(port, message_sz);
+		return VIRGIL_OPERATION_OK;
+	}
+
+	// Message is consumed by every send attempt
+	for (cnt = 0; cnt < 3; ++ cnt) {
+		skb = netlink_frame_alloc(message_sz, gfp, (void **)&payload);
+		if (!skb) {
+			return VIRGIL_OPERATION_ERROR;
 		}
 
-		pos = 0;
-		memcpy((__u8 *)data_for_send, &id_counter, sizeof(id_counter)),
-				pos += sizeof(id_counter);
-		memcpy((__u8 *)data_for_send + pos, &command, sizeof(command)),
-				pos += sizeof(command);
-		memcpy((__u8 *)data_for_send + pos, &fields.count, sizeof(fields.count)),
-				pos += sizeof(fields.count);
-
-		for (i = 0; i < fields.count; ++i) {
-			memcpy((__u8 *)data_for_send + pos, &fields.ar[i].type, sizeof(fields.ar[i].type)),
-					pos += sizeof(fields.ar[i].type);
-			memcpy((__u8 *)data_for_send + pos, &fields.ar[i].data_sz, sizeof(fields.ar[i].data_sz)),
-					pos += sizeof(fields.ar[i].data_sz);
-			memcpy((__u8 *)data_for_send + pos, &fields.ar[i].data.pad, 8),
-					pos += 8;
+		message_write(payload, header, fields, frame_sz, offset, len);
+
+		if (netlink_frame_send(skb, port)) {
+			return VIRGIL_OPERATION_OK;
 		}
+	}
+
+	return VIRGIL_OPERATION_ERROR;
+}
+
+/******************************************************************************/
+static int send_frame(__u32 port, const frame_header_t * header, fields_t fields, gfp_t gfp,
+		__u32 frame_sz) {
+	__u32 offset, len;
+
+	if (frame_sz <= VIRGIL_MESSAGE_SZ_MAX) {
+		return send_message(port, header, fields, gfp, frame_sz, 0, frame_sz);
+	}
 
-		for (i = 0; i < fields.count; ++i) {
-			memcpy((__u8 *)data_for_send + pos, fields.ar[i].data.p, fields.ar[i].data_sz),
-					pos += fields.ar[i].data_sz;
+	for (offset = 0; offset < frame_sz; offset += len) {
+		len = min_t(__u32, frame_sz - offset, VIRGIL_FRAGMENT_DATA_SZ_MAX);
+		if (VIRGIL_OPERATION_OK != send_message(port, header, fields, gfp, frame_sz, offset, len)) {
+			return VIRGIL_OPERATION_ERROR;
 		}
+	}
+
+	return VIRGIL_OPERATION_OK;
+}
+
+/******************************************************************************/
+/* Detached datagram of batch. Batch can be used again before datagram is sent. */
+typedef struct {
+	struct sk_buff * skb;
+	__u32 port;
+	__u32 ids[VIRGIL_BATCH_REQUESTS_MAX];
+	__u32 count;
+} batch_datagram_t;
+
+/******************************************************************************/
+static void batch_detach(virgil_batch_t * batch, batch_datagram_t * datagram) {
+	datagram->skb = batch->skb;
+	datagram->port = batch->port;
+	datagram->count = batch->count;
+	memcpy(datagram->ids, batch->ids, batch->count * sizeof(batch->ids[0]));
+
+	batch->skb = 0;
+	batch->count = 0;
+}
+
+/******************************************************************************/
+/* Send detached datagram. Completion callbacks of failed requests can submit new requests into the same batch,
+ * so batch must be consistent before call. */
+static int batch_send(batch_datagram_t * datagram) {
+	__u32 i;
+
+	if (!datagram->skb) {
+		return VIRGIL_OPERATION_OK;
+	}
+
+	// Datagram is empty if frame can't be added to just allocated one
+	if (!datagram->count) {
+		kfree_skb(datagram->skb);
+		return VIRGIL_OPERATION_OK;
+	}
+
+	if (netlink_frame_send(datagram->skb, datagram->port)) {
+		return VIRGIL_OPERATION_OK;
+	}
+
+	// Requests of lost datagram won't be answered, so they don't wait for timeout and free window of worker
+	for (i = 0; i < datagram->count; ++i) {
+		data_waiter_fail_request(datagram->ids[i], VIRGIL_OPERATION_ERROR);
+	}
+
+	return VIRGIL_OPERATION_ERROR;
+}
+
+/******************************************************************************/
+static int batch_append(virgil_batch_t * batch, __u32 port, const frame_header_t * header, fields_t fields,
+		__u32 frame_sz, gfp_t gfp) {
+	batch_datagram_t datagram;
+	void * payload = 0;
+	int res = VIRGIL_OPERATION_OK;
+
+	datagram.skb = 0;
+
+	if (batch->port == port && batch->count < VIRGIL_BATCH_REQUESTS_MAX) {
+		payload = netlink_frame_append(batch->skb, frame_sz);
+	}
+
+	if (!payload) {
+		// Datagram is full, not allocated yet or destined to other worker. It's sent after frame is added to new one.
+		batch_detach(batch, &datagram);
+
+		batch->port = port;
+		batch->skb = netlink_batch_alloc(gfp);
+		payload = netlink_frame_append(batch->skb, frame_sz);
+	}
+
+	if (payload) {
+		frame_write_range(payload, header, fields, 0, frame_sz);
+		batch->ids[batch->count++] = header->id;
+	} else {
+		res = VIRGIL_OPERATION_ERROR;
+	}
 
-		if (netlink_send(data_for_send, data_for_send_sz)) {
-			res = id_counter;
-		} else {
-			res = VIRGIL_INVALID_ID;
+	if (VIRGIL_OPERATION_OK != batch_send(&datagram)) {
+		LOG("ERROR: Batch can't be sent");
+	}
+
+	return res;
+}
+
+/******************************************************************************/
+/* Convert deadline in jiffies to absolute time of CLOCK_MONOTONIC (ms), which is seen by user-space too */
+static __u64 deadline_to_monotonic(unsigned long deadline) {
+	unsigned long now = jiffies;
+	__u64 left_ms = 0;
+
+	if (time_after(deadline, now)) {
+		left_ms = jiffies_to_msecs(deadline - now);
+	}
+
+	return (__u64)ktime_to_ms(ktime_get()) + left_ms;
+}
+
+/******************************************************************************/
+/* Requests which use key storage of worker are processed by primary worker */
+static bool is_primary_command(__u16 command) {
+	return VIRGIL_CMD_STORAGE_STORE == command
+			|| VIRGIL_CMD_STORAGE_LOAD == command
+			|| VIRGIL_CMD_STORAGE_REMOVE == command;
+}
+
+/******************************************************************************/
+/* Wait for ready worker if caller can sleep (service is being started or restarted).
+ * There is no waiting if workers are present, but their windows are full. */
+static __u32 acquire_worker(bool primary, __u8 priority, gfp_t gfp) {
+	__u32 worker;
+
+	worker = ports_acquire(primary, priority);
+	if (VIRGIL_PORT_NONE == worker && !ports_count() && GFP_CAN_SLEEP(gfp)) {
+		wait_event_interruptible_timeout(ready_wait,
+				VIRGIL_PORT_NONE != (worker = ports_acquire(primary, priority)) || ports_count(),
+				msecs_to_jiffies(VIRGIL_SERVICE_START_TIMEOUT_MS));
+	}
+
+	return worker;
+}
+
+/******************************************************************************/
+int communicator_send(__u32 id, __u16 command, __u8 priority, unsigned long deadline,
+		fields_t fields, gfp_t gfp, virgil_batch_t * batch, __u32 * port) {
+	frame_header_t header;
+	__u32 frame_sz, worker;
+	int res;
+
+	if (!port) {
+		return VIRGIL_OPERATION_ERROR;
+	}
+	*port = VIRGIL_PORT_NONE;
+
+	frame_sz = frame_size(fields);
+	if (frame_sz > VIRGIL_FRAME_SZ_MAX) {
+		LOG("ERROR: Frame is too big (%u bytes)", frame_sz);
+		return VIRGIL_OPERATION_ERROR;
+	}
+
+	// Requests of batch go to the same worker while it's alive
+	if (!is_primary_command(command) && batch && batch->skb && ports_get(batch->port, priority)) {
+		worker = batch->port;
+	} else {
+		worker = acquire_worker(is_primary_command(command), priority, gfp);
+	}
+
+	if (VIRGIL_PORT_NONE == worker) {
+		if (ports_count()) {
+			return VIRGIL_OPERATION_BUSY;
 		}
+		LOG("ERROR: There are no workers of user-space service");
+		return VIRGIL_OPERATION_UNAVAILABLE;
+	}
+
+	// Worker is set before sending, so response can release it
+	*port = worker;
 
-		kfree(data_for_send);
+	memset(&header, 0, sizeof(header));
+	header.id = id;
+	header.command = command;
+	header.fields_cnt = fields.count;
+	header.deadline = deadline_to_monotonic(deadline);
+	header.priority = priority;
 
-		if (VIRGIL_INVALID_ID != res) {
-			return res;
+	if (batch && frame_sz <= VIRGIL_MESSAGE_SZ_MAX && !VIRGIL_PORT_IS_RING(worker)) {
+		res = batch_append(batch, worker, &header, fields, frame_sz, gfp);
+	} else {
+		// Batch is flushed before to keep order of requests
+		if (batch && VIRGIL_OPERATION_OK != virgil_batch_flush(batch)) {
+			LOG("ERROR: Batch can't be sent");
 		}
+		res = send_frame(worker, &header, fields, gfp, frame_sz);
+	}
+
+	if (VIRGIL_OPERATION_OK != res) {
+		*port = VIRGIL_PORT_NONE;
+		ports_release(worker, priority);
+	}
+
+	return res;
+}
+
+/******************************************************************************/
+void communicator_cancel(__u32 id, __u32 port) {
+	if (VIRGIL_PORT_NONE == port) {
+		return;
+	}
+
+	// Notice is best effort. If it's lost, worker performs operation and response is dropped.
+	send_notice(port, id, VIRGIL_CMD_CANCEL);
+}
+
+/******************************************************************************/
+virgil_batch_t * virgil_batch_create(gfp_t gfp) {
+	return kzalloc(sizeof(virgil_batch_t), gfp);
+}
+
+/******************************************************************************/
+int virgil_batch_flush(virgil_batch_t * batch) {
+	batch_datagram_t datagram;
+
+	if (!batch) {
+		return VIRGIL_OPERATION_ERROR;
+	}
+
+	batch_detach(batch, &datagram);
+
+	return batch_send(&datagram);
+}
+
+/******************************************************************************/
+void virgil_batch_free(virgil_batch_t * batch) {
+	if (!batch) {
+		return;
 	}
 
-	return VIRGIL_INVALID_ID;
+	virgil_batch_flush(batch);
+	kfree(batch);
 }
 
+EXPORT_SYMBOL( virgil_batch_create);
+EXPORT_SYMBOL( virgil_batch_flush);
+EXPORT_SYMBOL( virgil_batch_free);
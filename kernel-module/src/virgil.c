@@ -42,15 +42,38 @@
 #include <linux/module.h>
 
 #include <virgil/kernel/private/log.h>
+#include <virgil/kernel/private/fields.h>
 #include <virgil/kernel/private/netlink.h>
 #include <virgil/kernel/private/usermode-communicator.h>
 #include <virgil/kernel/private/data-waiter.h>
+#include <virgil/kernel/private/local-crypto.h>
+#include <virgil/kernel/private/key-cache.h>
+#include <virgil/kernel/private/cert-cache.h>
+#include <virgil/kernel/private/cert-table.h>
 
 /******************************************************************************/
 static int __init virgil_kernel_init(void) {
     LOG("init");
 
+    if (VIRGIL_OPERATION_OK != fields_init()) {
+        return -ENOMEM;
+    }
+
+    if (VIRGIL_OPERATION_OK != data_waiter_init()) {
+        fields_cleanup();
+        return -ENOMEM;
+    }
+
+    if (VIRGIL_OPERATION_OK != key_cache_init()) {
+        data_waiter_stop();
+        fields_cleanup();
+        return -ENOMEM;
+    }
+
+    local_crypto_init();
+
     communicator_add_processor_callback(&data_waiter_command_processor);
+    communicator_add_processor_callback(&cert_cache_command_processor);
     communicator_start();
 
     return 0;
@@ -60,6 +83,12 @@ static int __init virgil_kernel_init(void) {
 static void __exit virgil_kernel_exit(void) {
     netlink_stop();
     communicator_stop();
+    data_waiter_stop();
+    key_cache_cleanup();
+    cert_cache_cleanup();
+    cert_table_cleanup();
+    local_crypto_cleanup();
+    fields_cleanup();
     LOG("exit");
 }
 
@@ -7,8 +7,8 @@ SCRIPT_FOLDER="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
 ${SCRIPT_FOLDER}/build/build-all.sh
 
 sudo killall -9 virgil-service
-sudo rmmod -f virgil-kernel-test
-sudo rmmod -f virgil-kernel
+sudo rmmod virgil-kernel-test
+sudo rmmod virgil-kernel
 
 sleep 1s
 
@@ -42,8 +42,13 @@
 #ifndef VIRGIL_APPLICATION_H
 #define VIRGIL_APPLICATION_H
 
-#include "VirgilNetlinkCommunicator.h"
+#include "VirgilThreadedCommunicator.h"
 #include "VirgilCommand.h"
+#include "VirgilExecutor.h"
+
+#include <map>
+#include <mutex>
+#include <chrono>
 
 /**
  * @brief Creates all elements and connects them, starts main cycle.
@@ -62,12 +67,22 @@ public:
     bool exec();
 
 private:
-    VirgilNetlinkCommunicator * m_kernelCommunicator;
+    VirgilThreadedCommunicator * m_kernelCommunicator;
+    VirgilExecutor m_executor;
+
+    // Requests cancelled by kernel. Cancel notice can come before request, so it's kept for some time.
+    std::map <uint32_t, std::chrono::steady_clock::time_point> m_cancelled;
+    std::mutex m_cancelledMutex;
 
+    void cancel(uint32_t requestId);
+    bool takeCancelled(uint32_t requestId);
     void sendResult(const VirgilCommand & command, VirgilResult result);
     void onCommunicationStart();
     void onCommunicationStop();
     void onDataReceived(int from, const VirgilByteArray & data);
+    void process(const VirgilCommand & command);
+    void onLoadChanged(size_t load);
+    void onCRLChanged();
 };
 
 #endif /* VIRGIL_APPLICATION_H */
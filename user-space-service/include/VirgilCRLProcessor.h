@@ -45,10 +45,12 @@
 #include <mutex>
 #include <thread>
 
+#include "signals/Signal.h"
+
 #include <virgil/sdk/models/CRLModel.h>
 #include <virgil/crypto/VirgilByteArray.h>
 
-#include <list>
+#include <set>
 
 using namespace virgil::crypto;
 using namespace virgil::sdk::models;
@@ -71,13 +73,38 @@ public:
 
     bool isCertificateRevoked(const std::string & certificateId);
 
+    /**
+     * @brief Revocation set for kernel module: Bloom filter and sorted ids (SHA-256 of card id).
+     * Layout is revocation_set_header_t of kernel module (revocation.h), followed by filter and ids.
+     * @return revocation set or empty array if CRL hasn't been received yet
+     */
+    VirgilByteArray revocationSet();
+
+    /**
+     * @brief Id of certificate in revocation set.
+     * @param certificateId - id of card
+     * @return SHA-256 of card id
+     */
+    static VirgilByteArray idDigest(const std::string & certificateId);
+
+    /**
+     * @brief Fired from request thread when received CRL differs from previous one.
+     */
+    Gallant::Signal0 <void> fireCRLChanged;
+
 private:
     VirgilCRLProcessor();
     virtual ~VirgilCRLProcessor();
 
     static const int kAskPeriodSec;
-
-    std::list <std::string> m_crlIds;
+    static const uint32_t kFilterBitsPerId;
+    static const uint32_t kFilterBitsMin;
+    static const uint32_t kFilterBitsMax;
+    static const uint8_t kFilterHashes;
+    static const size_t kExactIdsMax;
+
+    std::set <std::string> m_crlIds;
+    VirgilByteArray m_revocationSet;
     std::mutex m_crlMutex;
 
     std::thread m_requestThread;
@@ -87,6 +114,7 @@ private:
     bool m_stop;
 
     void requestThread();
+    void buildRevocationSet();
 };
 
 #endif /* VIRGIL_CRL_PROCESSOR_H */
@@ -84,9 +84,14 @@ public:
     
     std::string getRootCertificate();
     
+    /**
+     * @brief Verify certificate with root certificate.
+     * @param isChecked - set to true if signature has been checked, so result is definitive (can be nullptr)
+     */
     bool verifyCertificateWithRoot(
             const std::string & cert,
-            const std::string & rootCert
+            const std::string & rootCert,
+            bool * isChecked = nullptr
             );
     
     bool revokeCertificate(
@@ -76,6 +76,13 @@ namespace virgil {
                 cmdCertificateCRLInfo,
                 cmdCertificateCheckIsRevoked,
 
+                cmdFragment,
+                cmdCancel,
+                cmdLoad,
+                cmdCRLChanged,
+                cmdCryptoVerifyBatch,
+                cmdCryptoSignBatch,
+
                 cmdMax
             };
 
@@ -97,13 +104,24 @@ namespace virgil {
                 fldCRLTimeNext,
                 fldHashFunc,
                 fldOptional_1,
+                fldQueueDepth,
 
                 fldMax
             };
 
+            enum VirgilPriority : uint16_t {
+                prioDefault = 0,
+                prioCritical,
+                prioNormal,
+                prioBulk,
+
+                prioMax
+            };
+
             enum VirgilResult : uint16_t {
                 resOk = 0,
                 resGeneralError,
+                resRejected = 4,        // Definitive negative answer (VIRGIL_OPERATION_REJECTED of kernel module)
 
                 resMax
             };
@@ -123,6 +141,9 @@ using namespace virgil::kernel::protocol;
 
 class VirgilCommand {
 public:
+    static const size_t kBatchCountMax = 256;                   /**< Maximum count of items in batch request (VIRGIL_BATCH_COUNT_MAX) */
+    static const size_t kElementsMax = 3 * kBatchCountMax;      /**< Maximum count of fields (batch verification has 3 fields per item) */
+
     VirgilCommand();
     VirgilCommand(VirgilCmd cmd, uint32_t requestId);
     VirgilCommand(const VirgilByteArray & rawCommandData);
@@ -183,11 +204,31 @@ public:
      */
     std::list<VirgilByteArray> dataByField(VirgilField field) const;
 
+    /**
+     * @brief Get all data fields in order of command (for requests with repeated groups of fields)
+     */
+    const std::list<VirgilDataElement> & elements() const;
+
     /**
      * @brief Returns identifier of current command
      */
     uint32_t id() const;
 
+    /**
+     * @brief Returns deadline of request (CLOCK_MONOTONIC, milliseconds). 0 - no deadline.
+     */
+    uint64_t deadline() const;
+
+    /**
+     * @brief Check is deadline of request passed, so nobody waits for response
+     */
+    bool isExpired() const;
+
+    /**
+     * @brief Returns priority class of request
+     */
+    VirgilPriority priority() const;
+
     /**
      * @brief Fast creation of "ping" command
      * @return Byte array with ping command
@@ -223,6 +264,8 @@ private:
     VirgilCmd m_command;
     std::list <VirgilDataElement> m_elements;
     uint32_t m_requestId;
+    uint64_t m_deadline;
+    VirgilPriority m_priority;
 };
 
 #endif /* VIRGIL_COMMAND_H */
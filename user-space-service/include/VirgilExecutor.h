@@ -0,0 +1,113 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file VirgilExecutor.h
+ * @brief Execution of requests of kernel module by pool of threads.
+ */
+
+#ifndef VIRGIL_EXECUTOR_H
+#define VIRGIL_EXECUTOR_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+#include "VirgilCommand.h"
+#include "signals/Signal.h"
+
+/**
+ * @brief Pool of threads for requests of kernel module.
+ * Each priority class has own queue. Queues are served with weighted fair queueing (task with the least
+ * finish tag is executed first). Each class can occupy limited count of threads, so slow requests (network)
+ * don't delay fast ones.
+ * Depth of queue is reported when it changes significantly, so kernel module can throttle requests.
+ */
+class VirgilExecutor {
+public:
+    typedef std::function<void()> Task;
+
+    VirgilExecutor();
+    virtual ~VirgilExecutor();
+
+    VirgilExecutor(const VirgilExecutor&) = delete;
+    VirgilExecutor& operator=(const VirgilExecutor&) = delete;
+
+    /**
+     * @brief Add task to queue of its priority class
+     * @param priority - priority class of task (prioDefault is treated as prioNormal)
+     * @param task - task for execution
+     */
+    void submit(VirgilPriority priority, Task task);
+
+    Gallant::Signal1 <size_t> fireLoadChanged;
+
+private:
+    struct Item {
+        uint64_t tag;
+        Task task;
+    };
+
+    static const size_t kThreadsCount = 4;      /**< Count of threads in pool */
+    static const uint64_t kWeightScale = 64;    /**< Virtual time of one task of class with weight 1 */
+    static const size_t kLoadReportStep = 8;    /**< Depth of queue is reported when it crosses multiple of step */
+
+    std::vector <std::thread> m_threads;
+    std::deque <Item> m_queues[prioMax];
+    size_t m_running[prioMax];
+    uint64_t m_classTag[prioMax];
+    uint64_t m_virtualTime;
+    size_t m_depth;
+    size_t m_reportedLoad;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condVar;
+    bool m_stop;
+
+    static uint64_t weight(VirgilPriority priority);
+    static size_t threadsLimit(VirgilPriority priority);
+
+    bool pick(VirgilPriority & priority);
+    bool loadChanged(size_t & load);
+    void threadFunc();
+};
+
+#endif /* VIRGIL_EXECUTOR_H */
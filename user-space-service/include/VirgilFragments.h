@@ -0,0 +1,95 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file VirgilFragments.h
+ * @brief Fragmentation and reassembly of frames which don't fit into single message.
+ * Fragment contains frame header (request id, cmdFragment, 0 fields, no deadline and priority), fragment header (frame size, offset) and part of frame.
+ * Fragments of one frame are sent in order, so offset of fragment is used as sequence number.
+ */
+
+#ifndef VIRGIL_FRAGMENTS_H
+#define VIRGIL_FRAGMENTS_H
+
+#include <map>
+#include <list>
+#include <chrono>
+#include <stdint.h>
+
+#include <virgil/crypto/VirgilByteArray.h>
+
+using namespace virgil::crypto;
+
+class VirgilFragments {
+public:
+    VirgilFragments();
+
+    /**
+     * @brief Split frame into fragments.
+     * @param frame - serialized command
+     * @param messageSizeMax - maximum size of single message
+     * @return list with frame itself if it fits into single message, or list of fragments
+     */
+    static std::list<VirgilByteArray> split(const VirgilByteArray & frame, size_t messageSizeMax);
+
+    /**
+     * @brief Process received message.
+     * @param message - received message
+     * @param frame - complete frame (message itself if it isn't a fragment)
+     * @return true if frame is complete
+     */
+    bool append(const VirgilByteArray & message, VirgilByteArray & frame);
+
+    static const size_t kFrameSizeMax;          /**< Maximum size of fragmented frame */
+    static const size_t kReassemblyMemoryMax;   /**< Maximum memory for all frames in reassembly */
+
+private:
+    struct Frame {
+        VirgilByteArray data;
+        uint32_t frameSize;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    static const size_t kHeaderSize;        /**< Size of frame header and fragment header */
+
+    std::map<uint32_t, Frame> m_frames;
+    size_t m_memory;
+
+    void drop(std::map<uint32_t, Frame>::iterator it);
+    void dropExpired();
+};
+
+#endif /* VIRGIL_FRAGMENTS_H */
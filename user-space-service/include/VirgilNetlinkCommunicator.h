@@ -43,7 +43,12 @@
 #define	VIRGIL_NETLINK_COMMUNICATOR_H
 
 #include <stdint.h>
+#include <list>
+#include <queue>
+#include <vector>
+
 #include "VirgilCommand.h"
+#include "VirgilFragments.h"
 #include "VirgilThreadedCommunicator.h"
 
 /**
@@ -80,6 +85,14 @@ private:
      * @return true if data has been sent successfully
      */
     virtual bool _send(int to, const VirgilByteArray & data) final;
+
+    /**
+     * @brief Send prepared frames packed into as few datagrams as possible.
+     * @param to - ignored here
+     * @param frames - list of frames for send
+     * @return true if all frames have been sent successfully
+     */
+    virtual bool _sendBatch(int to, const std::list <VirgilByteArray> & frames) final;
     
     /**
      * @brief Receive data.
@@ -88,10 +101,36 @@ private:
      */
     virtual bool _receive(int * from, VirgilByteArray & data) final;
 
+    /**
+     * @brief Append netlink message to datagram.
+     * @param datagram - datagram with netlink messages
+     * @param message - message payload
+     */
+    static void appendMessage(std::vector<char> & datagram, const VirgilByteArray & message);
+
+    /**
+     * @brief Send datagram with one or more netlink messages.
+     * @param datagram - datagram with netlink messages
+     */
+    bool sendDatagram(const std::vector<char> & datagram);
+
+    /**
+     * @brief Receive single netlink message.
+     * Datagram can contain several netlink messages, they are returned one by one.
+     * @param message - message payload
+     */
+    bool receiveMessage(VirgilByteArray & message);
+
     static const int kVirgilNetlink = 27; /**< Netlink protocol */
+    static const size_t kMessageSizeMax; /**< Maximum size of payload of single netlink message. Bigger frames are fragmented. */
+    static const size_t kDatagramSizeMax; /**< Maximum size of datagram with several netlink messages */
 
     std::mutex m_socketMutex;
     int m_socket;
+
+    std::vector<char> m_receiveBuffer;
+    std::queue<VirgilByteArray> m_receivedMessages;
+    VirgilFragments m_fragments;
 };
 
 #endif	/* VIRGIL_NETLINK_COMMUNICATOR_H */
\ No newline at end of file
@@ -0,0 +1,156 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file VirgilRingCommunicator.h
+ * @brief Communication of current service and kernel module through shared memory rings.
+ */
+
+#ifndef VIRGIL_RING_COMMUNICATOR_H
+#define VIRGIL_RING_COMMUNICATOR_H
+
+#include <stdint.h>
+#include <list>
+#include <queue>
+
+#include "VirgilFragments.h"
+#include "VirgilThreadedCommunicator.h"
+
+/**
+ * @brief Class for communication of current service and kernel module through mapped memory of character device.
+ * Layout of memory is the same as in kernel module (ring.h):
+ * header, submission slots (kernel -> service), completion slots (service -> kernel).
+ */
+class VirgilRingCommunicator : public VirgilThreadedCommunicator {
+public:
+    VirgilRingCommunicator();
+    virtual ~VirgilRingCommunicator();
+
+    VirgilRingCommunicator(const VirgilRingCommunicator&) = delete;
+    VirgilRingCommunicator& operator=(const VirgilRingCommunicator&) = delete;
+
+    /**
+     * @brief Check is communicator ready.
+     */
+    virtual bool isReady() const final;
+
+    /**
+     * @brief Check is character device of kernel module present.
+     */
+    static bool isAvailable();
+
+private:
+    static const uint32_t kSlotsCount = 128; /**< Count of slots in each ring */
+
+    struct __attribute__((__packed__)) RingHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotsCount;
+        uint32_t slotSize;
+        uint32_t sqHead;
+        uint32_t sqTail;
+        uint32_t cqHead;
+        uint32_t cqTail;
+        uint32_t sqSizes[kSlotsCount];
+        uint32_t cqSizes[kSlotsCount];
+    };
+
+    /**
+     * @brief Start communication.
+     */
+    virtual bool _start() final;
+
+    /**
+     * @brief Stop communication.
+     */
+    virtual void _stop() final;
+
+    /**
+     * @brief Send prepared data.
+     * @param to - ignored here
+     * @param data - data array for send
+     * @return true if data has been sent successfully
+     */
+    virtual bool _send(int to, const VirgilByteArray & data) final;
+
+    /**
+     * @brief Send prepared frames with single notification of kernel.
+     * @param to - ignored here
+     * @param frames - list of frames for send
+     * @return true if all frames have been sent successfully
+     */
+    virtual bool _sendBatch(int to, const std::list <VirgilByteArray> & frames) final;
+
+    /**
+     * @brief Receive data.
+     * @param from - ignored here
+     * @param data - data array for receive
+     */
+    virtual bool _receive(int * from, VirgilByteArray & data) final;
+
+    /**
+     * @brief Receive single message.
+     * All messages available in submission ring are taken at once, they are returned one by one.
+     * @param message - message payload
+     */
+    bool receiveMessage(VirgilByteArray & message);
+
+    /**
+     * @brief Put message into completion ring.
+     * @param message - message payload
+     */
+    bool putMessage(const VirgilByteArray & message);
+
+    uint8_t * sqSlot(uint32_t idx) const;
+    uint8_t * cqSlot(uint32_t idx) const;
+
+    static const char * kDevice; /**< Character device of kernel module */
+    static const uint32_t kMagic; /**< Magic of shared memory header */
+    static const uint32_t kVersion; /**< Version of shared memory layout */
+    static const size_t kSlotSize; /**< Size of one slot */
+    static const size_t kMessageSizeMax; /**< Maximum size of single message. Bigger frames are fragmented. */
+
+    std::mutex m_ringMutex;
+    int m_fd;
+    size_t m_memorySize;
+    uint8_t * m_memory;
+    RingHeader * m_header;
+
+    std::queue<VirgilByteArray> m_receivedMessages;
+    VirgilFragments m_fragments;
+};
+
+#endif /* VIRGIL_RING_COMMUNICATOR_H */
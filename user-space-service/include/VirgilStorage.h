@@ -44,6 +44,7 @@
 
 #include <virgil/crypto/VirgilByteArray.h>
 #include <list>
+#include <time.h>
 
 using namespace virgil::crypto;
 
@@ -85,6 +86,8 @@ namespace virgil {
 
 /**
  * @brief Class for data storage.
+ * Permanent data is shared by workers through file and is reloaded if other worker has changed it.
+ * Temporary data is kept in memory of worker and is lost when worker exits.
  */
 class VirgilDataStorage {
 public:
@@ -111,9 +114,10 @@ public:
     /**
      * @brief Load data from storage.
      * @param id - identifier of data
+     * @param storeType - type of storage where data has been found (can be nullptr)
      * @return data or empty array in case of error
      */
-    VirgilByteArray load(const std::string & id);
+    VirgilByteArray load(const std::string & id, virgil::dataStorage::VirgilStoreType * storeType = nullptr);
     
     /**
      * @brief Revoke data from storage.
@@ -128,6 +132,7 @@ private:
     
     std::string _fileName;
     const size_t _fileSize;
+    struct timespec _fileTime;
     
     static const size_t kTemporaryDataMaxCount = 200;
 
@@ -146,6 +151,9 @@ private:
     bool loadPermanentData();
     bool storePermanentData();
 
+    struct timespec _modificationTime() const;
+    void _reloadIfChanged();
+
     void _updatePermanentDataPointer();
     void _printContent() const;
 };
@@ -40,6 +40,7 @@
 #include <stdint.h>
 #include "signals/Signal.h"
 
+#include <list>
 #include <queue>
 #include <mutex>
 #include <thread>
@@ -61,6 +62,7 @@ public:
     virtual bool send(const VirgilByteArray & data, int to = -1);
     
     virtual bool isReady() const = 0;
+    bool start();
     void stop();
     
     Gallant::Signal0 <> fireReady;
@@ -71,12 +73,12 @@ protected:
     virtual bool _start() = 0;
     virtual void _stop() = 0;
     virtual bool _send(int to, const VirgilByteArray & data) = 0;
+    virtual bool _sendBatch(int to, const std::list <VirgilByteArray> & frames);
     virtual bool _receive(int * from, VirgilByteArray & data) = 0;
     
     virtual void sendThread();
     virtual void receiveThread();
 
-    bool start();
 private:
     std::queue <VirgilByteArray> m_sendQueue;
     std::mutex m_sendQueueMutex;
@@ -0,0 +1,101 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file VirgilWorkerPool.h
+ * @brief Parallel processing of items of batch requests.
+ */
+
+#ifndef VIRGIL_WORKER_POOL_H
+#define VIRGIL_WORKER_POOL_H
+
+#include <stddef.h>
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+/**
+ * @brief Pool of threads which process items of batch requests.
+ * Thread of executor which has received batch takes part in processing of its items, so batch is finished
+ * even if all threads of pool are busy with other batches.
+ */
+class VirgilWorkerPool {
+public:
+    typedef std::function<void(size_t)> ItemFunc;
+
+    static VirgilWorkerPool & instance();
+
+    VirgilWorkerPool(const VirgilWorkerPool&) = delete;
+    VirgilWorkerPool& operator=(const VirgilWorkerPool&) = delete;
+
+    /**
+     * @brief Call function for each index of item in range [0, count) and wait for all of them
+     * @param count - count of items
+     * @param func - function which processes item (exceptions are caught)
+     */
+    void run(size_t count, const ItemFunc & func);
+
+private:
+    struct Job {
+        size_t count;
+        size_t next;
+        size_t done;
+        const ItemFunc * func;
+    };
+
+    std::vector <std::thread> m_threads;
+    std::deque <Job *> m_jobs;      /**< Jobs with items which haven't been taken yet */
+
+    std::mutex m_mutex;
+    std::condition_variable m_condVar;
+    std::condition_variable m_doneVar;
+    bool m_stop;
+
+    VirgilWorkerPool();
+    virtual ~VirgilWorkerPool();
+
+    static size_t threadsCount();
+    static void call(const Job & job, size_t index);
+
+    size_t take(Job * job);
+    void threadFunc();
+};
+
+#endif /* VIRGIL_WORKER_POOL_H */
@@ -75,6 +75,10 @@ private:
     static VirgilByteArray sign(const VirgilCommand & cmd);
     static VirgilByteArray verify(const VirgilCommand & cmd);
     static VirgilByteArray hash(const VirgilCommand & cmd);
+    static VirgilByteArray verifyBatch(const VirgilCommand & cmd);
+    static VirgilByteArray signBatch(const VirgilCommand & cmd);
+
+    static const size_t kBatchChunk = 8;        /**< Count of items processed by thread at once */
 };
 
 #endif /* VIRGIL_CMD_CRYPTO_H */
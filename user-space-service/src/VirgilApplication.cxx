@@ -35,6 +35,8 @@
  */
 
 #include "VirgilApplication.h"
+#include "VirgilNetlinkCommunicator.h"
+#include "VirgilRingCommunicator.h"
 #include "VirgilCRLProcessor.h"
 #include "VirgilCommand.h"
 
@@ -49,6 +51,8 @@
 
 #include <iostream>
 
+static const std::chrono::milliseconds kCancelKeepTime(15000);
+
 VirgilApplication::VirgilApplication() :
 m_kernelCommunicator(nullptr) {
 }
@@ -67,17 +71,24 @@ bool VirgilApplication::exec() {
 
     LOG("Prepare kernel communicator ... ");
 
-    // Create kernel communicator and connect all signals
-    m_kernelCommunicator = new VirgilNetlinkCommunicator;
+    // Create kernel communicator and connect all signals.
+    // Shared memory rings are preferred, netlink is used with kernel module without ring device.
+    if (VirgilRingCommunicator::isAvailable()) {
+        LOG("Use shared memory rings");
+        m_kernelCommunicator = new VirgilRingCommunicator;
+    } else {
+        m_kernelCommunicator = new VirgilNetlinkCommunicator;
+    }
     m_kernelCommunicator->fireReady.Connect(this, &VirgilApplication::onCommunicationStart);
     m_kernelCommunicator->fireNotReady.Connect(this, &VirgilApplication::onCommunicationStop);
     m_kernelCommunicator->fireDataReceived.Connect(this, &VirgilApplication::onDataReceived);
+    m_executor.fireLoadChanged.Connect(this, &VirgilApplication::onLoadChanged);
 
     // Start crl processing thread
-    VirgilCRLProcessor::instance();
+    VirgilCRLProcessor::instance().fireCRLChanged.Connect(this, &VirgilApplication::onCRLChanged);
 
-    // Send Ping command to thread
-    m_kernelCommunicator->send(VirgilCommand::pingCmd());
+    // Connect to kernel module. Ping is sent on every (re)connection.
+    m_kernelCommunicator->start();
 
     // Infinitive sleep
     std::this_thread::sleep_until(std::chrono::system_clock::now() + std::chrono::hours(std::numeric_limits<int>::max()));
@@ -87,12 +98,59 @@ bool VirgilApplication::exec() {
 
 void VirgilApplication::onCommunicationStart() {
     LOG("Communication start ...");
+
+    // Worker becomes ready for requests after ping
+    m_kernelCommunicator->send(VirgilCommand::pingCmd());
+
+    // Kernel could cache results of certificate checks with CRL of other worker
+    onCRLChanged();
 }
 
 void VirgilApplication::onCommunicationStop() {
     LOG("Communication stop ...");
 }
 
+void VirgilApplication::cancel(uint32_t requestId) {
+    const std::lock_guard <std::mutex> _lock(m_cancelledMutex);
+    const auto _now(std::chrono::steady_clock::now());
+
+    for (auto it = m_cancelled.begin(); it != m_cancelled.end();) {
+        if (it->second < _now) {
+            it = m_cancelled.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    m_cancelled[requestId] = _now + kCancelKeepTime;
+}
+
+bool VirgilApplication::takeCancelled(uint32_t requestId) {
+    const std::lock_guard <std::mutex> _lock(m_cancelledMutex);
+    return m_cancelled.erase(requestId) > 0;
+}
+
+void VirgilApplication::onLoadChanged(size_t load) {
+    // Kernel module throttles requests while queue is deep
+    const uint32_t _load(static_cast<uint32_t> (load));
+    const VirgilByteArray _loadBytes(reinterpret_cast<const uint8_t *> (&_load),
+            reinterpret_cast<const uint8_t *> (&_load) + sizeof (_load));
+
+    m_kernelCommunicator->send(VirgilCommand(cmdLoad, 0)
+            .appendData(fldQueueDepth, _loadBytes)
+            .data());
+}
+
+void VirgilApplication::onCRLChanged() {
+    // Revocation set lets kernel check certificates without requests
+    VirgilCommand _notice(cmdCRLChanged, 0);
+    const VirgilByteArray _revocationSet(VirgilCRLProcessor::instance().revocationSet());
+    if (!_revocationSet.empty()) {
+        _notice.appendData(fldData, _revocationSet);
+    }
+    m_kernelCommunicator->send(_notice.data());
+}
+
 void VirgilApplication::sendResult(const VirgilCommand & command, VirgilResult result) {
     m_kernelCommunicator->send(VirgilCommand::resultCmd(command.command(), command.id(), result));
 }
@@ -105,10 +163,51 @@ void VirgilApplication::onDataReceived(int from, const VirgilByteArray & data) {
         return;
     }
 
+    switch (_cmd.command()) {
+        case cmdPing:
+        {
+            LOG("Kernel module is ready");
+
+            // Kernel takes set of newly registered worker
+            if (!VirgilCRLProcessor::instance().revocationSet().empty()) {
+                onCRLChanged();
+            }
+        }
+            return;
+
+        case cmdCancel:
+        {
+            cancel(_cmd.id());
+        }
+            return;
+
+        default:
+            break;
+    }
+
+    // Requests are executed in order of priority classes
+    m_executor.submit(_cmd.priority(), [this, _cmd]() {
+        process(_cmd);
+    });
+}
+
+void VirgilApplication::process(const VirgilCommand & command) {
+    // Nobody waits for response, so operation isn't performed
+    if (takeCancelled(command.id())) {
+        LOG("Request has been cancelled (id : %u)", command.id());
+        return;
+    }
+
+    if (command.isExpired()) {
+        LOG("Request has been expired (id : %u)", command.id());
+        sendResult(command, resGeneralError);
+        return;
+    }
+
     VirgilByteArray answer;
 
     try {
-        switch (_cmd.command()) {
+        switch (command.command()) {
             case cmdCryptoKeygen:
             case cmdCryptoEncryptPassword:
             case cmdCryptoDecryptPassword:
@@ -117,8 +216,10 @@ void VirgilApplication::onDataReceived(int from, const VirgilByteArray & data) {
             case cmdCryptoSign:
             case cmdCryptoVerify:
             case cmdCryptoHash:
+            case cmdCryptoVerifyBatch:
+            case cmdCryptoSignBatch:
             {
-                answer = VirgilCmdCrypto::process(_cmd);
+                answer = VirgilCmdCrypto::process(command);
             }
                 break;
 
@@ -126,7 +227,7 @@ void VirgilApplication::onDataReceived(int from, const VirgilByteArray & data) {
             case cmdStorageLoad:
             case cmdStorageRemove:
             {
-                answer = VirgilCmdDataStorage::process(_cmd);
+                answer = VirgilCmdDataStorage::process(command);
             }
                 break;
 
@@ -138,7 +239,7 @@ void VirgilApplication::onDataReceived(int from, const VirgilByteArray & data) {
             case cmdCertificateCRLInfo:
             case cmdCertificateCheckIsRevoked:
             {
-                answer = VirgilCmdCertificates::process(_cmd);
+                answer = VirgilCmdCertificates::process(command);
             }
                 break;
 
@@ -152,7 +253,7 @@ void VirgilApplication::onDataReceived(int from, const VirgilByteArray & data) {
     }
 
     if (answer.empty()) {
-        sendResult(_cmd, resGeneralError);
+        sendResult(command, resGeneralError);
     } else {
         m_kernelCommunicator->send(answer);
     }
@@ -40,11 +40,33 @@
 
 #include "helpers/VirgilLog.h"
 
+#include <virgil/crypto/foundation/VirgilHash.h>
+
+#include <algorithm>
+#include <chrono>
 #include <ctime>
+#include <vector>
 
 const int VirgilCRLProcessor::kAskPeriodSec = 10 * 60;
 
+// Parameters of revocation set should match limits of kernel module (revocation.h)
+const uint32_t VirgilCRLProcessor::kFilterBitsPerId = 16;
+const uint32_t VirgilCRLProcessor::kFilterBitsMin = 1024;
+const uint32_t VirgilCRLProcessor::kFilterBitsMax = 1 << 20;
+const uint8_t VirgilCRLProcessor::kFilterHashes = 7;
+const size_t VirgilCRLProcessor::kExactIdsMax = 4096;
+
 using namespace virgil::sdk::models;
+using namespace virgil::crypto::foundation;
+
+template<typename T>
+static VirgilByteArray & operator<<(VirgilByteArray & data, T number) {
+    uint8_t * pBytes(reinterpret_cast<uint8_t *> (& number));
+    for (int i = 0; i < sizeof (number); ++i) {
+        data.push_back(pBytes[i]);
+    }
+    return data;
+}
 
 VirgilCRLProcessor & VirgilCRLProcessor::instance() {
     static VirgilCRLProcessor myInstance;
@@ -74,7 +96,63 @@ time_t VirgilCRLProcessor::nextCRLTime() const {
 
 bool VirgilCRLProcessor::isCertificateRevoked(const std::string & certificateId) {
     const std::lock_guard <std::mutex> _lock(m_crlMutex);
-    return std::find(m_crlIds.begin(), m_crlIds.end(), certificateId) != m_crlIds.end();
+    return m_crlIds.count(certificateId) > 0;
+}
+
+VirgilByteArray VirgilCRLProcessor::revocationSet() {
+    const std::lock_guard <std::mutex> _lock(m_crlMutex);
+    return m_revocationSet;
+}
+
+VirgilByteArray VirgilCRLProcessor::idDigest(const std::string & certificateId) {
+    return VirgilHash::sha256().hash(VirgilByteArray(certificateId.begin(), certificateId.end()));
+}
+
+void VirgilCRLProcessor::buildRevocationSet() {
+    std::vector <VirgilByteArray> _ids;
+    for (const auto & id : m_crlIds) {
+        _ids.push_back(idDigest(id));
+    }
+    std::sort(_ids.begin(), _ids.end());
+    _ids.erase(std::unique(_ids.begin(), _ids.end()), _ids.end());
+
+    uint32_t _filterBits(kFilterBitsMin);
+    while (_filterBits < _ids.size() * kFilterBitsPerId && _filterBits < kFilterBitsMax) {
+        _filterBits <<= 1;
+    }
+
+    // Hash function j is little-endian 32-bit word j of id
+    VirgilByteArray _filter(_filterBits / 8, 0);
+    for (const auto & id : _ids) {
+        for (size_t j = 0; j < kFilterHashes; ++j) {
+            const uint32_t _word(id[j * 4] | (id[j * 4 + 1] << 8) | (id[j * 4 + 2] << 16)
+                    | (static_cast<uint32_t> (id[j * 4 + 3]) << 24));
+            const uint32_t _bit(_word & (_filterBits - 1));
+            _filter[_bit >> 3] |= 1 << (_bit & 7);
+        }
+    }
+
+    // Kernel asks service about ids which aren't in incomplete exact set
+    const bool _isComplete(_ids.size() <= kExactIdsMax);
+    const uint32_t _idsCount(static_cast<uint32_t> (std::min(_ids.size(), kExactIdsMax)));
+
+    // Version is monotonic time, so sets of all workers are ordered even if wall clock is changed
+    const uint64_t _version(std::chrono::duration_cast<std::chrono::milliseconds> (
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+
+    VirgilByteArray _set;
+    _set << _version
+            << _filterBits
+            << _idsCount
+            << kFilterHashes
+            << static_cast<uint8_t> (_isComplete ? 1 : 0)
+            << static_cast<uint16_t> (0);
+    _set.insert(_set.end(), _filter.begin(), _filter.end());
+    for (uint32_t i = 0; i < _idsCount; ++i) {
+        _set.insert(_set.end(), _ids[i].begin(), _ids[i].end());
+    }
+
+    m_revocationSet.swap(_set);
 }
 
 void VirgilCRLProcessor::requestThread() {
@@ -82,15 +160,26 @@ void VirgilCRLProcessor::requestThread() {
         if ((std::time(nullptr) - m_nextActionTime) > kAskPeriodSec) {
             m_nextActionTime = std::time(nullptr) + kAskPeriodSec;
             const CRLModel _crl(VirgilCertificates().crl());
+            bool _isChanged(false);
             {
                 const std::lock_guard <std::mutex> _lock(m_crlMutex);
-                m_crlIds.clear();
+                std::set <std::string> _crlIds;
                 for (const auto crlEl : _crl.getElements()) {
-                    m_crlIds.push_back(crlEl.getId());
+                    _crlIds.insert(crlEl.getId());
                 }
+                _isChanged = 0 == m_lastActionTime || _crlIds != m_crlIds;
+                m_crlIds.swap(_crlIds);
                 m_lastActionTime = std::time(nullptr);
+                if (_isChanged) {
+                    buildRevocationSet();
+                }
                 LOG("CRL has been asked. It contains %d elements.\n", m_crlIds.size());
             }
+
+            // Kernel drops cached results of certificate checks
+            if (_isChanged) {
+                fireCRLChanged();
+            }
         }
 
         if (m_nextActionTime > std::time(nullptr)) {
@@ -137,13 +137,20 @@ std::string VirgilCertificates::getRootCertificate() {
 
 bool VirgilCertificates::verifyCertificateWithRoot(
             const std::string & cert,
-            const std::string & rootCert
+            const std::string & rootCert,
+            bool * isChecked
             ) {
     bool res(false);
+    if (isChecked) {
+        *isChecked = false;
+    }
     try {
         const auto _parsedCert(Marshaller<CertificateModel>::fromJson(cert));
         const auto _parsedRootCert(Marshaller<CertificateModel>::fromJson(rootCert));
         res = _parsedCert.verifyWith(_parsedRootCert);
+        if (isChecked) {
+            *isChecked = true;
+        }
     } catch (std::exception& exception) {
         std::cerr << exception.what() << std::endl;
         res = false;
@@ -35,6 +35,7 @@
  */
 
 #include <iostream>
+#include <time.h>
 
 #include "VirgilCommand.h"
 #include "helpers/VirgilLog.h"
@@ -94,6 +95,8 @@ VirgilCommand & VirgilCommand::clear() {
     m_command = cmdUnknown;
     m_elements.clear();
     m_requestId = 0;
+    m_deadline = 0;
+    m_priority = prioDefault;
     return *this;
 }
 
@@ -120,7 +123,8 @@ VirgilByteArray VirgilCommand::data() const {
     VirgilByteArray res;
     VirgilByteArray payload;
 
-    res << m_requestId << m_command << static_cast<uint16_t> (m_elements.size());
+    res << m_requestId << m_command << static_cast<uint16_t> (m_elements.size())
+            << m_deadline << m_priority;
     for (const auto & el : m_elements) {
         res << el.fieldType
                 << static_cast<uint32_t> (el.data.size())
@@ -161,7 +165,20 @@ bool VirgilCommand::initReceived(const VirgilByteArray & rawCommandData) {
     const uint16_t _elementsCount(readNum <uint16_t> (pos, rawCommandData));
     pos += sizeof (_elementsCount);
 
-    if (_elementsCount < 1 || _elementsCount > 50) {
+    m_deadline = readNum <uint64_t> (pos, rawCommandData);
+    pos += sizeof (m_deadline);
+
+    const uint16_t _priority(readNum <uint16_t> (pos, rawCommandData));
+    pos += sizeof (_priority);
+    m_priority = _priority < static_cast<uint16_t> (prioMax) ? static_cast<VirgilPriority> (_priority) : prioDefault;
+
+    // Cancel notice has no data
+    if ((_elementsCount < 1 && m_command != cmdCancel) || _elementsCount > kElementsMax) {
+        return false;
+    }
+
+    // Descriptions of all fields must be inside of frame
+    if (pos + sizeof (packageField) * _elementsCount > rawCommandData.size()) {
         return false;
     }
 
@@ -210,10 +227,33 @@ std::list<VirgilByteArray> VirgilCommand::dataByField(VirgilField field) const {
     return res;
 }
 
+const std::list<VirgilDataElement> & VirgilCommand::elements() const {
+    return m_elements;
+}
+
 uint32_t VirgilCommand::id() const {
     return m_requestId;
 }
 
+VirgilPriority VirgilCommand::priority() const {
+    return m_priority;
+}
+
+uint64_t VirgilCommand::deadline() const {
+    return m_deadline;
+}
+
+bool VirgilCommand::isExpired() const {
+    if (!m_deadline) return false;
+
+    // Kernel uses the same clock for deadline
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    const uint64_t _now(static_cast<uint64_t> (ts.tv_sec) * 1000 + ts.tv_nsec / 1000000);
+
+    return _now >= m_deadline;
+}
+
 VirgilByteArray VirgilCommand::pingCmd() {
     return VirgilCommand(cmdPing, 0).data();
 }
@@ -0,0 +1,170 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "VirgilExecutor.h"
+#include "helpers/VirgilLog.h"
+
+#include <algorithm>
+
+VirgilExecutor::VirgilExecutor() : m_virtualTime(0), m_depth(0), m_reportedLoad(0), m_stop(false) {
+    for (size_t i = 0; i < prioMax; ++i) {
+        m_running[i] = 0;
+        m_classTag[i] = 0;
+    }
+
+    for (size_t i = 0; i < kThreadsCount; ++i) {
+        m_threads.push_back(std::thread(&VirgilExecutor::threadFunc, this));
+    }
+}
+
+VirgilExecutor::~VirgilExecutor() {
+    {
+        const std::lock_guard <std::mutex> _lock(m_mutex);
+        m_stop = true;
+    }
+    m_condVar.notify_all();
+
+    for (auto & thread : m_threads) {
+        thread.join();
+    }
+}
+
+uint64_t VirgilExecutor::weight(VirgilPriority priority) {
+    switch (priority) {
+        case prioCritical: return 16;
+        case prioBulk: return 1;
+        default: return 4;
+    }
+}
+
+size_t VirgilExecutor::threadsLimit(VirgilPriority priority) {
+    switch (priority) {
+        case prioCritical: return kThreadsCount;
+        case prioBulk: return 1;
+        default: return kThreadsCount - 1;
+    }
+}
+
+bool VirgilExecutor::loadChanged(size_t & load) {
+    if (m_depth / kLoadReportStep == m_reportedLoad / kLoadReportStep) {
+        return false;
+    }
+
+    m_reportedLoad = m_depth;
+    load = m_depth;
+    return true;
+}
+
+void VirgilExecutor::submit(VirgilPriority priority, Task task) {
+    bool _isChanged;
+    size_t _load;
+
+    if (priority == prioDefault || priority >= prioMax) {
+        priority = prioNormal;
+    }
+
+    {
+        const std::lock_guard <std::mutex> _lock(m_mutex);
+        Item item;
+        item.tag = std::max(m_virtualTime, m_classTag[priority]) + kWeightScale / weight(priority);
+        item.task = std::move(task);
+        m_classTag[priority] = item.tag;
+        m_queues[priority].push_back(std::move(item));
+        ++m_depth;
+        _isChanged = loadChanged(_load);
+    }
+    m_condVar.notify_one();
+
+    if (_isChanged) {
+        fireLoadChanged(_load);
+    }
+}
+
+bool VirgilExecutor::pick(VirgilPriority & priority) {
+    bool res(false);
+
+    for (size_t i = 0; i < prioMax; ++i) {
+        if (m_queues[i].empty() || m_running[i] >= threadsLimit(static_cast<VirgilPriority> (i))) {
+            continue;
+        }
+
+        if (!res || m_queues[i].front().tag < m_queues[priority].front().tag) {
+            priority = static_cast<VirgilPriority> (i);
+            res = true;
+        }
+    }
+
+    return res;
+}
+
+void VirgilExecutor::threadFunc() {
+    std::unique_lock <std::mutex> _lock(m_mutex);
+
+    while (true) {
+        VirgilPriority priority(prioDefault);
+        m_condVar.wait(_lock, [this, &priority]() {
+            return m_stop || pick(priority);
+        });
+
+        if (m_stop) break;
+
+        Task task(std::move(m_queues[priority].front().task));
+        m_virtualTime = std::max(m_virtualTime, m_queues[priority].front().tag);
+        m_queues[priority].pop_front();
+        ++m_running[priority];
+        --m_depth;
+
+        size_t _load(0);
+        const bool _isChanged(loadChanged(_load));
+
+        _lock.unlock();
+        if (_isChanged) {
+            fireLoadChanged(_load);
+        }
+
+        try {
+            task();
+        } catch (...) {
+            LOG_ERROR("Task has failed");
+        }
+        _lock.lock();
+
+        // Class has been at its limit, so other threads could wait for it
+        if (m_running[priority]-- == threadsLimit(priority)) {
+            m_condVar.notify_all();
+        }
+    }
+}
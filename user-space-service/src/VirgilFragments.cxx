@@ -0,0 +1,180 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "VirgilFragments.h"
+#include "VirgilCommand.h"
+#include "helpers/VirgilLog.h"
+
+#include <cstring>
+
+const size_t VirgilFragments::kFrameSizeMax(1024 * 1024);
+const size_t VirgilFragments::kReassemblyMemoryMax(4 * 1024 * 1024);
+const size_t VirgilFragments::kHeaderSize(sizeof (uint32_t) + sizeof (uint16_t) + sizeof (uint16_t) + sizeof (uint64_t)
+        + sizeof (uint16_t) + sizeof (uint32_t) + sizeof (uint32_t));
+
+static const std::chrono::milliseconds kReassemblyTimeout(15000);
+
+template<typename T>
+static VirgilByteArray & operator<<(VirgilByteArray & data, T number) {
+    uint8_t * pBytes(reinterpret_cast<uint8_t *> (& number));
+    for (int i = 0; i < sizeof (number); ++i) {
+        data.push_back(pBytes[i]);
+    }
+    return data;
+}
+
+VirgilFragments::VirgilFragments() : m_memory(0) {
+}
+
+std::list<VirgilByteArray> VirgilFragments::split(const VirgilByteArray & frame, size_t messageSizeMax) {
+    std::list<VirgilByteArray> res;
+
+    if (frame.size() <= messageSizeMax) {
+        res.push_back(frame);
+        return res;
+    }
+
+    if (frame.size() > kFrameSizeMax || messageSizeMax <= kHeaderSize) {
+        LOG_ERROR("Frame is too big (%d bytes)", static_cast<int> (frame.size()));
+        return res;
+    }
+
+    const uint32_t _id(VirgilCommand::readNum <uint32_t> (0, frame));
+    const size_t _partSizeMax(messageSizeMax - kHeaderSize);
+
+    for (size_t offset = 0; offset < frame.size(); offset += _partSizeMax) {
+        const size_t _partSize(std::min(_partSizeMax, frame.size() - offset));
+        VirgilByteArray fragment;
+        fragment.reserve(kHeaderSize + _partSize);
+
+        fragment << _id
+                << static_cast<uint16_t> (cmdFragment)
+                << static_cast<uint16_t> (0)
+                << static_cast<uint64_t> (0)
+                << static_cast<uint16_t> (0)
+                << static_cast<uint32_t> (frame.size())
+                << static_cast<uint32_t> (offset);
+        fragment.insert(fragment.end(), frame.begin() + offset, frame.begin() + offset + _partSize);
+
+        res.push_back(fragment);
+    }
+
+    return res;
+}
+
+void VirgilFragments::drop(std::map<uint32_t, Frame>::iterator it) {
+    m_memory -= it->second.frameSize;
+    m_frames.erase(it);
+}
+
+void VirgilFragments::dropExpired() {
+    const auto _now(std::chrono::steady_clock::now());
+
+    for (auto it = m_frames.begin(); it != m_frames.end();) {
+        auto current(it++);
+        if (current->second.expires < _now) {
+            LOG_ERROR("Incomplete frame has been dropped (id : %u)", current->first);
+            drop(current);
+        }
+    }
+}
+
+bool VirgilFragments::append(const VirgilByteArray & message, VirgilByteArray & frame) {
+    frame.clear();
+
+    if (message.size() < kHeaderSize ||
+            VirgilCommand::readNum <uint16_t> (sizeof (uint32_t), message) != static_cast<uint16_t> (cmdFragment)) {
+        frame = message;
+        return true;
+    }
+
+    size_t pos(0);
+    const uint32_t _id(VirgilCommand::readNum <uint32_t> (pos, message));
+    pos += sizeof (uint32_t) + sizeof (uint16_t) + sizeof (uint16_t) + sizeof (uint64_t) + sizeof (uint16_t);
+    const uint32_t _frameSize(VirgilCommand::readNum <uint32_t> (pos, message));
+    pos += sizeof (uint32_t);
+    const uint32_t _offset(VirgilCommand::readNum <uint32_t> (pos, message));
+    pos += sizeof (uint32_t);
+    const size_t _partSize(message.size() - pos);
+
+    if (_frameSize > kFrameSizeMax || _offset >= _frameSize || !_partSize || _partSize > _frameSize - _offset) {
+        LOG_ERROR("Wrong fragment (id : %u)", _id);
+        return false;
+    }
+
+    dropExpired();
+
+    auto it(m_frames.find(_id));
+
+    // First fragment starts new frame
+    if (!_offset) {
+        if (it != m_frames.end()) {
+            drop(it);
+        }
+
+        if (m_memory + _frameSize > kReassemblyMemoryMax) {
+            LOG_ERROR("No memory for frame reassembly (id : %u)", _id);
+            return false;
+        }
+
+        Frame newFrame;
+        newFrame.frameSize = _frameSize;
+        newFrame.expires = std::chrono::steady_clock::now() + kReassemblyTimeout;
+        newFrame.data.reserve(_frameSize);
+        it = m_frames.insert(std::make_pair(_id, std::move(newFrame))).first;
+        m_memory += _frameSize;
+    }
+
+    if (it == m_frames.end()) {
+        return false;
+    }
+
+    if (_offset != it->second.data.size() || _frameSize != it->second.frameSize) {
+        LOG_ERROR("Fragment out of order (id : %u)", _id);
+        drop(it);
+        return false;
+    }
+
+    it->second.data.insert(it->second.data.end(), message.begin() + pos, message.end());
+
+    if (it->second.data.size() < it->second.frameSize) {
+        return false;
+    }
+
+    frame.swap(it->second.data);
+    drop(it);
+    return true;
+}
@@ -45,7 +45,12 @@
 #include <cstring>
 #include <unistd.h>
 
-VirgilNetlinkCommunicator::VirgilNetlinkCommunicator() : m_socket(-1) {
+const size_t VirgilNetlinkCommunicator::kMessageSizeMax(7 * 1024);
+const size_t VirgilNetlinkCommunicator::kDatagramSizeMax(64 * 1024);
+
+VirgilNetlinkCommunicator::VirgilNetlinkCommunicator() :
+m_socket(-1),
+m_receiveBuffer(NLMSG_SPACE(kMessageSizeMax)) {
 }
 
 VirgilNetlinkCommunicator::~VirgilNetlinkCommunicator() {
@@ -59,6 +64,7 @@ bool VirgilNetlinkCommunicator::_start() {
         close(m_socket);
     }
     reset();
+    m_receivedMessages = std::queue<VirgilByteArray>();
 
     m_socket = socket(AF_NETLINK, SOCK_RAW, VirgilNetlinkCommunicator::kVirgilNetlink);
 
@@ -71,6 +77,12 @@ bool VirgilNetlinkCommunicator::_start() {
 
     const bool res(0 == bind(m_socket, (struct sockaddr*) &s_nladdr, sizeof (s_nladdr)));
 
+    // Receive buffer should fit all fragments of the biggest frame
+    const int _rcvBufSize(VirgilFragments::kReassemblyMemoryMax);
+    if (0 != setsockopt(m_socket, SOL_SOCKET, SO_RCVBUFFORCE, &_rcvBufSize, sizeof (_rcvBufSize))) {
+        setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &_rcvBufSize, sizeof (_rcvBufSize));
+    }
+
     return res;
 }
 
@@ -86,62 +98,125 @@ bool VirgilNetlinkCommunicator::isReady() const {
     return m_socket >= 0;
 }
 
-bool VirgilNetlinkCommunicator::_receive(int * from, VirgilByteArray & data) {
-    #define MAX_PAYLOAD (1024 * 1024)
+bool VirgilNetlinkCommunicator::receiveMessage(VirgilByteArray & message) {
+    struct sockaddr_nl nladdr;
+    struct msghdr msg;
+    struct iovec iov;
 
-    static char buffer[MAX_PAYLOAD];
+    message.clear();
+
+    while (m_receivedMessages.empty()) {
+        ssize_t _sz(0);
+
+        for (int flags : {MSG_PEEK | MSG_TRUNC, 0}) {
+            memset(&nladdr, 0, sizeof (struct sockaddr_nl));
+            memset(&msg, 0, sizeof (struct msghdr));
+            memset(&iov, 0, sizeof (struct iovec));
+
+            iov.iov_base = (void *) m_receiveBuffer.data();
+            iov.iov_len = m_receiveBuffer.size();
+            msg.msg_name = (void *) &(nladdr);
+            msg.msg_namelen = sizeof (nladdr);
+
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+
+            _sz = recvmsg(m_socket, &msg, flags);
+            if (0 >= _sz) {
+                return false;
+            }
+
+            // Buffer grows to the size of the biggest received datagram
+            if ((flags & MSG_PEEK) && static_cast<size_t> (_sz) > m_receiveBuffer.size()) {
+                m_receiveBuffer.resize(_sz);
+            }
+        }
+
+        // Datagram can contain batch of netlink messages
+        size_t _remaining(_sz);
+        for (const struct nlmsghdr * nlh = reinterpret_cast<const struct nlmsghdr *> (m_receiveBuffer.data());
+                NLMSG_OK(nlh, _remaining);
+                nlh = NLMSG_NEXT(nlh, _remaining)) {
+            m_receivedMessages.emplace(reinterpret_cast<const char *> (NLMSG_DATA(nlh)),
+                    reinterpret_cast<const char *> (NLMSG_DATA(nlh)) + NLMSG_PAYLOAD(nlh, 0));
+        }
+    }
 
-    static struct nlmsghdr * nlh = reinterpret_cast<struct nlmsghdr *> (buffer);
-    static struct sockaddr_nl nladdr;
-    static struct msghdr msg;
-    static struct iovec iov;
+    message = std::move(m_receivedMessages.front());
+    m_receivedMessages.pop();
 
-    memset(buffer, 0, MAX_PAYLOAD);
-    memset(&nladdr, 0, sizeof (struct sockaddr_nl));
-    memset(&msg, 0, sizeof (struct msghdr));
-    memset(&iov, 0, sizeof (struct iovec));
+    return true;
+}
 
-    iov.iov_base = (void *) nlh;
-    iov.iov_len = MAX_PAYLOAD;
-    msg.msg_name = (void *) &(nladdr);
-    msg.msg_namelen = sizeof (nladdr);
+bool VirgilNetlinkCommunicator::_receive(int * from, VirgilByteArray & data) {
+    VirgilByteArray message;
 
-    msg.msg_iov = &iov;
-    msg.msg_iovlen = 1;
-    
     data.clear();
 
-    if (0 >= recvmsg(m_socket, &msg, 0)) {
-        return false;
+    // Wait for complete frame
+    while (true) {
+        if (!receiveMessage(message)) {
+            return false;
+        }
+
+        if (m_fragments.append(message, data)) {
+            return true;
+        }
     }
+}
 
-    data.assign(reinterpret_cast<char *> (NLMSG_DATA(nlh)), reinterpret_cast<char *> (NLMSG_DATA(nlh) + NLMSG_PAYLOAD(nlh, 0)));
+bool VirgilNetlinkCommunicator::_send(int to, const VirgilByteArray & data) {
+    return _sendBatch(to, {data});
+}
 
-    return true;
+bool VirgilNetlinkCommunicator::_sendBatch(int to, const std::list <VirgilByteArray> & frames) {
+    bool res(true);
+    std::vector<char> datagram;
+
+    datagram.reserve(kDatagramSizeMax);
+
+    for (const auto & frame : frames) {
+        for (const auto & message : VirgilFragments::split(frame, kMessageSizeMax)) {
+            if (!datagram.empty() && datagram.size() + NLMSG_SPACE(message.size()) > kDatagramSizeMax) {
+                res = sendDatagram(datagram) && res;
+                datagram.clear();
+            }
+            appendMessage(datagram, message);
+        }
+    }
+
+    if (!datagram.empty()) {
+        res = sendDatagram(datagram) && res;
+    }
+
+    return res;
 }
 
-bool VirgilNetlinkCommunicator::_send(int to, const VirgilByteArray & data) {
+void VirgilNetlinkCommunicator::appendMessage(std::vector<char> & datagram, const VirgilByteArray & message) {
+    const size_t _offset(datagram.size());
+    datagram.resize(_offset + NLMSG_SPACE(message.size()), 0);
+
+    /* Fill the netlink message header */
+    struct nlmsghdr * nlh = reinterpret_cast<struct nlmsghdr *> (datagram.data() + _offset);
+    memcpy(NLMSG_DATA(nlh), message.data(), message.size());
+    nlh->nlmsg_len = NLMSG_LENGTH(message.size());
+    nlh->nlmsg_pid = getpid();
+    nlh->nlmsg_flags = NLM_F_REQUEST;
+    nlh->nlmsg_type = 0;
+}
+
+bool VirgilNetlinkCommunicator::sendDatagram(const std::vector<char> & datagram) {
     /* destination address */
-    struct sockaddr_nl s_nladdr, d_nladdr;
+    struct sockaddr_nl d_nladdr;
     memset(&d_nladdr, 0, sizeof (d_nladdr));
     d_nladdr.nl_family = AF_NETLINK;
     d_nladdr.nl_pad = 0;
     d_nladdr.nl_pid = 0; /* destined to kernel */
 
-    /* Fill the netlink message header */
-    const size_t _sz(sizeof (struct nlmsghdr) + data.size());
-    struct nlmsghdr * nlh = (struct nlmsghdr *) malloc(_sz);
-    memset(nlh, 0, _sz);
-    memcpy(NLMSG_DATA(nlh), data.data(), data.size());
-    nlh->nlmsg_len = _sz;
-    nlh->nlmsg_pid = getpid();
-    nlh->nlmsg_flags = 1;
-    nlh->nlmsg_type = 0;
-
     /*iov structure */
     struct iovec iov;
-    iov.iov_base = (void *) nlh;
-    iov.iov_len = nlh->nlmsg_len;
+    iov.iov_base = (void *) datagram.data();
+    iov.iov_len = datagram.size();
 
     /* msg */
     struct msghdr msg;
@@ -150,7 +225,6 @@ bool VirgilNetlinkCommunicator::_send(int to, const VirgilByteArray & data) {
     msg.msg_namelen = sizeof (d_nladdr);
     msg.msg_iov = &iov;
     msg.msg_iovlen = 1;
-    sendmsg(m_socket, &msg, 0);
 
-    return true;
+    return 0 < sendmsg(m_socket, &msg, 0);
 }
@@ -0,0 +1,235 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "VirgilRingCommunicator.h"
+#include "helpers/VirgilLog.h"
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#define VIRGIL_RING_IOC_NOTIFY _IO('V', 1)
+
+const char * VirgilRingCommunicator::kDevice("/dev/virgil-ring");
+const uint32_t VirgilRingCommunicator::kMagic(0x56524e47);
+const uint32_t VirgilRingCommunicator::kVersion(1);
+const size_t VirgilRingCommunicator::kSlotSize(8 * 1024);
+const size_t VirgilRingCommunicator::kMessageSizeMax(7 * 1024);
+
+VirgilRingCommunicator::VirgilRingCommunicator() :
+m_fd(-1),
+m_memorySize(0),
+m_memory(nullptr),
+m_header(nullptr) {
+}
+
+VirgilRingCommunicator::~VirgilRingCommunicator() {
+    _stop();
+}
+
+bool VirgilRingCommunicator::isAvailable() {
+    return 0 == access(kDevice, R_OK | W_OK);
+}
+
+bool VirgilRingCommunicator::_start() {
+    _stop();
+
+    const std::lock_guard <std::mutex> _lock(m_ringMutex);
+
+    reset();
+    m_receivedMessages = std::queue<VirgilByteArray>();
+
+    m_fd = open(kDevice, O_RDWR | O_CLOEXEC);
+    if (m_fd < 0) {
+        LOG("ERROR: Can't open %s (%s)", kDevice, strerror(errno));
+        return false;
+    }
+
+    const size_t _pageSize(sysconf(_SC_PAGESIZE));
+    const size_t _headerSize((sizeof (RingHeader) + _pageSize - 1) / _pageSize * _pageSize);
+    const size_t _memorySize(_headerSize + 2 * kSlotsCount * kSlotSize);
+
+    void * _memory = mmap(nullptr, _memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (MAP_FAILED == _memory) {
+        LOG("ERROR: Can't map rings (%s)", strerror(errno));
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    RingHeader * _header = reinterpret_cast<RingHeader *> (_memory);
+    if (kMagic != _header->magic || kVersion != _header->version
+            || kSlotsCount != _header->slotsCount || kSlotSize != _header->slotSize) {
+        LOG("ERROR: Wrong layout of rings");
+        munmap(_memory, _memorySize);
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_memory = reinterpret_cast<uint8_t *> (_memory) + _headerSize;
+    m_memorySize = _memorySize;
+    m_header = _header;
+
+    return true;
+}
+
+void VirgilRingCommunicator::_stop() {
+    const std::lock_guard <std::mutex> _lock(m_ringMutex);
+
+    if (m_header) {
+        munmap(m_header, m_memorySize);
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+
+    m_header = nullptr;
+    m_memory = nullptr;
+    m_memorySize = 0;
+    m_fd = -1;
+}
+
+bool VirgilRingCommunicator::isReady() const {
+    return m_fd >= 0 && m_header;
+}
+
+uint8_t * VirgilRingCommunicator::sqSlot(uint32_t idx) const {
+    return m_memory + (idx % kSlotsCount) * kSlotSize;
+}
+
+uint8_t * VirgilRingCommunicator::cqSlot(uint32_t idx) const {
+    return m_memory + (kSlotsCount + idx % kSlotsCount) * kSlotSize;
+}
+
+bool VirgilRingCommunicator::receiveMessage(VirgilByteArray & message) {
+    message.clear();
+
+    while (m_receivedMessages.empty()) {
+        struct pollfd _pfd;
+        memset(&_pfd, 0, sizeof (_pfd));
+        _pfd.fd = m_fd;
+        _pfd.events = POLLIN;
+
+        const int _res(poll(&_pfd, 1, -1));
+        if (_res < 0 && EINTR == errno) continue;
+        if (_res <= 0 || (_pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+            return false;
+        }
+
+        // Take all available submissions per wakeup
+        uint32_t _head(m_header->sqHead);
+        const uint32_t _tail(__atomic_load_n(&m_header->sqTail, __ATOMIC_ACQUIRE));
+
+        for (; _head != _tail; ++_head) {
+            const uint32_t _size(m_header->sqSizes[_head % kSlotsCount]);
+            if (!_size || _size > kSlotSize) continue;
+
+            const uint8_t * _slot(sqSlot(_head));
+            m_receivedMessages.emplace(_slot, _slot + _size);
+        }
+
+        __atomic_store_n(&m_header->sqHead, _head, __ATOMIC_RELEASE);
+    }
+
+    message = std::move(m_receivedMessages.front());
+    m_receivedMessages.pop();
+
+    return true;
+}
+
+bool VirgilRingCommunicator::_receive(int * from, VirgilByteArray & data) {
+    VirgilByteArray message;
+
+    data.clear();
+
+    if (!isReady()) return false;
+
+    // Wait for complete frame
+    while (true) {
+        if (!receiveMessage(message)) {
+            return false;
+        }
+
+        if (m_fragments.append(message, data)) {
+            return true;
+        }
+    }
+}
+
+bool VirgilRingCommunicator::putMessage(const VirgilByteArray & message) {
+    if (message.size() > kSlotSize) return false;
+
+    const uint32_t _tail(m_header->cqTail);
+
+    // Kernel drains completion ring synchronously on notification
+    while (_tail - __atomic_load_n(&m_header->cqHead, __ATOMIC_ACQUIRE) >= kSlotsCount) {
+        if (0 != ioctl(m_fd, VIRGIL_RING_IOC_NOTIFY)) {
+            return false;
+        }
+    }
+
+    memcpy(cqSlot(_tail), message.data(), message.size());
+    m_header->cqSizes[_tail % kSlotsCount] = message.size();
+    __atomic_store_n(&m_header->cqTail, _tail + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool VirgilRingCommunicator::_send(int to, const VirgilByteArray & data) {
+    return _sendBatch(to, {data});
+}
+
+bool VirgilRingCommunicator::_sendBatch(int to, const std::list <VirgilByteArray> & frames) {
+    const std::lock_guard <std::mutex> _lock(m_ringMutex);
+    bool res(true);
+
+    if (!isReady()) return false;
+
+    for (const auto & frame : frames) {
+        for (const auto & message : VirgilFragments::split(frame, kMessageSizeMax)) {
+            res = putMessage(message) && res;
+        }
+    }
+
+    // Single notification for all frames
+    return (0 == ioctl(m_fd, VIRGIL_RING_IOC_NOTIFY)) && res;
+}
@@ -40,6 +40,7 @@
 
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
@@ -85,12 +86,34 @@ bool VirgilDataStorage::loadPermanentData() {
     }
 
     _updatePermanentDataPointer();
+    _fileTime = _modificationTime();
 
     return false;
 }
 
 bool VirgilDataStorage::storePermanentData() {
-    return VirgilFilesHelper::saveFile(_fileName, m_permanentDataBuf);
+    const bool res(VirgilFilesHelper::saveFile(_fileName, m_permanentDataBuf));
+    _fileTime = _modificationTime();
+    return res;
+}
+
+struct timespec VirgilDataStorage::_modificationTime() const {
+    struct stat _stat;
+    struct timespec res = {0, 0};
+
+    if (0 == stat(_fileName.c_str(), &_stat)) {
+        res = _stat.st_mtim;
+    }
+    return res;
+}
+
+void VirgilDataStorage::_reloadIfChanged() {
+    // Worker which has become primary serves keys saved by previous primary worker
+    const struct timespec _time(_modificationTime());
+    if (_time.tv_sec != _fileTime.tv_sec || _time.tv_nsec != _fileTime.tv_nsec) {
+        LOG("Permanent data has been changed by other worker, reload it");
+        loadPermanentData();
+    }
 }
 
 int VirgilDataStorage::posById(const std::string & id) const {
@@ -162,6 +185,8 @@ bool VirgilDataStorage::save(const std::string & id, const VirgilByteArray & dat
     } else if (virgil::dataStorage::stPermanent == storeType) {
         if (data.size() > restrDataSizeMax) return false;
 
+        _reloadIfChanged();
+
         int _pos(posById(id));
         if (_pos < 0) {
             _pos = writePos();
@@ -183,8 +208,9 @@ bool VirgilDataStorage::save(const std::string & id, const VirgilByteArray & dat
     return false;
 }
 
-VirgilByteArray VirgilDataStorage::load(const std::string & id) {
+VirgilByteArray VirgilDataStorage::load(const std::string & id, virgil::dataStorage::VirgilStoreType * storeType) {
     VirgilByteArray res;
+    virgil::dataStorage::VirgilStoreType _storeType(virgil::dataStorage::stUnknown);
 
     auto it = std::find_if(m_temporaryData.begin(), m_temporaryData.end(),
             [&](const virgil::dataStorage::tempData v) {
@@ -193,15 +219,21 @@ VirgilByteArray VirgilDataStorage::load(const std::string & id) {
 
     if (m_temporaryData.end() != it) {
         res = it->data;
+        _storeType = virgil::dataStorage::stTemporary;
     } else {
+        _reloadIfChanged();
         const int _pos(posById(id));
         LOG("LOAD : id : %s\n   pos :%d", id.c_str(), _pos);
         if (_pos >= 0) {
+            _storeType = virgil::dataStorage::stPermanent;
             res.assign(reinterpret_cast<unsigned char *> (m_permanentData[_pos].data),
                     reinterpret_cast<unsigned char *> (m_permanentData[_pos].data) +
                     std::min(m_permanentData[_pos].dataSize, static_cast<uint16_t> (restrDataSizeMax)));
         }
     }
+    if (storeType) {
+        *storeType = _storeType;
+    }
     return res;
 }
 
@@ -215,6 +247,7 @@ bool VirgilDataStorage::remove(const std::string & id) {
         m_temporaryData.erase(it);;
     }
 
+    _reloadIfChanged();
     const int _pos(posById(id));
     if (_pos >= 0) {
         m_permanentData[_pos].num = 0;
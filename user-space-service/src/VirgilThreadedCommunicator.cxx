@@ -44,8 +44,9 @@
 #include <cstring>
 #include <unistd.h>
 
+// Received data is processed in receive thread. Application schedules execution of requests itself.
 #if !defined(VIRGIL_THREADED_PROCESSING)
-#define VIRGIL_THREADED_PROCESSING
+//#define VIRGIL_THREADED_PROCESSING
 #endif
 
 VirgilThreadedCommunicator::VirgilThreadedCommunicator() :
@@ -103,21 +104,34 @@ void VirgilThreadedCommunicator::sendThread() {
             return !m_sendQueue.empty();
         });
 
-        VirgilByteArray data;
+        // Take all queued frames to send them together
+        std::list <VirgilByteArray> frames;
         {
             const std::lock_guard <std::mutex> _lock(m_sendQueueMutex);
-            if (!m_sendQueue.empty()) {
-                data = m_sendQueue.front();
+            while (!m_sendQueue.empty()) {
+                if (!m_sendQueue.front().empty()) {
+                    frames.push_back(std::move(m_sendQueue.front()));
+                }
                 m_sendQueue.pop();
             }
         }
 
-        if (data.empty()) continue;
+        if (frames.empty()) continue;
 
-        _send(-1, data);
+        _sendBatch(-1, frames);
     }
 }
 
+bool VirgilThreadedCommunicator::_sendBatch(int to, const std::list <VirgilByteArray> & frames) {
+    bool res(true);
+
+    for (const auto & frame : frames) {
+        res = _send(to, frame) && res;
+    }
+
+    return res;
+}
+
 void VirgilThreadedCommunicator::receiveThread() {
     VirgilByteArray data;
 
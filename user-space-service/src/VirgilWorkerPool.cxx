@@ -0,0 +1,137 @@
+/**
+ * Copyright (C) 2016 Virgil Security Inc.
+ *
+ * Lead Maintainer: Virgil Security Inc. <support@virgilsecurity.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *     (3) Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "VirgilWorkerPool.h"
+#include "helpers/VirgilLog.h"
+
+#include <algorithm>
+
+VirgilWorkerPool & VirgilWorkerPool::instance() {
+    static VirgilWorkerPool _pool;
+    return _pool;
+}
+
+VirgilWorkerPool::VirgilWorkerPool() : m_stop(false) {
+    const size_t _count(threadsCount());
+    for (size_t i = 0; i < _count; ++i) {
+        m_threads.push_back(std::thread(&VirgilWorkerPool::threadFunc, this));
+    }
+}
+
+VirgilWorkerPool::~VirgilWorkerPool() {
+    {
+        const std::lock_guard <std::mutex> _lock(m_mutex);
+        m_stop = true;
+    }
+    m_condVar.notify_all();
+
+    for (auto & thread : m_threads) {
+        thread.join();
+    }
+}
+
+size_t VirgilWorkerPool::threadsCount() {
+    // Items are processed by CPU only, so one thread per CPU is enough
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void VirgilWorkerPool::call(const Job & job, size_t index) {
+    try {
+        (*job.func)(index);
+    } catch (...) {
+        LOG_ERROR("Item of batch has failed");
+    }
+}
+
+size_t VirgilWorkerPool::take(Job * job) {
+    const size_t index(job->next++);
+
+    // Job is removed from queue when its last item is taken
+    if (job->next == job->count) {
+        m_jobs.erase(std::find(m_jobs.begin(), m_jobs.end(), job));
+    }
+
+    return index;
+}
+
+void VirgilWorkerPool::run(size_t count, const ItemFunc & func) {
+    if (!count) return;
+
+    Job job;
+    job.count = count;
+    job.next = 0;
+    job.done = 0;
+    job.func = &func;
+
+    std::unique_lock <std::mutex> _lock(m_mutex);
+    m_jobs.push_back(&job);
+    m_condVar.notify_all();
+
+    while (job.next < job.count) {
+        const size_t _index(take(&job));
+        _lock.unlock();
+        call(job, _index);
+        _lock.lock();
+        ++job.done;
+    }
+
+    // Job lives on stack, so it's released after threads of pool have finished its items
+    m_doneVar.wait(_lock, [&job]() {
+        return job.done == job.count;
+    });
+}
+
+void VirgilWorkerPool::threadFunc() {
+    std::unique_lock <std::mutex> _lock(m_mutex);
+
+    while (true) {
+        m_condVar.wait(_lock, [this]() {
+            return m_stop || !m_jobs.empty();
+        });
+
+        if (m_stop) break;
+
+        Job * job(m_jobs.front());
+        const size_t _index(take(job));
+        _lock.unlock();
+        call(*job, _index);
+        _lock.lock();
+
+        if (++job->done == job->count) {
+            m_doneVar.notify_all();
+        }
+    }
+}
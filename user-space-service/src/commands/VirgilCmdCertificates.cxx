@@ -210,11 +210,17 @@ VirgilByteArray VirgilCmdCertificates::verify(const VirgilCommand & cmd) {
         return VirgilByteArray();
     }
 
+    bool _isChecked(false);
     const bool _isVerified(VirgilCertificates().verifyCertificateWithRoot(
             bytes2str(_certificates.front()),
-            bytes2str(_rootCertificates.front())));
+            bytes2str(_rootCertificates.front()),
+            &_isChecked));
 
-    return VirgilCommand::resultCmd(cmd.command(), cmd.id(), _isVerified ? resOk : resGeneralError);
+    // Kernel caches only definitive answers, errors aren't reported as rejection
+    if (_isVerified) {
+        return VirgilCommand::resultCmd(cmd.command(), cmd.id(), resOk);
+    }
+    return VirgilCommand::resultCmd(cmd.command(), cmd.id(), _isChecked ? resRejected : resGeneralError);
 }
 
 VirgilByteArray VirgilCmdCertificates::parse(const VirgilCommand & cmd) {
@@ -275,12 +281,15 @@ VirgilByteArray VirgilCmdCertificates::isRevoked(const VirgilCommand & cmd) {
     }
 
     const CertificateModel _parsedCert(Marshaller<CertificateModel>::fromJson(bytes2str(_certificates.front())));
-    const uint8_t isRevoked(VirgilCRLProcessor::instance().isCertificateRevoked(_parsedCert.getCard().getId()) ? 1 : 0);
+    const std::string _id(_parsedCert.getCard().getId());
+    const uint8_t isRevoked(VirgilCRLProcessor::instance().isCertificateRevoked(_id) ? 1 : 0);
     VirgilByteArray res;
     res << isRevoked;
 
+    // Kernel remembers id of certificate and checks it with revocation set next time
     return VirgilCommand(cmd.command(), cmd.id())
             .appendData(fldOptional_1, res)
+            .appendData(fldIdentity, VirgilCRLProcessor::idDigest(_id))
             .data();
 }
 
@@ -36,6 +36,7 @@
 
 #include "VirgilCmdCrypto.h"
 #include "VirgilCertificates.h"
+#include "VirgilWorkerPool.h"
 #include "helpers/VirgilLog.h"
 
 #include <virgil/crypto/VirgilKeyPair.h>
@@ -45,6 +46,9 @@
 #include <virgil/sdk/models/CardModel.h>
 
 #include <iostream>
+#include <map>
+#include <vector>
+#include <algorithm>
 
 using namespace virgil::crypto;
 using namespace virgil::crypto::foundation;
@@ -251,6 +255,137 @@ VirgilByteArray VirgilCmdCrypto::hash(const VirgilCommand & cmd) {
             .data();
 }
 
+VirgilByteArray VirgilCmdCrypto::verifyBatch(const VirgilCommand & cmd) {
+    LOG("Verify batch");
+
+    struct Item {
+        const VirgilByteArray * publicKey;
+        const VirgilByteArray * data;
+        const VirgilByteArray * signature;
+    };
+
+    // Each item is public key or certificate, data and signature
+    const std::list<VirgilDataElement> & _elements(cmd.elements());
+    std::list<VirgilDataElement>::const_iterator _it(_elements.begin());
+    std::map<VirgilByteArray, VirgilByteArray> _certificateKeys;
+    std::vector<Item> _items;
+
+    while (_it != _elements.end()) {
+        Item item;
+
+        if (_it->fieldType == fldCertificate) {
+            // Certificate is parsed once for all its items
+            auto _key(_certificateKeys.find(_it->data));
+            if (_key == _certificateKeys.end()) {
+                VirgilByteArray _publicKey;
+                try {
+                    CertificateModel _certificate(Marshaller<CertificateModel>::fromJson(bytes2str(_it->data)));
+                    _publicKey = _certificate.getCard().getPublicKey().getKey();
+                } catch (...) {
+                }
+                _key = _certificateKeys.insert(std::make_pair(_it->data, _publicKey)).first;
+            }
+            item.publicKey = &_key->second;
+        } else if (_it->fieldType == fldPublicKey) {
+            item.publicKey = &_it->data;
+        } else {
+            return VirgilByteArray();
+        }
+
+        if (++_it == _elements.end() || _it->fieldType != fldData) {
+            return VirgilByteArray();
+        }
+        item.data = &_it->data;
+
+        if (++_it == _elements.end() || _it->fieldType != fldSignature) {
+            return VirgilByteArray();
+        }
+        item.signature = &_it->data;
+        ++_it;
+
+        _items.push_back(item);
+    }
+
+    if (_items.empty() || _items.size() > VirgilCommand::kBatchCountMax) {
+        return VirgilByteArray();
+    }
+
+    // Byte per item, so threads don't share bytes of results
+    std::vector<uint8_t> _verified(_items.size(), 0);
+    const size_t _chunks((_items.size() + kBatchChunk - 1) / kBatchChunk);
+
+    VirgilWorkerPool::instance().run(_chunks, [&_items, &_verified](size_t chunk) {
+        VirgilSigner _signer;
+        const size_t _end(std::min(_items.size(), (chunk + 1) * kBatchChunk));
+
+        for (size_t i = chunk * kBatchChunk; i < _end; ++i) {
+            const Item & item(_items[i]);
+            try {
+                _verified[i] = !item.publicKey->empty()
+                        && _signer.verify(*item.data, *item.signature, *item.publicKey);
+            } catch (...) {
+            }
+        }
+    });
+
+    // Bit of item i is bit i % 8 of byte i / 8
+    VirgilByteArray _bitmap((_items.size() + 7) / 8, 0);
+    for (size_t i = 0; i < _items.size(); ++i) {
+        if (_verified[i]) {
+            _bitmap[i / 8] |= 1 << (i % 8);
+        }
+    }
+
+    return VirgilCommand(cmdCryptoVerifyBatch, cmd.id())
+            .appendData(fldData, _bitmap)
+            .data();
+}
+
+VirgilByteArray VirgilCmdCrypto::signBatch(const VirgilCommand & cmd) {
+    LOG("Sign batch");
+    const std::list<VirgilByteArray> _privateKeys(cmd.dataByField(fldPrivateKey));
+
+    if (_privateKeys.size() != 1) {
+        return VirgilByteArray();
+    }
+
+    // Data items are referenced in place, they aren't copied
+    const VirgilByteArray & _privateKey(_privateKeys.front());
+    std::vector<const VirgilByteArray *> _dataList;
+    for (const auto & el : cmd.elements()) {
+        if (el.fieldType == fldData) {
+            _dataList.push_back(&el.data);
+        }
+    }
+
+    if (_dataList.empty() || _dataList.size() > VirgilCommand::kBatchCountMax) {
+        return VirgilByteArray();
+    }
+
+    std::vector<VirgilByteArray> _signatures(_dataList.size());
+    const size_t _chunks((_dataList.size() + kBatchChunk - 1) / kBatchChunk);
+
+    VirgilWorkerPool::instance().run(_chunks, [&_privateKey, &_dataList, &_signatures](size_t chunk) {
+        VirgilSigner _signer;
+        const size_t _end(std::min(_dataList.size(), (chunk + 1) * kBatchChunk));
+
+        for (size_t i = chunk * kBatchChunk; i < _end; ++i) {
+            _signatures[i] = _signer.sign(*_dataList[i], _privateKey);
+        }
+    });
+
+    // Whole batch fails if any item hasn't been signed (pool catches exceptions)
+    VirgilCommand _answer(cmdCryptoSignBatch, cmd.id());
+    for (const auto & signature : _signatures) {
+        if (signature.empty()) {
+            return VirgilByteArray();
+        }
+        _answer.appendData(fldSignature, signature);
+    }
+
+    return _answer.data();
+}
+
 VirgilByteArray VirgilCmdCrypto::process(const VirgilCommand & cmd) {
     try {
         switch (cmd.command()) {
@@ -279,6 +414,12 @@ VirgilByteArray VirgilCmdCrypto::process(const VirgilCommand & cmd) {
             case cmdCryptoHash:
                 return hash(cmd);
 
+            case cmdCryptoVerifyBatch:
+                return verifyBatch(cmd);
+
+            case cmdCryptoSignBatch:
+                return signBatch(cmd);
+
             default:
             {
                 LOG("Unknown");
@@ -84,15 +84,21 @@ VirgilByteArray VirgilCmdDataStorage::load(const VirgilCommand & cmd) {
     }
 
     const std::string _id(reinterpret_cast<const char*> (_identity.front().data()));
-    VirgilByteArray key(VirgilDataStorage::instance().load(_id));
+    virgil::dataStorage::VirgilStoreType _storeType(virgil::dataStorage::stUnknown);
+    VirgilByteArray key(VirgilDataStorage::instance().load(_id, &_storeType));
 
     if (key.size() && _password.size()) {
         key = VirgilCipher().decryptWithPassword(key, _password.front());
     }
 
     if (key.size()) {
+        // Type of storage lets kernel cache permanent keys
+        const uint16_t _keyTypeData(static_cast<uint16_t> (_storeType));
+        const VirgilByteArray _keyType(reinterpret_cast<const unsigned char *> (&_keyTypeData),
+                reinterpret_cast<const unsigned char *> (&_keyTypeData) + sizeof (_keyTypeData));
         return VirgilCommand(cmd.command(), cmd.id())
                 .appendData(fldData, key)
+                .appendData(fldKeyType, _keyType)
                 .data();
     }
     return VirgilByteArray();